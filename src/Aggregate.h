@@ -0,0 +1,116 @@
+//
+// Created by Alper Çakan on 9.04.2018.
+//
+
+#ifndef STGMGR_AGGREGATE_H
+#define STGMGR_AGGREGATE_H
+
+#include <limits>
+#include <string>
+#include "constants.h"
+
+/**
+ * The running aggregate of the values of a field over a group of records.
+ *
+ * All the supported functions are kept at once, since each costs an add or a
+ * compare per value; which one is wanted matters only for the result.
+ */
+struct Aggregate {
+  enum Function { COUNT, SUM, MIN, MAX, AVG };
+
+  uint_t count = 0;
+
+  /**
+   * Kept in 128 bits, which no sum of at most 2^64 values of 64 bits
+   * overflows
+   */
+  __int128 sum = 0;
+  sint_t min = std::numeric_limits<sint_t>::max();
+  sint_t max = std::numeric_limits<sint_t>::min();
+
+  void add(sint_t value) {
+    ++count;
+    sum += value;
+
+    if (value < min) min = value;
+    if (value > max) max = value;
+  }
+
+  /**
+   * Adds the values of another aggregate to this one.
+   */
+  void merge(const Aggregate &other) {
+    count += other.count;
+    sum += other.sum;
+
+    if (other.min < min) min = other.min;
+    if (other.max > max) max = other.max;
+  }
+
+  /**
+   * Gives the result of a function other than AVG, for which see average().
+   * The result of each function but COUNT is meaningless for an empty group.
+   * Only the result of SUM may not fit in 64 bits; see toString().
+   */
+  __int128 value(Function func) const {
+    switch (func) {
+      case COUNT:
+        return count;
+      case SUM:
+        return sum;
+      case MIN:
+        return min;
+      case MAX:
+        return max;
+      case AVG:
+        break;
+    }
+
+    return count ? sum / __int128(count) : 0;
+  }
+
+  double average() const {
+    return count ? double(static_cast<long double>(sum) / count) : 0;
+  }
+
+  /**
+   * Gives the decimal form of a result, which the streams cannot print.
+   */
+  static std::string toString(__int128 value) {
+    bool negative = value < 0;
+    unsigned __int128 magnitude = value;
+
+    if (negative) magnitude = -magnitude;
+
+    std::string digits;
+
+    do {
+      digits.insert(digits.begin(), char('0' + magnitude % 10));
+      magnitude /= 10;
+    } while (magnitude);
+
+    return negative ? "-" + digits : digits;
+  }
+
+  /**
+   * Parses the name of a function: count, sum, min, max or avg.
+   *
+   * @param name The name
+   * @param func A reference to a variable. The function will be stored here.
+   * @return Success/failure
+   */
+  static bool parseFunction(const std::string &name, Function &func) {
+    static const char *const names[] = {"count", "sum", "min", "max", "avg"};
+
+    for (int i = 0; i <= AVG; ++i) {
+      if (name == names[i]) {
+        func = Function(i);
+        return true;
+      }
+    }
+
+    return false;
+  }
+};
+
+#endif  // STGMGR_AGGREGATE_H
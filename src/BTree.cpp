@@ -0,0 +1,298 @@
+//
+// Created by Alper Çakan on 9.04.2018.
+//
+
+#include "BTree.h"
+#include "BufferPool.h"
+#include "Disc.h"
+#include "FreeSpaceMap.h"
+#include "LockManager.h"
+#include "Page.h"
+
+#include <algorithm>
+
+using std::string;
+using std::vector;
+
+static const uint_t LEAF_ENTRY_SIZE = 2 * sizeof(uint_t);
+static const uint_t INNER_ENTRY_SIZE = 3 * sizeof(uint_t);
+
+BTree::BTree(string fileName) : fileName(std::move(fileName)) {}
+
+bool BTree::create(const string &fileName) {
+  for (const auto &name : {fileName, FreeSpaceMap::mapFileName(fileName)}) {
+    BufferPool::discardFile(name);
+    Disc::removeFile(name);
+  }
+
+  if (!(Disc::appendPage(fileName) && Disc::appendPage(fileName) &&
+        FreeSpaceMap::setFull(fileName, 1, 2, true))) {
+    return false;
+  }
+
+  BTree tree(fileName);
+
+  return tree.store(2, Node()) && tree.setRoot(2);
+}
+
+uint_t BTree::root() {
+  Page meta(fileName, 1);
+
+  if (!meta) return 0;
+
+  return meta.getUIntAtPos(0);
+}
+
+bool BTree::setRoot(uint_t locAddr) {
+  Page meta(fileName, 1, Page::LATCH_EXCLUSIVE);
+
+  if (!meta) return false;
+
+  meta.writeContent(reinterpret_cast<const char *>(&locAddr), sizeof(uint_t));
+  meta.setIsUsed(true);
+  meta.setPageCategory(PAGE_CATEGORY_INDEX);
+
+  return meta.persist();
+}
+
+bool BTree::load(uint_t locAddr, Node &node) {
+  Page page(fileName, locAddr);
+
+  if (!page) return false;
+
+  node.isLeaf = page.getUIntAtPos(0);
+  node.next = page.getUIntAtPos(2 * sizeof(uint_t));
+
+  auto count = page.getUIntAtPos(sizeof(uint_t));
+  auto raw =
+      reinterpret_cast<const uint_t *>(page.content() + NODE_HEADER_SIZE);
+
+  node.entries.resize(count);
+  node.children.clear();
+
+  if (node.isLeaf) {
+    for (uint_t i = 0; i < count; ++i) {
+      node.entries[i] = {sint_t(raw[2 * i]), raw[2 * i + 1]};
+    }
+  } else {
+    node.children.resize(count + 1);
+    node.children[0] = raw[0];
+
+    for (uint_t i = 0; i < count; ++i) {
+      node.entries[i] = {sint_t(raw[1 + 3 * i]), raw[2 + 3 * i]};
+      node.children[i + 1] = raw[3 + 3 * i];
+    }
+  }
+
+  return true;
+}
+
+bool BTree::store(uint_t locAddr, const Node &node) {
+  Page page(fileName, locAddr, Page::LATCH_EXCLUSIVE);
+
+  if (!page) return false;
+
+  vector<uint_t> raw = {node.isLeaf, node.entries.size(), node.next};
+
+  if (node.isLeaf) {
+    for (const auto &e : node.entries) {
+      raw.push_back(e.key);
+      raw.push_back(e.rid);
+    }
+  } else {
+    raw.push_back(node.children[0]);
+
+    for (size_t i = 0; i < node.entries.size(); ++i) {
+      raw.push_back(node.entries[i].key);
+      raw.push_back(node.entries[i].rid);
+      raw.push_back(node.children[i + 1]);
+    }
+  }
+
+  page.reset();
+
+  if (!page.writeContent(reinterpret_cast<const char *>(raw.data()),
+                         raw.size() * sizeof(uint_t))) {
+    return false;
+  }
+
+  page.setIsUsed(true);
+  page.setPageCategory(PAGE_CATEGORY_INDEX);
+
+  return page.persist();
+}
+
+uint_t BTree::newNode() {
+  while (true) {
+    auto locAddr = FreeSpaceMap::findPage(fileName);
+
+    if (!locAddr && !Disc::appendPage(fileName, &locAddr)) return 0;
+
+    bool isFree;
+
+    {
+      Page page(fileName, locAddr);
+
+      if (!page) return 0;
+
+      isFree = !page.isUsed();
+    }
+
+    // Either the page is taken, or the map was stale (e.g. it was made
+    // before the page was used)
+    if (!FreeSpaceMap::setFull(fileName, locAddr, true)) return 0;
+
+    if (isFree) return locAddr;
+  }
+}
+
+/**
+ * Gives the index of the child of an inner node which covers the given entry.
+ */
+template <typename Entries, typename Entry>
+static size_t childIndex(const Entries &seps, const Entry &entry) {
+  return std::upper_bound(seps.begin(), seps.end(), entry) - seps.begin();
+}
+
+bool BTree::insertAt(uint_t locAddr, const Entry &entry, bool &split,
+                     Entry &sep, uint_t &sibling) {
+  Node node;
+  split = false;
+
+  if (!load(locAddr, node)) return false;
+
+  if (node.isLeaf) {
+    node.entries.insert(
+        std::lower_bound(node.entries.begin(), node.entries.end(), entry),
+        entry);
+  } else {
+    auto idx = childIndex(node.entries, entry);
+    bool childSplit;
+    Entry childSep;
+    uint_t childSibling;
+
+    if (!insertAt(node.children[idx], entry, childSplit, childSep,
+                  childSibling)) {
+      return false;
+    }
+
+    if (!childSplit) return true;
+
+    node.entries.insert(node.entries.begin() + idx, childSep);
+    node.children.insert(node.children.begin() + idx + 1, childSibling);
+  }
+
+  auto room = Page::contentSize() - NODE_HEADER_SIZE;
+  auto capacity = node.isLeaf ? room / LEAF_ENTRY_SIZE
+                              : (room - sizeof(uint_t)) / INNER_ENTRY_SIZE;
+
+  if (node.entries.size() <= capacity) return store(locAddr, node);
+
+  // Overflow: move the upper half to a new sibling node
+  if (!(sibling = newNode())) return false;
+
+  Node right;
+  right.isLeaf = node.isLeaf;
+  auto mid = node.entries.size() / 2;
+
+  if (node.isLeaf) {
+    right.entries.assign(node.entries.begin() + mid, node.entries.end());
+    right.next = node.next;
+    node.next = sibling;
+    sep = right.entries.front();
+  } else {
+    // The middle separator moves up instead of being copied
+    sep = node.entries[mid];
+    right.entries.assign(node.entries.begin() + mid + 1, node.entries.end());
+    right.children.assign(node.children.begin() + mid + 1,
+                          node.children.end());
+    node.children.resize(mid + 1);
+  }
+
+  node.entries.resize(mid);
+  split = true;
+
+  return store(sibling, right) && store(locAddr, node);
+}
+
+bool BTree::insert(sint_t key, uint_t rid) {
+  LockGuard guard(LockManager::of(fileName), Lock::EXCLUSIVE);
+  auto rootAddr = root();
+
+  if (!rootAddr) return false;
+
+  bool split;
+  Entry sep;
+  uint_t sibling;
+
+  if (!insertAt(rootAddr, {key, rid}, split, sep, sibling)) return false;
+
+  if (!split) return true;
+
+  Node newRoot;
+  newRoot.isLeaf = false;
+  newRoot.entries.push_back(sep);
+  newRoot.children = {rootAddr, sibling};
+
+  auto newRootAddr = newNode();
+
+  return newRootAddr && store(newRootAddr, newRoot) && setRoot(newRootAddr);
+}
+
+uint_t BTree::findLeaf(const Entry &entry) {
+  auto locAddr = root();
+  Node node;
+
+  while (locAddr && load(locAddr, node) && !node.isLeaf) {
+    locAddr = node.children[childIndex(node.entries, entry)];
+  }
+
+  return locAddr;
+}
+
+bool BTree::remove(sint_t key, uint_t rid) {
+  LockGuard guard(LockManager::of(fileName), Lock::EXCLUSIVE);
+  Entry entry = {key, rid};
+  auto locAddr = findLeaf(entry);
+  Node node;
+
+  if (!locAddr || !load(locAddr, node)) return false;
+
+  auto it = std::lower_bound(node.entries.begin(), node.entries.end(), entry);
+
+  if (it == node.entries.end() || it->key != key || it->rid != rid) {
+    return false;
+  }
+
+  node.entries.erase(it);
+
+  return store(locAddr, node);
+}
+
+bool BTree::find(sint_t key, vector<uint_t> &rids, size_t limit) {
+  LockGuard guard(LockManager::of(fileName), Lock::SHARED);
+  Entry first = {key, 0};
+  auto locAddr = findLeaf(first);
+  Node node;
+  size_t found = 0;
+
+  while (locAddr) {
+    if (!load(locAddr, node)) return false;
+
+    auto it = std::lower_bound(node.entries.begin(), node.entries.end(), first);
+
+    for (; it != node.entries.end(); ++it) {
+      if (it->key != key) return true;
+
+      rids.push_back(it->rid);
+
+      if (limit && ++found == limit) return true;
+    }
+
+    // All the entries in this leaf are smaller, or equal to the key; the
+    // remaining matches (if any) continue in the next leaf
+    locAddr = node.next;
+  }
+
+  return true;
+}
@@ -0,0 +1,135 @@
+//
+// Created by Alper Çakan on 9.04.2018.
+//
+
+#ifndef STGMGR_BTREE_H
+#define STGMGR_BTREE_H
+
+#include <string>
+#include <vector>
+#include "constants.h"
+
+/**
+ * A B+tree stored in its own file, which maps integer keys to record ids.
+ *
+ * The entries are ordered by (key, record id), hence the same key may appear
+ * with different record ids. The first page of the file is a meta page
+ * holding the local address of the root; the other pages are the nodes.
+ * Deleting an entry never merges nodes, so a node may become empty.
+ *
+ * The free-space map of the file (see FreeSpaceMap) marks the pages in use
+ * as full, so a node appended by a transaction which is aborted (see
+ * Transaction::abort()) is taken again by the next split, instead of the
+ * file growing.
+ *
+ * A tree is locked as a whole by its operations (see LockManager::of()):
+ * shared by find(), exclusively by insert() and remove(). Hence the nodes are
+ * never seen half-split, and no latch coupling is needed.
+ */
+class BTree final {
+ public:
+  /**
+   * Opens the B+tree in the given file. The file must have been created with
+   * create().
+   *
+   * @param fileName The name of the index file
+   */
+  explicit BTree(std::string fileName);
+
+  /**
+   * Creates an empty B+tree in the given file, removing the file first if
+   * it exists.
+   *
+   * @param fileName The name of the index file
+   * @return Success/failure
+   */
+  static bool create(const std::string &fileName);
+
+  /**
+   * Inserts an entry.
+   *
+   * @param key The key
+   * @param rid The record id, see makeRid()
+   * @return Success/failure
+   */
+  bool insert(sint_t key, uint_t rid);
+
+  /**
+   * Removes an entry.
+   *
+   * @param key The key
+   * @param rid The record id, see makeRid()
+   * @return Whether the entry was found and removed
+   */
+  bool remove(sint_t key, uint_t rid);
+
+  /**
+   * Finds the record ids of the entries with the given key.
+   *
+   * @param key The key
+   * @param rids Output vector, to which the found record ids are appended in
+   * ascending order
+   * @param limit The maximum number of record ids to be found (0 means no
+   * limit)
+   * @return Success/failure. Finding no entries is not a failure.
+   */
+  bool find(sint_t key, std::vector<uint_t> &rids, size_t limit = 0);
+
+  /**
+   * Gives the record id of a record from its page and slot.
+   *
+   * @param locPageAddr The local address of the page of the record
+   * @param slot The index of the cell of the record in the page
+   * @return The record id
+   */
+  static uint_t makeRid(uint_t locPageAddr, uint_t slot) {
+    return (locPageAddr << RID_SLOT_BITS) | slot;
+  }
+
+  static uint_t ridPage(uint_t rid) { return rid >> RID_SLOT_BITS; }
+
+  static uint_t ridSlot(uint_t rid) {
+    return rid & ((uint_t(1) << RID_SLOT_BITS) - 1);
+  }
+
+ private:
+  struct Entry {
+    sint_t key;
+    uint_t rid;
+
+    bool operator<(const Entry &other) const {
+      return key < other.key || (key == other.key && rid < other.rid);
+    }
+
+    bool operator<=(const Entry &other) const { return !(other < *this); }
+  };
+
+  struct Node {
+    bool isLeaf = true;
+    uint_t next = 0;  // The next leaf, or 0 if this is the last one
+    std::vector<Entry> entries;
+    std::vector<uint_t> children;  // Empty for leaves
+  };
+
+  bool load(uint_t locAddr, Node &node);
+  bool store(uint_t locAddr, const Node &node);
+  uint_t newNode();
+
+  bool insertAt(uint_t locAddr, const Entry &entry, bool &split, Entry &sep,
+                uint_t &sibling);
+
+  /**
+   * Descends to the leaf in which the given entry is or would be.
+   */
+  uint_t findLeaf(const Entry &entry);
+
+  uint_t root();
+  bool setRoot(uint_t locAddr);
+
+  std::string fileName;
+
+  static const uint_t RID_SLOT_BITS = 16;
+  static const uint_t NODE_HEADER_SIZE = 3 * sizeof(uint_t);
+};
+
+#endif  // STGMGR_BTREE_H
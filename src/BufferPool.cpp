@@ -0,0 +1,449 @@
+//
+// Created by Alper Çakan on 9.04.2018.
+//
+
+#include "BufferPool.h"
+#include "Disc.h"
+#include "LockManager.h"
+#include "Page.h"
+#include "Stats.h"
+#include "Wal.h"
+
+#include <algorithm>
+#include <cstring>
+
+using std::lock_guard;
+using std::pair;
+using std::string;
+using std::unordered_map;
+using std::vector;
+
+std::mutex BufferPool::mutex;
+char *BufferPool::pool = nullptr;
+uint_t BufferPool::frameSize = 0;
+vector<BufferPool::Frame> BufferPool::frames;
+unordered_map<BufferPool::PageId, int, BufferPool::PageIdHash>
+    BufferPool::pageTable;
+size_t BufferPool::clockHand = 0;
+size_t BufferPool::markedSinceCheck = 0;
+unordered_map<string, uint_t> BufferPool::nextMiss;
+vector<char> BufferPool::readAheadBuffer;
+
+void BufferPool::init() {
+  if (pool && frameSize == Disc::pageSize) return;
+
+  // The pages held for the old size are of a database which is closed
+  delete[] pool;
+  pool = new char[FRAME_COUNT * Disc::pageSize];
+  frameSize = Disc::pageSize;
+
+  if (frames.empty()) {
+    frames.resize(FRAME_COUNT);
+
+    for (auto &frame : frames) {
+      pthread_rwlock_init(&frame.latch, nullptr);
+    }
+  }
+
+  for (auto &frame : frames) {
+    frame.id = PageId();
+    frame.valid = false;
+    frame.dirty = false;
+  }
+
+  pageTable.clear();
+  pageTable.reserve(FRAME_COUNT);
+  nextMiss.clear();
+}
+
+char *BufferPool::frameData(int frame) { return pool + frame * frameSize; }
+
+bool BufferPool::isUncommitted(int frame, uint_t committedLsn) {
+  return frames[frame].valid && frames[frame].dirty &&
+         Page::lsnOf(frameData(frame)) > committedLsn;
+}
+
+int BufferPool::victim() {
+  const auto committedLsn = Wal::committedLsn();
+
+  // Two full sweeps are enough: the first one clears the reference bits, so
+  // the second one finds a frame unless every frame is pinned or holds a
+  // change which is not committed yet.
+  for (size_t i = 0; i < 2 * FRAME_COUNT; ++i) {
+    auto &frame = frames[clockHand];
+    int candidate = clockHand;
+    clockHand = (clockHand + 1) % FRAME_COUNT;
+
+    // A discarded frame may still be pinned (see discardFile())
+    if (frame.pinCount > 0) continue;
+    if (!frame.valid) return candidate;
+
+    if (frame.referenced) {
+      frame.referenced = false;
+      continue;
+    }
+
+    if (frame.dirty &&
+        (isUncommitted(candidate, committedLsn) || !flush(candidate))) {
+      continue;
+    }
+
+    pageTable.erase(frame.id);
+    frame.valid = false;
+    Stats::add(Stats::POOL_EVICTIONS);
+    return candidate;
+  }
+
+  return -1;
+}
+
+int BufferPool::pin(const string &fileName, uint_t locPageAddr) {
+  lock_guard<std::mutex> guard(mutex);
+  init();
+
+  PageId id{fileName, locPageAddr};
+  auto it = pageTable.find(id);
+
+  if (it != pageTable.end()) {
+    auto &frame = frames[it->second];
+    ++frame.pinCount;
+    frame.referenced = true;
+    Stats::add(Stats::POOL_HITS);
+    return it->second;
+  }
+
+  Stats::add(Stats::POOL_MISSES);
+
+  // A miss on the page right after the previous miss of the same file means
+  // the file is being scanned, so the pages following it are read together
+  auto &expected = nextMiss[fileName];
+  uint_t count = 1;
+
+  if (expected == locPageAddr) {
+    auto pageCount = Disc::getPageCount(fileName);
+
+    while (count < READ_AHEAD_PAGES && locPageAddr + count <= pageCount &&
+           !pageTable.count(PageId{fileName, locPageAddr + count})) {
+      ++count;
+    }
+  }
+
+  expected = locPageAddr + count;
+
+  int idx = victim();
+
+  if (idx < 0) return -1;
+
+  if (count == 1) {
+    if (!Disc::readPage(fileName, locPageAddr, frameData(idx))) return -1;
+  } else {
+    readAheadBuffer.resize(size_t(READ_AHEAD_PAGES) * Disc::pageSize);
+
+    if (!Disc::readPages(fileName, locPageAddr, count,
+                         readAheadBuffer.data())) {
+      return -1;
+    }
+
+    memcpy(frameData(idx), readAheadBuffer.data(), Disc::pageSize);
+  }
+
+  install(idx, id, 1);
+
+  // The pages read ahead are left unpinned. Failing to get a frame for them
+  // is not an error, since they are only read early.
+  for (uint_t i = 1; i < count; ++i) {
+    int ahead = victim();
+
+    if (ahead < 0) break;
+
+    memcpy(frameData(ahead), readAheadBuffer.data() + i * Disc::pageSize,
+           Disc::pageSize);
+    install(ahead, PageId{fileName, locPageAddr + i}, 0);
+    Stats::add(Stats::POOL_READ_AHEAD);
+  }
+
+  return idx;
+}
+
+int BufferPool::pinCached(const string &fileName, uint_t locPageAddr) {
+  lock_guard<std::mutex> guard(mutex);
+
+  if (!pool || frameSize != Disc::pageSize) return -1;
+
+  auto it = pageTable.find(PageId{fileName, locPageAddr});
+
+  if (it == pageTable.end()) return -1;
+
+  auto &frame = frames[it->second];
+  ++frame.pinCount;
+  frame.referenced = true;
+  Stats::add(Stats::POOL_HITS);
+  return it->second;
+}
+
+void BufferPool::install(int idx, const PageId &id, uint_t pinCount) {
+  auto &frame = frames[idx];
+  frame.id = id;
+  frame.pinCount = pinCount;
+  frame.dirty = false;
+  frame.referenced = true;
+  frame.valid = true;
+  pageTable[id] = idx;
+}
+
+void BufferPool::unpin(int frame, bool dirty) {
+  lock_guard<std::mutex> guard(mutex);
+  auto &f = frames[frame];
+
+  if (f.pinCount > 0) --f.pinCount;
+  if (dirty && f.valid) f.dirty = true;
+}
+
+void BufferPool::latch(int frame, bool exclusive) {
+  // A pinned frame is never replaced, so its latch stays with the page
+  if (exclusive) {
+    pthread_rwlock_wrlock(&frames[frame].latch);
+  } else {
+    pthread_rwlock_rdlock(&frames[frame].latch);
+  }
+}
+
+void BufferPool::unlatch(int frame) {
+  pthread_rwlock_unlock(&frames[frame].latch);
+}
+
+void BufferPool::latchPage(int frame, const PageId &id, bool exclusive) {
+  if (Disc::backend == Disc::BACKEND_MMAP) {
+    LockManager::latch(id.fileName, id.locAddr, exclusive);
+  } else {
+    latch(frame, exclusive);
+  }
+}
+
+void BufferPool::unlatchPage(int frame, const PageId &id) {
+  if (Disc::backend == Disc::BACKEND_MMAP) {
+    LockManager::unlatch(id.fileName, id.locAddr);
+  } else {
+    unlatch(frame);
+  }
+}
+
+void BufferPool::markDirty(int frame) {
+  lock_guard<std::mutex> guard(mutex);
+  auto &f = frames[frame];
+
+  if (f.valid) f.dirty = true;
+
+  ++markedSinceCheck;
+}
+
+bool BufferPool::needsCommit() {
+  lock_guard<std::mutex> guard(mutex);
+
+  // Each frame marked since the last count adds at most one frame to it
+  if (markedSinceCheck < FRAME_COUNT / 4) return false;
+
+  const auto committedLsn = Wal::committedLsn();
+  size_t count = 0;
+
+  markedSinceCheck = 0;
+
+  for (size_t i = 0; i < frames.size(); ++i) {
+    if (isUncommitted(i, committedLsn)) ++count;
+  }
+
+  return count >= FRAME_COUNT / 2;
+}
+
+bool BufferPool::isCommitted(const string &fileName) {
+  lock_guard<std::mutex> guard(mutex);
+  const auto committedLsn = Wal::committedLsn();
+
+  for (size_t i = 0; i < frames.size(); ++i) {
+    if (frames[i].id.fileName == fileName && isUncommitted(i, committedLsn)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool BufferPool::flush(int frame) {
+  auto &f = frames[frame];
+  auto lsn = Page::lsnOf(frameData(frame));
+
+  // There is no undo, so a change which may yet be left half done never
+  // reaches the file
+  if (lsn > Wal::committedLsn() || !Wal::flush(lsn)) return false;
+
+  if (!Disc::writePage(f.id.fileName, f.id.locAddr, frameData(frame))) {
+    return false;
+  }
+
+  f.dirty = false;
+  return true;
+}
+
+bool BufferPool::writePage(const string &fileName, uint_t locPageAddr,
+                           const char *content) {
+  const PageId id{fileName, locPageAddr};
+  int frame = -1;
+
+  {
+    lock_guard<std::mutex> guard(mutex);
+    auto it = pool && frameSize == Disc::pageSize ? pageTable.find(id)
+                                                  : pageTable.end();
+
+    if (it != pageTable.end()) {
+      // The caller of a page in a frame holds the latch of the page
+      if (frameData(it->second) == content) return flush(it->second);
+
+      frame = it->second;
+      ++frames[frame].pinCount;
+    }
+  }
+
+  if (frame >= 0) {
+    bool suc = false, inPool;
+
+    latchPage(frame, id, true);
+
+    {
+      lock_guard<std::mutex> guard(mutex);
+
+      // The frame may have been discarded meanwhile
+      inPool = frames[frame].valid && frames[frame].id == id;
+
+      if (inPool) {
+        memcpy(frameData(frame), content, Disc::pageSize);
+        suc = flush(frame);
+      }
+    }
+
+    unlatchPage(frame, id);
+    unpin(frame, false);
+
+    if (inPool) return suc;
+  }
+
+  auto lsn = Page::lsnOf(content);
+
+  return lsn <= Wal::committedLsn() && Wal::flush(lsn) &&
+         Disc::writePage(fileName, locPageAddr, content);
+}
+
+bool BufferPool::writePages(const string &fileName, uint_t firstPageAddr,
+                            uint_t count, const char *pages) {
+  {
+    lock_guard<std::mutex> guard(mutex);
+    bool cached = false;
+    uint_t maxLsn = 0;
+
+    for (uint_t i = 0; i < count; ++i) {
+      cached = cached || (pool && frameSize == Disc::pageSize &&
+                          pageTable.count(PageId{fileName, firstPageAddr + i}));
+      maxLsn = std::max(maxLsn, Page::lsnOf(pages + i * Disc::pageSize));
+    }
+
+    // The mutex is held, so that no miss reads the pages half written
+    if (!cached) {
+      return maxLsn <= Wal::committedLsn() && Wal::flush(maxLsn) &&
+             Disc::writePages(fileName, firstPageAddr, count, pages);
+    }
+  }
+
+  for (uint_t i = 0; i < count; ++i) {
+    if (!writePage(fileName, firstPageAddr + i, pages + i * Disc::pageSize)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool BufferPool::flushFrames(const string *fileName) {
+  vector<pair<int, PageId>> dirty;
+
+  {
+    lock_guard<std::mutex> guard(mutex);
+
+    for (size_t i = 0; i < frames.size(); ++i) {
+      auto &frame = frames[i];
+
+      if (frame.valid && frame.dirty &&
+          (!fileName || frame.id.fileName == *fileName)) {
+        ++frame.pinCount;
+        dirty.push_back({int(i), frame.id});
+      }
+    }
+  }
+
+  bool suc = true;
+
+  for (const auto &frame : dirty) {
+    const auto i = frame.first;
+
+    // A writer changes the frame only while it is latched exclusively, so
+    // the frame is not written back half changed
+    latchPage(i, frame.second, false);
+
+    {
+      lock_guard<std::mutex> guard(mutex);
+
+      if (frames[i].valid && frames[i].dirty && frames[i].id == frame.second &&
+          !flush(i)) {
+        suc = false;
+      }
+    }
+
+    unlatchPage(i, frame.second);
+    unpin(i, false);
+  }
+
+  return suc;
+}
+
+bool BufferPool::flushAll() { return flushFrames(nullptr); }
+
+bool BufferPool::flushFile(const string &fileName) {
+  return flushFrames(&fileName);
+}
+
+void BufferPool::discardFile(const string &fileName) {
+  lock_guard<std::mutex> guard(mutex);
+
+  for (size_t i = 0; i < frames.size(); ++i) {
+    auto &frame = frames[i];
+
+    // A pinned frame stays with its Page object, which no longer reaches
+    // the file, until it is unpinned; its latch is left alone
+    if (frame.valid && frame.id.fileName == fileName) {
+      pageTable.erase(frame.id);
+      frame.id = PageId();
+      frame.valid = false;
+      frame.dirty = false;
+    }
+  }
+
+  nextMiss.erase(fileName);
+}
+
+bool BufferPool::discardAll() {
+  if (!flushFrames(nullptr)) return false;
+
+  lock_guard<std::mutex> guard(mutex);
+
+  for (const auto &frame : frames) {
+    if (frame.valid && frame.dirty) return false;  // Changed meanwhile
+  }
+
+  for (auto &frame : frames) {
+    frame.id = PageId();
+    frame.valid = false;
+    frame.dirty = false;
+  }
+
+  pageTable.clear();
+  nextMiss.clear();
+  return true;
+}
@@ -0,0 +1,283 @@
+//
+// Created by Alper Çakan on 9.04.2018.
+//
+
+#ifndef STGMGR_BUFFERPOOL_H
+#define STGMGR_BUFFERPOOL_H
+
+#include <pthread.h>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "constants.h"
+
+/**
+ * A fixed-size pool of page frames shared by all the Page objects.
+ *
+ * Physical pages are read into frames on demand and stay there until the
+ * frame is needed for another page. Frames are chosen for replacement with
+ * the CLOCK algorithm, and a frame is never replaced while it is pinned.
+ *
+ * Nor is a frame replaced (or written back) while it holds a change which is
+ * not committed yet, i.e. whose LSN is past the last commit record: the log
+ * has no undo, so a change written to its file before the operation making
+ * it is committed could not be taken back after a crash (no-steal). If all
+ * the unpinned frames hold such changes, pin() fails; the operations which
+ * change many pages commit as they go (see needsCommit()). This holds for
+ * Disc::BACKEND_MMAP as well: the pages are changed in the pool there too,
+ * and only the frames written back reach the mappings, which the kernel may
+ * write to the files at any time. The readers read the mappings in place
+ * unless the page is in the pool (see pinCached()).
+ *
+ * Misses on consecutive pages of a file are taken as a sequential scan: the
+ * next READ_AHEAD_PAGES pages are then read with a single read into unpinned
+ * frames, so that the scan finds them in the pool.
+ *
+ * The pool may be used by several threads at once. Its state is guarded by a
+ * single mutex, which is also held while a missed page is read, so the
+ * threads wait for each other on misses but not on hits. The content of a
+ * frame is guarded by the latch of the frame instead, which is taken by the
+ * Page objects after pinning it (see LockManager). With the mmap backend, the
+ * latch of the page kept by LockManager is taken instead, before pinning, so
+ * that it also guards the page in the mapping.
+ */
+class BufferPool {
+ public:
+  /**
+   * Pins the frame holding the given page, reading the page from the disc if
+   * it is not already in the pool.
+   *
+   * @param fileName The file name of the file in which the page resides
+   * @param locPageAddr The local address of the page
+   * @return The index of the pinned frame, or -1 if the page could not be
+   * read or no frame can be replaced
+   */
+  static int pin(const std::string &fileName, uint_t locPageAddr);
+
+  /**
+   * Pins the frame holding the given page only if the page is already in the
+   * pool. With the mmap backend, a page which is not in the pool is the same
+   * in the mapping, which a reader reads in place instead.
+   *
+   * @param fileName The file name of the file in which the page resides
+   * @param locPageAddr The local address of the page
+   * @return The index of the pinned frame, or -1 if the page is not in the
+   * pool
+   */
+  static int pinCached(const std::string &fileName, uint_t locPageAddr);
+
+  /**
+   * Releases one pin of a frame.
+   *
+   * @param frame The index of the frame
+   * @param dirty Whether the page was modified without being written back
+   */
+  static void unpin(int frame, bool dirty);
+
+  /**
+   * Waits until the latch of a pinned frame is taken.
+   *
+   * @param frame The index of the frame
+   * @param exclusive Whether the latch is exclusive (or shared)
+   */
+  static void latch(int frame, bool exclusive);
+
+  /**
+   * Releases the latch of a frame, which should be released before the frame
+   * is unpinned.
+   *
+   * @param frame The index of the frame
+   */
+  static void unlatch(int frame);
+
+  /**
+   * Marks a frame as modified, so that it is written back to the disc before
+   * it is replaced.
+   *
+   * @param frame The index of the frame
+   */
+  static void markDirty(int frame);
+
+  /**
+   * Gives the page data held in a frame.
+   *
+   * @param frame The index of the frame
+   * @return The pointer to the first byte of the page
+   */
+  static char *frameData(int frame);
+
+  /**
+   * Writes a page to the disc, and updates the frame holding it (if any) so
+   * that the pool stays coherent with the disc. Pages are written only after
+   * the write-ahead log is durable up to their LSN, and only if they are
+   * committed. A caller which gives the page held in a frame should hold its
+   * latch; any other frame holding the page is latched exclusively while it
+   * is updated.
+   *
+   * @param fileName The file name of the file in which the page resides
+   * @param locPageAddr The local address of the page
+   * @param content The whole page, including the header
+   * @return Success/failure
+   */
+  static bool writePage(const std::string &fileName, uint_t locPageAddr,
+                        const char *content);
+
+  /**
+   * Writes several consecutive pages to the disc with a single write, under
+   * the same conditions as writePage(). If one of them is held in a frame,
+   * they are written one by one with writePage() instead.
+   *
+   * @param fileName The file name of the file in which the pages reside
+   * @param firstPageAddr The local address of the first page
+   * @param count The number of pages
+   * @param pages The whole pages, one after another
+   * @return Success/failure
+   */
+  static bool writePages(const std::string &fileName, uint_t firstPageAddr,
+                         uint_t count, const char *pages);
+
+  /**
+   * Writes all the dirty frames back to the disc. Each frame is latched
+   * shared while it is written, so the calling thread should not hold a page
+   * exclusively.
+   *
+   * @return Success/failure. Fails if a change is not committed yet.
+   */
+  static bool flushAll();
+
+  /**
+   * Writes the dirty frames of a file back to the disc, so that the file can
+   * be read directly. Like flushAll(), latches each frame shared.
+   *
+   * @param fileName The name of the file
+   * @return Success/failure. Fails if a change of the file is not committed
+   * yet (see isCommitted()).
+   */
+  static bool flushFile(const std::string &fileName);
+
+  /**
+   * Whether all the changes of a file in the pool are committed, so that
+   * flushFile() may write them back.
+   *
+   * @param fileName The name of the file
+   */
+  static bool isCommitted(const std::string &fileName);
+
+  /**
+   * Whether so many frames hold changes which are not committed yet that an
+   * operation which changes many pages should commit before it goes on, or
+   * it may find no frame to replace. The count is taken only once in a while.
+   */
+  static bool needsCommit();
+
+  /**
+   * Drops all the frames of a file without writing them back. Should be
+   * called when the file is removed or recreated. A frame which is still
+   * pinned is left to its Page object, which may go on using it, and is
+   * reused only after it is unpinned.
+   *
+   * @param fileName The name of the file
+   */
+  static void discardFile(const std::string &fileName);
+
+  /**
+   * Writes all the dirty frames back to the disc and drops all the frames, so
+   * that the next pages are read from the files of the database opened next.
+   * Like discardFile(), leaves a pinned frame to its Page object.
+   *
+   * @return Success/failure. On failure, no frame is dropped.
+   */
+  static bool discardAll();
+
+  static const size_t FRAME_COUNT = BUFFER_POOL_FRAME_COUNT;
+
+ private:
+  struct PageId {
+    std::string fileName;
+    uint_t locAddr;
+
+    bool operator==(const PageId &other) const {
+      return locAddr == other.locAddr && fileName == other.fileName;
+    }
+  };
+
+  struct PageIdHash {
+    size_t operator()(const PageId &id) const {
+      return std::hash<std::string>()(id.fileName) ^ (id.locAddr * 31);
+    }
+  };
+
+  struct Frame {
+    PageId id;
+    uint_t pinCount = 0;
+    bool dirty = false;
+    bool referenced = false;
+    bool valid = false;
+    pthread_rwlock_t latch;
+  };
+
+  /**
+   * Allocates the frames, or reallocates them if Disc::pageSize has changed
+   * since, which it does only while no frame is pinned (see discardAll()).
+   */
+  static void init();
+  static int victim();
+
+  /**
+   * Makes a frame hold the given page, which must already be in the frame.
+   */
+  static void install(int idx, const PageId &id, uint_t pinCount);
+
+  /**
+   * Whether a frame holds a change which is not committed yet.
+   */
+  static bool isUncommitted(int frame, uint_t committedLsn);
+
+  /**
+   * Writes a frame back, unless it holds a change which is not committed yet.
+   * The caller should hold the mutex, and either the latch of the page or
+   * the only pin of it (as victim() does).
+   */
+  static bool flush(int frame);
+
+  /**
+   * Latches the page held in a pinned frame, by the latch of the frame, or
+   * with the mmap backend by the one kept by LockManager (see Page).
+   *
+   * @param frame The index of the frame
+   * @param id The page, which the frame held when it was pinned
+   * @param exclusive Whether the latch is exclusive (or shared)
+   */
+  static void latchPage(int frame, const PageId &id, bool exclusive);
+
+  static void unlatchPage(int frame, const PageId &id);
+
+  /**
+   * Writes the dirty frames back, each while it is pinned and latched shared.
+   * The mutex is not held while a latch is waited for, and the calling
+   * thread should not hold the latch of a dirty frame exclusively.
+   *
+   * @param fileName The name of the file whose frames are written, or null
+   * for all the frames
+   * @return Success/failure
+   */
+  static bool flushFrames(const std::string *fileName);
+
+  static std::mutex mutex;
+  static char *pool;
+  static uint_t frameSize;  // The page size for which the pool was allocated
+  static std::vector<Frame> frames;
+  static std::unordered_map<PageId, int, PageIdHash> pageTable;
+  static size_t clockHand;
+  static size_t markedSinceCheck;  // Frames marked dirty since needsCommit()
+
+  /**
+   * The local address of the page which would be missed next by a sequential
+   * scan, for each file
+   */
+  static std::unordered_map<std::string, uint_t> nextMiss;
+  static std::vector<char> readAheadBuffer;
+};
+
+#endif  // STGMGR_BUFFERPOOL_H
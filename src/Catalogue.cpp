@@ -0,0 +1,176 @@
+//
+// Created by Alper Çakan on 9.04.2018.
+//
+
+#include "Catalogue.h"
+#include "Page.h"
+
+#include <algorithm>
+#include <cstring>
+
+using std::lock_guard;
+using std::pair;
+using std::string;
+using std::unordered_map;
+using std::vector;
+
+std::mutex Catalogue::mutex, Catalogue::loadMutex;
+bool Catalogue::loaded = false;
+unordered_map<string, TypeSchema> Catalogue::types;
+
+size_t Catalogue::fieldPageFormatPos() {
+  return Page::contentSize() - sizeof(uint_t);
+}
+
+size_t Catalogue::fieldPageIndexedPos() {
+  // A bit for each field which would fit without the bitmap
+  auto words = (fieldPageFormatPos() / FIELD_NAME_SIZE + 63) / 64;
+
+  return fieldPageFormatPos() - words * sizeof(uint_t);
+}
+
+size_t Catalogue::maxFieldCount() {
+  return fieldPageIndexedPos() / FIELD_NAME_SIZE;
+}
+
+string Catalogue::indexFileName(const string &typeName, size_t field) {
+  return typeName + ".idx." + std::to_string(field);
+}
+
+bool Catalogue::load() {
+  invalidate();
+
+  // The pages are read without the mutex, which the threads holding their
+  // latches may be waiting for
+  unordered_map<string, TypeSchema> loadedTypes;
+  Page *typePage = new Page(SYS_CATALOGUE_TYPES_FILE_NAME, 1);
+
+  while (typePage && *typePage) {
+    if (typePage->isUsed()) {
+      for (int i = 0; i < Page::cellCapacity(TYPE_DATA_SIZE); ++i) {
+        auto cell = typePage->content() + i * TYPE_DATA_SIZE;
+
+        if (typePage->isCellUsed(i)) {
+          string name(cell, strnlen(cell, TYPE_NAME_SIZE));
+          auto fieldNameCount =
+              *reinterpret_cast<const sint_t *>(cell + TYPE_NAME_SIZE);
+          auto fieldPageAddr = *reinterpret_cast<const uint_t *>(
+              cell + TYPE_NAME_SIZE + sizeof(uint_t));
+          Page fieldNamesPage(SYS_CATALOGUE_FIELDS_FILE_NAME, fieldPageAddr);
+
+          if (!fieldNamesPage) {
+            delete typePage;
+            return false;
+          }
+
+          TypeSchema schema;
+          schema.fieldNames.resize(fieldNameCount);
+          schema.indexed.resize(fieldNameCount);
+          schema.fieldPageAddr = fieldPageAddr;
+          schema.typePageAddr = typePage->getLocAddr();
+          schema.typeCellIndex = i;
+          schema.format = DataLayout::Format(
+              fieldNamesPage.getUIntAtPos(fieldPageFormatPos()));
+
+          for (size_t j = 0; j < size_t(fieldNameCount); ++j) {
+            schema.fieldNames[j] =
+                fieldNamesPage.content() + j * FIELD_NAME_SIZE;
+            schema.indexed[j] =
+                (fieldNamesPage.getUIntAtPos(fieldPageIndexedPos() +
+                                             j / 64 * sizeof(uint_t)) >>
+                 (j % 64)) & 1;
+          }
+
+          loadedTypes.emplace(name, schema);
+        }
+      }
+    }
+
+    auto tmp = typePage;
+    typePage = typePage->getConsecPage();
+    delete tmp;
+  }
+
+  delete typePage;
+
+  lock_guard<std::mutex> guard(mutex);
+  types = std::move(loadedTypes);
+  loaded = true;
+  return true;
+}
+
+const TypeSchema *Catalogue::find(const string &typeName) {
+  if (!ensureLoaded()) return nullptr;
+
+  lock_guard<std::mutex> guard(mutex);
+  auto it = types.find(typeName);
+
+  return it == types.end() ? nullptr : &it->second;
+}
+
+vector<pair<string, TypeSchema>> Catalogue::list() {
+  vector<pair<string, TypeSchema>> res;
+
+  if (!ensureLoaded()) return res;
+
+  {
+    lock_guard<std::mutex> guard(mutex);
+    res.assign(types.begin(), types.end());
+  }
+
+  std::sort(res.begin(), res.end(),
+            [](const pair<string, TypeSchema> &a,
+               const pair<string, TypeSchema> &b) {
+              return a.second.typePageAddr < b.second.typePageAddr ||
+                     (a.second.typePageAddr == b.second.typePageAddr &&
+                      a.second.typeCellIndex < b.second.typeCellIndex);
+            });
+
+  return res;
+}
+
+void Catalogue::put(const string &typeName, const TypeSchema &schema) {
+  lock_guard<std::mutex> guard(mutex);
+
+  if (loaded) types[typeName] = schema;
+}
+
+void Catalogue::setIndexed(const string &typeName, size_t field,
+                           bool indexed) {
+  lock_guard<std::mutex> guard(mutex);
+  auto it = types.find(typeName);
+
+  if (it != types.end() && field < it->second.indexed.size()) {
+    it->second.indexed[field] = indexed;
+  }
+}
+
+void Catalogue::erase(const string &typeName) {
+  lock_guard<std::mutex> guard(mutex);
+  types.erase(typeName);
+}
+
+void Catalogue::invalidate() {
+  lock_guard<std::mutex> guard(mutex);
+  types.clear();
+  loaded = false;
+}
+
+bool Catalogue::ensureLoaded() {
+  {
+    lock_guard<std::mutex> guard(mutex);
+
+    if (loaded) return true;
+  }
+
+  // Only one thread reads the catalogue; the others wait for it
+  lock_guard<std::mutex> guard(loadMutex);
+
+  {
+    lock_guard<std::mutex> guard(mutex);
+
+    if (loaded) return true;
+  }
+
+  return load();
+}
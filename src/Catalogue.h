@@ -0,0 +1,151 @@
+//
+// Created by Alper Çakan on 9.04.2018.
+//
+
+#ifndef STGMGR_CATALOGUE_H
+#define STGMGR_CATALOGUE_H
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "DataLayout.h"
+#include "constants.h"
+
+/**
+ * The schema of a type, as registered in the system catalogue.
+ */
+struct TypeSchema {
+  std::vector<std::string> fieldNames;
+
+  /**
+   * Whether each field is indexed.
+   */
+  std::vector<bool> indexed;
+
+  /**
+   * The format of the data pages of the type
+   */
+  DataLayout::Format format = DataLayout::FORMAT_ROW;
+
+  /**
+   * The local address of the page of the field names in the fields catalogue
+   */
+  uint_t fieldPageAddr = 0;
+
+  /**
+   * The local address of the page of the type in the types catalogue
+   */
+  uint_t typePageAddr = 0;
+
+  /**
+   * The index of the cell of the type in its page in the types catalogue
+   */
+  uint_t typeCellIndex = 0;
+};
+
+/**
+ * An in-memory copy of the system catalogue, which maps type names to their
+ * schemas.
+ *
+ * The catalogue is read from the disc on first use. The functions which
+ * modify the system catalogue on the disc are responsible for keeping this
+ * copy coherent.
+ *
+ * The copy is guarded by a mutex. The schema of a type is modified only while
+ * the type is locked exclusively, so it may be read through the pointer given
+ * by find() while the type is locked in any mode (see LockManager).
+ */
+class Catalogue {
+ public:
+  /**
+   * Finds the schema of a type.
+   *
+   * @param typeName The name of the type
+   * @return The schema, or null if there is no such type (or the catalogue
+   * could not be read). The pointer is valid until the type is deleted.
+   */
+  static const TypeSchema *find(const std::string &typeName);
+
+  /**
+   * Gives all the types, in the order in which they are placed in the types
+   * catalogue.
+   *
+   * @return The vector of pairs (Type Name, Schema), with copies of the
+   * schemas
+   */
+  static std::vector<std::pair<std::string, TypeSchema>> list();
+
+  /**
+   * Adds (or replaces) the schema of a type.
+   */
+  static void put(const std::string &typeName, const TypeSchema &schema);
+
+  /**
+   * Marks a field of a type as indexed.
+   */
+  static void setIndexed(const std::string &typeName, size_t field,
+                         bool indexed);
+
+  /**
+   * Removes a type.
+   */
+  static void erase(const std::string &typeName);
+
+  /**
+   * Drops the in-memory copy, so that it is read from the disc on next use.
+   */
+  static void invalidate();
+
+  /**
+   * Reads the whole system catalogue from the disc. Should be called while
+   * no type is created or deleted, e.g. when the database is opened.
+   *
+   * @return Success/failure
+   */
+  static bool load();
+
+  /**
+   * Gives the name of the file of the index on a field of a type.
+   *
+   * @param typeName The name of the type
+   * @param field The index of the field (0 for the primary key)
+   * @return The file name
+   */
+  static std::string indexFileName(const std::string &typeName, size_t field);
+
+  /**
+   * Gives the position of the data format of a type in its page in the
+   * fields catalogue. It is the last word of the page.
+   */
+  static size_t fieldPageFormatPos();
+
+  /**
+   * Gives the position of the bitmap of the indexed fields of a type in its
+   * page in the fields catalogue, which is between the space of the field
+   * names and the data format. A bit is set only once the index on its field
+   * is complete, so an index file without its bit is not used.
+   */
+  static size_t fieldPageIndexedPos();
+
+  /**
+   * Gives the largest number of fields a type may have, which depends on the
+   * page size.
+   */
+  static size_t maxFieldCount();
+
+ private:
+  /**
+   * Reads the system catalogue if it is not read yet.
+   *
+   * @return Success/failure
+   */
+  static bool ensureLoaded();
+
+  static std::mutex mutex, loadMutex;
+  static bool loaded;
+  static std::unordered_map<std::string, TypeSchema> types;
+};
+
+#endif  // STGMGR_CATALOGUE_H
@@ -0,0 +1,112 @@
+//
+// Created by Alper Çakan on 9.04.2018.
+//
+
+#include "Cursor.h"
+#include "Page.h"
+
+#include <utility>
+
+using std::string;
+
+Cursor::Cursor(const string &fileName, size_t fieldCount,
+               DataLayout::Format format, const ParallelScan::Filter *filter)
+    : fieldCount(fieldCount),
+      format(format),
+      filtered(filter != nullptr),
+      lock(fileName, Lock::INTENT_SHARED),
+      page(new Page(fileName, 1)) {
+  if (filter) this->filter = *filter;
+
+  if (!(*page)) {
+    delete page;
+    page = nullptr;
+    error = true;
+    return;
+  }
+
+  selectSlots();
+}
+
+Cursor::Cursor(Cursor &&other) noexcept { *this = std::move(other); }
+
+Cursor &Cursor::operator=(Cursor &&other) noexcept {
+  if (this != &other) {
+    delete page;
+
+    lock = std::move(other.lock);
+    fieldCount = other.fieldCount;
+    format = other.format;
+    filter = other.filter;
+    filtered = other.filtered;
+    error = other.error;
+    page = other.page;
+    slots = std::move(other.slots);
+    pos = other.pos;
+    inPlace = other.inPlace;
+    values = std::move(other.values);
+    current = other.current;
+
+    other.page = nullptr;
+    other.current = Record();
+  }
+
+  return *this;
+}
+
+Cursor::~Cursor() { delete page; }
+
+void Cursor::selectSlots() {
+  slots.clear();
+  pos = 0;
+
+  if (!page->isUsed()) return;
+
+  auto layout = DataLayout::ofImage(page->image(), fieldCount, format);
+
+  if (filtered) {
+    layout.select(page->image(), filter.field, filter.low, filter.high, slots);
+  } else {
+    layout.usedSlots(page->image(), slots);
+  }
+
+  inPlace = layout.format() == DataLayout::FORMAT_ROW;
+
+  if (!inPlace) {
+    values.resize(slots.size() * fieldCount);
+    layout.readSlots(page->image(), slots, values.data());
+  }
+}
+
+bool Cursor::next() {
+  while (page && pos == slots.size()) {
+    auto tmp = page;
+    page = page->getConsecPage();
+    delete tmp;
+
+    if (page) selectSlots();
+  }
+
+  if (!page) {
+    current = Record();
+    return false;
+  }
+
+  if (inPlace) {
+    auto image = page->image();
+    current = Record(DataLayout::ofImage(image, fieldCount, format)
+                         .row(image, slots[pos]),
+                     fieldCount);
+  } else {
+    current = Record(values.data() + pos * fieldCount, fieldCount);
+  }
+
+  ++pos;
+  return true;
+}
+
+PageNumber Cursor::pageNumber() const {
+  if (!page) return {0, 0};
+
+  return {page->globAddr(), page->getLocAddr()};
+}
@@ -0,0 +1,147 @@
+//
+// Created by Alper Çakan on 9.04.2018.
+//
+
+#ifndef STGMGR_CURSOR_H
+#define STGMGR_CURSOR_H
+
+#include <string>
+#include <vector>
+#include "DataLayout.h"
+#include "LockManager.h"
+#include "ParallelScan.h"
+#include "Record.h"
+#include "constants.h"
+
+class Page;
+
+/**
+ * A serial scan of the data file of a type, which gives its records one at a
+ * time, in the order of the file.
+ *
+ * Only the page of the current record is pinned. In the row format, the
+ * current record is a view of its cell in that page; in the PAX and packed
+ * formats, the records of a page are decoded together, one field at a time,
+ * into a buffer of the cursor when it reaches the page. Either way, no memory
+ * is allocated per record, and a record is valid only until the cursor moves.
+ *
+ * The type is locked in intent shared mode while the cursor is open, and
+ * the current page is latched shared, so other threads may modify the type
+ * meanwhile, except for the current page. The thread which opened a cursor
+ * may not modify the type, nor commit, while it is open.
+ *
+ *     Cursor cursor(typeName, fieldCount, format);
+ *
+ *     for (Record record : cursor) {
+ *       ...
+ *     }
+ */
+class Cursor {
+ public:
+  /**
+   * An input iterator over the records of a cursor, for range-for.
+   */
+  class Iterator {
+   public:
+    explicit Iterator(Cursor *cursor) : cursor(cursor) {}
+
+    Record operator*() const { return cursor->record(); }
+
+    Iterator &operator++() {
+      if (!cursor->next()) cursor = nullptr;
+
+      return *this;
+    }
+
+    bool operator!=(const Iterator &other) const {
+      return cursor != other.cursor;
+    }
+
+   private:
+    Cursor *cursor;
+  };
+
+  /**
+   * Constructs a cursor which has no records.
+   */
+  Cursor() = default;
+
+  /**
+   * Opens a cursor before the first record of a type.
+   *
+   * @param fileName The name of the data file
+   * @param fieldCount The number of fields of the type
+   * @param format The format of the type
+   * @param filter The filter which the records should match, or null for all
+   * the records
+   */
+  Cursor(const std::string &fileName, size_t fieldCount,
+         DataLayout::Format format,
+         const ParallelScan::Filter *filter = nullptr);
+
+  Cursor(Cursor &&other) noexcept;
+
+  Cursor &operator=(Cursor &&other) noexcept;
+
+  Cursor(const Cursor &) = delete;
+
+  Cursor &operator=(const Cursor &) = delete;
+
+  /**
+   * Unpins the current page, and releases the lock of the type.
+   */
+  ~Cursor();
+
+  /**
+   * Moves to the next record.
+   *
+   * @return Whether there is one. At the end, or if the data file could not
+   * be read (see failed()), there is not.
+   */
+  bool next();
+
+  /**
+   * Gives the current record, which is valid until the cursor moves.
+   */
+  Record record() const { return current; }
+
+  /**
+   * Gives the page of the current record.
+   */
+  PageNumber pageNumber() const;
+
+  /**
+   * Whether the data file could not be read.
+   */
+  bool failed() const { return error; }
+
+  /**
+   * Moves to the first record, and gives the iterator at it.
+   */
+  Iterator begin() { return Iterator(next() ? this : nullptr); }
+
+  Iterator end() { return Iterator(nullptr); }
+
+ private:
+  /**
+   * Finds the slots of the current page to be given.
+   */
+  void selectSlots();
+
+  size_t fieldCount = 0;
+  DataLayout::Format format = DataLayout::FORMAT_ROW;
+  ParallelScan::Filter filter = {0, 0, 0};
+  bool filtered = false;
+  bool error = false;
+
+  TypeLock lock;
+  Page *page = nullptr;
+  std::vector<size_t> slots;
+  size_t pos = 0;  // The index of the next slot to be given
+
+  bool inPlace = true;         // Whether the records are given in the page
+  std::vector<sint_t> values;  // The decoded records of the page
+  Record current;
+};
+
+#endif  // STGMGR_CURSOR_H
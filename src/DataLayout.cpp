@@ -0,0 +1,678 @@
+//
+// Created by Alper Çakan on 9.04.2018.
+//
+
+#include "DataLayout.h"
+#include "Page.h"
+
+#include <algorithm>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define STGMGR_AVX2_DISPATCH
+#endif
+
+using std::string;
+using std::vector;
+
+static const uint_t WORD_BITS = 64;
+
+/**
+ * Appends the indices of the set bits of a mask, offset by the given base.
+ */
+static void appendBits(uint_t mask, size_t base, vector<size_t> &slots) {
+  while (mask) {
+    slots.push_back(base + __builtin_ctzll(mask));
+    mask &= mask - 1;
+  }
+}
+
+/**
+ * Finds the used slots of a minipage in [low, high], 64 slots (one word of the
+ * occupancy bitmap) at a time. The inner loop is simple enough to be
+ * vectorized by the compiler.
+ */
+static void selectScalar(const sint_t *column, const uint_t *bitmap,
+                         size_t count, sint_t low, sint_t high,
+                         vector<size_t> &slots) {
+  for (size_t base = 0; base < count; base += WORD_BITS) {
+    auto used = bitmap[base / WORD_BITS];
+
+    if (!used) continue;
+
+    auto n = std::min<size_t>(WORD_BITS, count - base);
+    uint_t mask = 0;
+
+    for (size_t i = 0; i < n; ++i) {
+      mask |= uint_t(column[base + i] >= low && column[base + i] <= high) << i;
+    }
+
+    appendBits(mask & used, base, slots);
+  }
+}
+
+#ifdef STGMGR_AVX2_DISPATCH
+/**
+ * Like selectScalar(), but compares four values at a time with AVX2.
+ */
+__attribute__((target("avx2"))) static void selectAvx2(
+    const sint_t *column, const uint_t *bitmap, size_t count, sint_t low,
+    sint_t high, vector<size_t> &slots) {
+  const __m256i lowVec = _mm256_set1_epi64x(low);
+  const __m256i highVec = _mm256_set1_epi64x(high);
+
+  for (size_t base = 0; base < count; base += WORD_BITS) {
+    auto used = bitmap[base / WORD_BITS];
+
+    if (!used) continue;
+
+    auto n = std::min<size_t>(WORD_BITS, count - base);
+    uint_t mask = 0;
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+      auto values = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i *>(column + base + i));
+      auto outside = _mm256_or_si256(_mm256_cmpgt_epi64(lowVec, values),
+                                     _mm256_cmpgt_epi64(values, highVec));
+      uint_t inside =
+          ~_mm256_movemask_pd(_mm256_castsi256_pd(outside)) & 0xF;
+      mask |= inside << i;
+    }
+
+    for (; i < n; ++i) {
+      mask |= uint_t(column[base + i] >= low && column[base + i] <= high) << i;
+    }
+
+    appendBits(mask & used, base, slots);
+  }
+}
+#endif
+
+/*
+ * The header of a packed page is PACKED_FIELD_WORDS words per field after
+ * the slot count: the smallest value, the largest value and the descriptor of
+ * the minipage, which is its width in bits | its word position << 8.
+ */
+static const size_t PACKED_FIELD_WORDS = 3;
+
+static size_t packedHeaderWords(size_t fieldCount) {
+  return 1 + PACKED_FIELD_WORDS * fieldCount;
+}
+
+static const uint_t *packedWords(const char *image) {
+  return reinterpret_cast<const uint_t *>(Page::contentOf(image));
+}
+
+static sint_t packedMin(const char *image, size_t field) {
+  return sint_t(packedWords(image)[1 + PACKED_FIELD_WORDS * field]);
+}
+
+static sint_t packedMax(const char *image, size_t field) {
+  return sint_t(packedWords(image)[2 + PACKED_FIELD_WORDS * field]);
+}
+
+static uint_t packedWidth(const char *image, size_t field) {
+  return packedWords(image)[3 + PACKED_FIELD_WORDS * field] & 0xFF;
+}
+
+static const uint_t *packedColumn(const char *image, size_t field) {
+  return packedWords(image) +
+         (packedWords(image)[3 + PACKED_FIELD_WORDS * field] >> 8);
+}
+
+/**
+ * Gives the width in bits of the offsets of the values in [min, max] from
+ * min: a power of two, or 0 if min is max.
+ */
+static uint_t packedWidth(sint_t min, sint_t max) {
+  uint_t range = uint_t(max) - uint_t(min);
+
+  if (!range) return 0;
+
+  uint_t bits = WORD_BITS - __builtin_clzll(range), width = 1;
+
+  while (width < bits) width <<= 1;
+
+  return width;
+}
+
+static size_t packedColumnWords(size_t slotCount, uint_t width) {
+  return (slotCount * width + WORD_BITS - 1) / WORD_BITS;
+}
+
+/**
+ * Gives the number of the slots of a packed page whose fields have the given
+ * widths: the most whose minipages fit in the content after the header.
+ */
+static size_t packedCapacity(const vector<uint_t> &widths) {
+  size_t words = Page::contentSize() / sizeof(uint_t);
+  size_t header = packedHeaderWords(widths.size());
+
+  if (header >= words) return 0;
+
+  words -= header;
+
+  size_t totalWidth = 0;
+
+  for (auto width : widths) totalWidth += width;
+
+  size_t low = 0, high = Page::maxSlotCount();
+
+  if (totalWidth) {
+    high = std::min<size_t>(high, words * WORD_BITS / totalWidth);
+  }
+
+  // Each minipage starts at a word, so less than the estimate may fit
+  while (low < high) {
+    size_t mid = (low + high + 1) / 2, used = 0;
+
+    for (auto width : widths) used += packedColumnWords(mid, width);
+
+    if (used <= words) {
+      low = mid;
+    } else {
+      high = mid - 1;
+    }
+  }
+
+  return low;
+}
+
+/**
+ * Gives the offset in a minipage. Since the width is a power of two, no
+ * offset spans two words.
+ */
+static uint_t unpack(const uint_t *column, size_t slot, uint_t width) {
+  if (!width) return 0;
+
+  auto bit = slot * width;
+  auto word = column[bit / WORD_BITS] >> (bit % WORD_BITS);
+
+  return width == WORD_BITS ? word : word & ((uint_t(1) << width) - 1);
+}
+
+/**
+ * Gives the word of a minipage which holds the offset of a slot, with the
+ * offset replaced.
+ */
+static uint_t packWord(uint_t word, size_t slot, uint_t width,
+                       uint_t offset) {
+  if (!width) return word;
+
+  auto shift = slot * width % WORD_BITS;
+  uint_t mask = width == WORD_BITS ? ~uint_t(0) : (uint_t(1) << width) - 1;
+
+  return (word & ~(mask << shift)) | (offset & mask) << shift;
+}
+
+static void pack(uint_t *column, size_t slot, uint_t width, uint_t offset) {
+  auto &word = column[slot * width / WORD_BITS];
+  word = packWord(word, slot, width, offset);
+}
+
+/**
+ * Unpacks the values of the given slots of a packed minipage of the given
+ * width into every fieldCount-th element of dest.
+ */
+template <uint_t WIDTH>
+static void unpackSlots(const uint_t *column, sint_t min,
+                        const vector<size_t> &slots, size_t fieldCount,
+                        sint_t *dest) {
+  const uint_t mask =
+      WIDTH == WORD_BITS ? ~uint_t(0) : (uint_t(1) << (WIDTH % WORD_BITS)) - 1;
+
+  for (size_t r = 0; r < slots.size(); ++r) {
+    auto bit = slots[r] * WIDTH;
+    dest[r * fieldCount] = sint_t(
+        uint_t(min) + ((column[bit / WORD_BITS] >> (bit % WORD_BITS)) & mask));
+  }
+}
+
+/**
+ * Like selectScalar(), but for a packed minipage of the given width, with the
+ * bounds as offsets. The width is a constant, so that the compiler can unpack
+ * several offsets at a time.
+ */
+template <uint_t WIDTH>
+static void selectPacked(const uint_t *column, const uint_t *bitmap,
+                         size_t count, uint_t low, uint_t high,
+                         vector<size_t> &slots) {
+  const uint_t perWord = WORD_BITS / WIDTH;
+  const uint_t mask =
+      WIDTH == WORD_BITS ? ~uint_t(0) : (uint_t(1) << (WIDTH % WORD_BITS)) - 1;
+
+  for (size_t base = 0; base < count; base += WORD_BITS) {
+    auto used = bitmap[base / WORD_BITS];
+
+    if (!used) continue;
+
+    auto n = std::min<size_t>(WORD_BITS, count - base);
+    auto words = column + base / perWord;
+    uint_t inside = 0;
+
+    for (size_t i = 0; i < n; ++i) {
+      uint_t offset =
+          (words[i / perWord] >> ((i % perWord) * WIDTH)) & mask;
+      inside |= uint_t(offset >= low && offset <= high) << i;
+    }
+
+    appendBits(inside & used, base, slots);
+  }
+}
+
+DataLayout::DataLayout(size_t fieldCount, Format format)
+    : fieldCount(fieldCount),
+      fmt(format),
+      slotCount(format == FORMAT_PACKED
+                    ? Page::maxSlotCount()
+                    : Page::cellCapacity(fieldCount * sizeof(sint_t))) {}
+
+DataLayout DataLayout::of(Page &page, size_t fieldCount, Format newFormat) {
+  return ofImage(page.image(), fieldCount, newFormat);
+}
+
+DataLayout DataLayout::ofImage(const char *image, size_t fieldCount,
+                               Format newFormat) {
+  switch (Page::categoryOf(image)) {
+    case PAGE_CATEGORY_DATA:
+      return DataLayout(fieldCount, FORMAT_ROW);
+    case PAGE_CATEGORY_DATA_PAX:
+      return DataLayout(fieldCount, FORMAT_PAX);
+    case PAGE_CATEGORY_DATA_PACKED: {
+      DataLayout layout(fieldCount, FORMAT_PACKED);
+      layout.slotCount = packedWords(image)[0];
+      return layout;
+    }
+    default:
+      return DataLayout(fieldCount, newFormat);
+  }
+}
+
+uint_t DataLayout::categoryOf(Format format) {
+  switch (format) {
+    case FORMAT_PAX:
+      return PAGE_CATEGORY_DATA_PAX;
+    case FORMAT_PACKED:
+      return PAGE_CATEGORY_DATA_PACKED;
+    default:
+      return PAGE_CATEGORY_DATA;
+  }
+}
+
+bool DataLayout::parseFormat(const string &name, Format &format) {
+  if (name == "row") {
+    format = FORMAT_ROW;
+  } else if (name == "pax") {
+    format = FORMAT_PAX;
+  } else if (name == "packed") {
+    format = FORMAT_PACKED;
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+const char *DataLayout::formatName(Format format) {
+  switch (format) {
+    case FORMAT_PAX:
+      return "pax";
+    case FORMAT_PACKED:
+      return "packed";
+    default:
+      return "row";
+  }
+}
+
+sint_t DataLayout::field(const char *image, size_t slot, size_t field) const {
+  if (fmt == FORMAT_PACKED) {
+    return sint_t(uint_t(packedMin(image, field)) +
+                  unpack(packedColumn(image, field), slot,
+                         packedWidth(image, field)));
+  }
+
+  return *reinterpret_cast<const sint_t *>(Page::contentOf(image) +
+                                           fieldPos(slot, field));
+}
+
+void DataLayout::read(const char *image, size_t slot, sint_t *dest) const {
+  for (size_t i = 0; i < fieldCount; ++i) {
+    dest[i] = field(image, slot, i);
+  }
+}
+
+void DataLayout::readSlots(const char *image, const vector<size_t> &slots,
+                           sint_t *dest) const {
+  if (fmt == FORMAT_ROW) {
+    for (size_t r = 0; r < slots.size(); ++r) {
+      read(image, slots[r], dest + r * fieldCount);
+    }
+
+    return;
+  }
+
+  for (size_t i = 0; i < fieldCount; ++i) {
+    if (fmt == FORMAT_PAX) {
+      auto column = reinterpret_cast<const sint_t *>(Page::contentOf(image) +
+                                                     fieldPos(0, i));
+
+      for (size_t r = 0; r < slots.size(); ++r) {
+        dest[r * fieldCount + i] = column[slots[r]];
+      }
+
+      continue;
+    }
+
+    auto column = packedColumn(image, i);
+    auto min = packedMin(image, i);
+
+    switch (packedWidth(image, i)) {
+      case 0:
+        for (size_t r = 0; r < slots.size(); ++r) {
+          dest[r * fieldCount + i] = min;
+        }
+        break;
+      case 1:
+        unpackSlots<1>(column, min, slots, fieldCount, dest + i);
+        break;
+      case 2:
+        unpackSlots<2>(column, min, slots, fieldCount, dest + i);
+        break;
+      case 4:
+        unpackSlots<4>(column, min, slots, fieldCount, dest + i);
+        break;
+      case 8:
+        unpackSlots<8>(column, min, slots, fieldCount, dest + i);
+        break;
+      case 16:
+        unpackSlots<16>(column, min, slots, fieldCount, dest + i);
+        break;
+      case 32:
+        unpackSlots<32>(column, min, slots, fieldCount, dest + i);
+        break;
+      default:
+        unpackSlots<64>(column, min, slots, fieldCount, dest + i);
+        break;
+    }
+  }
+}
+
+const sint_t *DataLayout::row(const char *image, size_t slot) const {
+  if (fmt != FORMAT_ROW) return nullptr;
+
+  return reinterpret_cast<const sint_t *>(Page::contentOf(image) +
+                                          fieldPos(slot, 0));
+}
+
+int DataLayout::firstEmptySlot(Page &page) const {
+  if (fmt == FORMAT_PACKED) return firstEmptySlot(page, nullptr);
+
+  return page.firstEmptyCellIndex(fieldCount * sizeof(sint_t));
+}
+
+int DataLayout::firstEmptySlot(Page &page, const sint_t *values) const {
+  if (fmt != FORMAT_PACKED) return firstEmptySlot(page);
+
+  if (!page.isUsed()) {
+    page.reset();
+    return 0;
+  }
+
+  auto image = page.image();
+  size_t capacity = packedWords(image)[0];
+
+  // The ranges only grow here, while write() may narrow them to the live
+  // records, so the record fits in at least the capacity found here
+  if (values) {
+    vector<uint_t> widths(fieldCount);
+    bool widened = false;
+
+    for (size_t i = 0; i < fieldCount; ++i) {
+      auto min = std::min(packedMin(image, i), values[i]);
+      auto max = std::max(packedMax(image, i), values[i]);
+
+      widths[i] = packedWidth(min, max);
+      widened |= min != packedMin(image, i) || max != packedMax(image, i);
+    }
+
+    if (widened) capacity = packedCapacity(widths);
+  }
+
+  if (page.liveCount() >= capacity) return -1;
+
+  auto bitmap = Page::slotBitmapOf(image);
+  int first = -1;
+
+  for (size_t w = 0; w * WORD_BITS < Page::maxSlotCount(); ++w) {
+    if (first < 0 && ~bitmap[w]) {
+      first = int(w * WORD_BITS + __builtin_ctzll(~bitmap[w]));
+    }
+
+    // The used slots must all stay within the capacity
+    if (bitmap[w] &&
+        w * WORD_BITS + WORD_BITS - __builtin_clzll(bitmap[w]) > capacity) {
+      return -1;
+    }
+  }
+
+  return first >= 0 && size_t(first) < capacity ? first : -1;
+}
+
+bool DataLayout::write(Page &page, size_t slot, const sint_t *values) const {
+  if (fmt == FORMAT_PACKED) return writePacked(page, slot, values);
+
+  page.setIsUsed(true);
+  page.setPageCategory(categoryOf(fmt));
+  page.setCellUsed(slot, true);
+
+  if (fmt == FORMAT_ROW) {
+    return page.writeContent(reinterpret_cast<const char *>(values),
+                             fieldCount * sizeof(sint_t), fieldPos(slot, 0));
+  }
+
+  for (size_t i = 0; i < fieldCount; ++i) {
+    if (!page.writeContent(reinterpret_cast<const char *>(&values[i]),
+                           sizeof(sint_t), fieldPos(slot, i))) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool DataLayout::writePacked(Page &page, size_t slot,
+                             const sint_t *values) const {
+  auto image = page.image();
+  const bool used = page.isUsed();
+  bool reencode = !used;
+
+  for (size_t i = 0; i < fieldCount && !reencode; ++i) {
+    reencode = values[i] < packedMin(image, i) ||
+               packedWidth(packedMin(image, i),
+                           std::max(packedMax(image, i), values[i])) !=
+                   packedWidth(image, i);
+  }
+
+  if (!reencode) {
+    if (slot >= packedWords(image)[0] || page.isCellUsed(slot)) return false;
+
+    // The smallest values and the widths stay, so only the largest values
+    // and the new offsets are written
+    for (size_t i = 0; i < fieldCount; ++i) {
+      auto width = packedWidth(image, i);
+      auto wordPos = packedColumn(image, i) - packedWords(image) +
+                     slot * width / WORD_BITS;
+      uint_t word = packWord(packedWords(image)[wordPos], slot, width,
+                             uint_t(values[i]) - uint_t(packedMin(image, i)));
+      sint_t max = std::max(packedMax(image, i), values[i]);
+
+      if (!(page.writeContent(reinterpret_cast<const char *>(&max),
+                              sizeof(sint_t),
+                              (2 + PACKED_FIELD_WORDS * i) * sizeof(uint_t)) &&
+            page.writeContent(reinterpret_cast<const char *>(&word),
+                              sizeof(uint_t), wordPos * sizeof(uint_t)))) {
+        return false;
+      }
+    }
+
+    page.setCellUsed(slot, true);
+    return true;
+  }
+
+  // Re-encode the page with the ranges of its live records and the new one
+  vector<size_t> live;
+  vector<sint_t> records;
+
+  if (used) {
+    usedSlots(image, live);
+    records.resize(live.size() * fieldCount);
+
+    for (size_t r = 0; r < live.size(); ++r) {
+      read(image, live[r], records.data() + r * fieldCount);
+    }
+  }
+
+  vector<sint_t> mins(values, values + fieldCount),
+      maxs(values, values + fieldCount);
+  vector<uint_t> widths(fieldCount);
+
+  for (size_t r = 0; r < live.size(); ++r) {
+    for (size_t i = 0; i < fieldCount; ++i) {
+      mins[i] = std::min(mins[i], records[r * fieldCount + i]);
+      maxs[i] = std::max(maxs[i], records[r * fieldCount + i]);
+    }
+  }
+
+  for (size_t i = 0; i < fieldCount; ++i) {
+    widths[i] = packedWidth(mins[i], maxs[i]);
+  }
+
+  const auto capacity = packedCapacity(widths);
+
+  if (slot >= capacity || (used && page.isCellUsed(slot)) ||
+      (!live.empty() && live.back() >= capacity)) {
+    return false;
+  }
+
+  vector<uint_t> content(Page::contentSize() / sizeof(uint_t), 0);
+  size_t pos = packedHeaderWords(fieldCount);
+
+  content[0] = capacity;
+
+  for (size_t i = 0; i < fieldCount; ++i) {
+    content[1 + PACKED_FIELD_WORDS * i] = uint_t(mins[i]);
+    content[2 + PACKED_FIELD_WORDS * i] = uint_t(maxs[i]);
+    content[3 + PACKED_FIELD_WORDS * i] = widths[i] | uint_t(pos) << 8;
+
+    auto column = content.data() + pos;
+
+    for (size_t r = 0; r < live.size(); ++r) {
+      pack(column, live[r], widths[i],
+           uint_t(records[r * fieldCount + i]) - uint_t(mins[i]));
+    }
+
+    pack(column, slot, widths[i], uint_t(values[i]) - uint_t(mins[i]));
+    pos += packedColumnWords(capacity, widths[i]);
+  }
+
+  page.setIsUsed(true);
+  page.setPageCategory(PAGE_CATEGORY_DATA_PACKED);
+  page.setCellUsed(slot, true);
+
+  return page.writeContent(reinterpret_cast<const char *>(content.data()),
+                           content.size() * sizeof(uint_t), 0);
+}
+
+void DataLayout::erase(Page &page, size_t slot) const {
+  page.setCellUsed(slot, false);
+}
+
+void DataLayout::select(const char *image, size_t field, sint_t low,
+                        sint_t high, vector<size_t> &slots) const {
+  if (Page::liveCountOf(image) == 0) return;
+
+  auto bitmap = Page::slotBitmapOf(image);
+
+  if (fmt == FORMAT_ROW) {
+    for (size_t base = 0; base < slotCount; base += WORD_BITS) {
+      for (auto used = bitmap[base / WORD_BITS]; used; used &= used - 1) {
+        auto slot = base + __builtin_ctzll(used);
+        auto value = this->field(image, slot, field);
+
+        if (value >= low && value <= high) slots.push_back(slot);
+      }
+    }
+
+    return;
+  }
+
+  if (fmt == FORMAT_PACKED) {
+    auto min = packedMin(image, field), max = packedMax(image, field);
+
+    if (low > max || high < min) return;
+
+    // The bounds are compared as offsets, without unpacking the values
+    uint_t lowOffset = low <= min ? 0 : uint_t(low) - uint_t(min);
+    uint_t highOffset = uint_t(std::min(high, max)) - uint_t(min);
+    auto column = packedColumn(image, field);
+    size_t count = packedWords(image)[0];
+
+    switch (packedWidth(image, field)) {
+      case 0:
+        usedSlots(image, slots);
+        break;
+      case 1:
+        selectPacked<1>(column, bitmap, count, lowOffset, highOffset, slots);
+        break;
+      case 2:
+        selectPacked<2>(column, bitmap, count, lowOffset, highOffset, slots);
+        break;
+      case 4:
+        selectPacked<4>(column, bitmap, count, lowOffset, highOffset, slots);
+        break;
+      case 8:
+        selectPacked<8>(column, bitmap, count, lowOffset, highOffset, slots);
+        break;
+      case 16:
+        selectPacked<16>(column, bitmap, count, lowOffset, highOffset, slots);
+        break;
+      case 32:
+        selectPacked<32>(column, bitmap, count, lowOffset, highOffset, slots);
+        break;
+      default:
+        selectPacked<64>(column, bitmap, count, lowOffset, highOffset, slots);
+        break;
+    }
+
+    return;
+  }
+
+  auto column = reinterpret_cast<const sint_t *>(Page::contentOf(image) +
+                                                 fieldPos(0, field));
+
+#ifdef STGMGR_AVX2_DISPATCH
+  static const bool avx2 = __builtin_cpu_supports("avx2");
+
+  if (avx2) {
+    selectAvx2(column, bitmap, slotCount, low, high, slots);
+    return;
+  }
+#endif
+
+  selectScalar(column, bitmap, slotCount, low, high, slots);
+}
+
+void DataLayout::usedSlots(const char *image, vector<size_t> &slots) const {
+  auto bitmap = Page::slotBitmapOf(image);
+
+  // The slot count of a packed page changes when it is re-encoded
+  const size_t count =
+      fmt == FORMAT_PACKED ? packedWords(image)[0] : slotCount;
+
+  slots.reserve(slots.size() + Page::liveCountOf(image));
+
+  for (size_t base = 0; base < count; base += WORD_BITS) {
+    appendBits(bitmap[base / WORD_BITS], base, slots);
+  }
+}
@@ -0,0 +1,217 @@
+//
+// Created by Alper Çakan on 9.04.2018.
+//
+
+#ifndef STGMGR_DATALAYOUT_H
+#define STGMGR_DATALAYOUT_H
+
+#include <string>
+#include <vector>
+#include "constants.h"
+
+class Page;
+
+/**
+ * The layout of the records of a type in its data pages.
+ *
+ * There are two formats, and the category of each data page tells its format:
+ *
+ * - Row (PAGE_CATEGORY_DATA): Each record is a cell of its fields.
+ *
+ * - PAX (PAGE_CATEGORY_DATA_PAX): The content is one minipage per field. A
+ * minipage holds that field of all the slots contiguously, so a filter on a
+ * field reads only its minipage, and it is compared several values at a time
+ * with SIMD.
+ *
+ * - Packed (PAGE_CATEGORY_DATA_PACKED): Like PAX, but each field is stored as
+ * its offset from the smallest value of the field in the page, in the fewest
+ * bits (rounded up to a power of two) which hold the offsets of the page. The
+ * content starts with the slot count of the page and, for each field, its
+ * smallest and largest values and the width and position of its minipage.
+ * A page is re-encoded only when a record outside its ranges is written to
+ * it, so the number of its slots depends on its values.
+ *
+ * A slot is the index of a record in its page, in all the formats. The used
+ * slots are kept in the occupancy bitmap of the page header.
+ *
+ * The functions which only read take the whole page image, header included.
+ */
+class DataLayout {
+ public:
+  enum Format : uint_t { FORMAT_ROW = 0, FORMAT_PAX = 1, FORMAT_PACKED = 2 };
+
+  /**
+   * @param fieldCount The number of fields of the type
+   * @param format The format of the page
+   */
+  DataLayout(size_t fieldCount, Format format);
+
+  /**
+   * Gives the layout of a page. A page which is not a data page yet (i.e. a
+   * new page) gets the given format.
+   *
+   * @param page The page
+   * @param fieldCount The number of fields of the type
+   * @param newFormat The format of the type
+   * @return The layout
+   */
+  static DataLayout of(Page &page, size_t fieldCount, Format newFormat);
+
+  /**
+   * Gives the layout of a page image; see of().
+   */
+  static DataLayout ofImage(const char *image, size_t fieldCount,
+                            Format newFormat);
+
+  /**
+   * Gives the page category of the data pages of a format.
+   */
+  static uint_t categoryOf(Format format);
+
+  /**
+   * Parses the name of a format ("row", "pax" or "packed").
+   *
+   * @param name The name
+   * @param format A reference to a format variable, which is set on success
+   * @return Success/failure
+   */
+  static bool parseFormat(const std::string &name, Format &format);
+
+  /**
+   * Gives the name of a format, as parseFormat() takes it.
+   */
+  static const char *formatName(Format format);
+
+  /**
+   * Gives the number of the slots in a page. For the packed format, it is the
+   * number of the slots of the page whose layout this is, or the most a page
+   * may have for a layout which is not of a page.
+   */
+  size_t capacity() const { return slotCount; }
+
+  Format format() const { return fmt; }
+
+  /**
+   * Gives a field of a record.
+   *
+   * @param image The whole page
+   * @param slot The slot of the record
+   * @param field The index of the field
+   */
+  sint_t field(const char *image, size_t slot, size_t field) const;
+
+  /**
+   * Copies all the fields of a record.
+   *
+   * @param image The whole page
+   * @param slot The slot of the record
+   * @param dest The array in which the fields are stored
+   */
+  void read(const char *image, size_t slot, sint_t *dest) const;
+
+  /**
+   * Copies all the fields of several records of a page, one field at a time,
+   * which is faster than read() for each record in the PAX and packed
+   * formats.
+   *
+   * @param image The whole page
+   * @param slots The slots of the records
+   * @param dest The array in which the fields of the records are stored, one
+   * record after another
+   */
+  void readSlots(const char *image, const std::vector<size_t> &slots,
+                 sint_t *dest) const;
+
+  /**
+   * Gives the fields of a record in place, which is possible only in the row
+   * format, where they are contiguous.
+   *
+   * @param image The whole page
+   * @param slot The slot of the record
+   * @return The fields, or null for the PAX format
+   */
+  const sint_t *row(const char *image, size_t slot) const;
+
+  /**
+   * Finds the first empty slot. A page which is not used is reset first.
+   *
+   * @param page The page
+   * @return The slot, or -1 if the page is full
+   */
+  int firstEmptySlot(Page &page) const;
+
+  /**
+   * Finds the first empty slot in which the given record can be written. In
+   * the packed format, a record outside the ranges of a page widens them,
+   * which may leave fewer slots; otherwise, this is the same as above.
+   *
+   * @param page The page
+   * @param values The fields of the record
+   * @return The slot, or -1 if the record does not fit in the page
+   */
+  int firstEmptySlot(Page &page, const sint_t *values) const;
+
+  /**
+   * Stores a record in a slot, and marks the page as a used data page of
+   * this format.
+   *
+   * @param page The page
+   * @param slot The slot
+   * @param values The fields of the record
+   * @return Success/failure. In the packed format, fails if the slot is not
+   * one which firstEmptySlot(page, values) could give.
+   */
+  bool write(Page &page, size_t slot, const sint_t *values) const;
+
+  /**
+   * Marks a slot as empty.
+   *
+   * @param page The page
+   * @param slot The slot
+   */
+  void erase(Page &page, size_t slot) const;
+
+  /**
+   * Finds the used slots whose given field is in the range [low, high].
+   *
+   * @param image The whole page
+   * @param field The index of the field
+   * @param low The smallest matching value
+   * @param high The largest matching value
+   * @param slots The vector to which the matching slots are appended, in
+   * increasing order
+   */
+  void select(const char *image, size_t field, sint_t low, sint_t high,
+              std::vector<size_t> &slots) const;
+
+  /**
+   * Finds all the used slots.
+   *
+   * @param image The whole page
+   * @param slots The vector to which the slots are appended, in increasing
+   * order
+   */
+  void usedSlots(const char *image, std::vector<size_t> &slots) const;
+
+ private:
+  /**
+   * Like write(), for the packed format.
+   */
+  bool writePacked(Page &page, size_t slot, const sint_t *values) const;
+
+  /**
+   * Gives the position of a field of a slot in the content, in the row and
+   * PAX formats.
+   */
+  size_t fieldPos(size_t slot, size_t field) const {
+    return (fmt == FORMAT_ROW ? slot * fieldCount + field
+                              : field * slotCount + slot) *
+           sizeof(sint_t);
+  }
+
+  size_t fieldCount;
+  Format fmt;
+  size_t slotCount;
+};
+
+#endif  // STGMGR_DATALAYOUT_H
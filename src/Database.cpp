@@ -0,0 +1,231 @@
+//
+// Created by Alper Çakan on 9.04.2018.
+//
+
+#include "Database.h"
+#include "BufferPool.h"
+#include "Catalogue.h"
+#include "LockManager.h"
+#include "StorageManager.h"
+#include "Wal.h"
+
+#include <algorithm>
+
+using std::function;
+using std::pair;
+using std::string;
+using std::vector;
+
+const string &Table::name() const { return typeName; }
+
+const vector<string> &Table::fieldNames() const { return names; }
+
+size_t Table::fieldCount() const { return names.size(); }
+
+DataLayout::Format Table::format() const { return dataFormat; }
+
+int Table::fieldIndex(const string &fieldName) const {
+  auto it = std::find(names.begin(), names.end(), fieldName);
+
+  return it == names.end() ? -1 : int(it - names.begin());
+}
+
+bool Table::insert(Record record, PageNumber *pageNumber) {
+  auto res = createRecord(typeName, record);
+
+  if (pageNumber) *pageNumber = res;
+
+  return res.first != 0 || res.second != 0;
+}
+
+bool Table::find(sint_t key, vector<sint_t> &values, bool &found,
+                 PageNumber *pageNumber, uint_t threadCount) {
+  bool suc;
+  auto res = searchRecord(typeName, key, false, false, suc, threadCount);
+
+  found = !res.first.empty();
+
+  if (found) values = std::move(res.first[0]);
+  if (pageNumber) *pageNumber = res.second;
+
+  return suc;
+}
+
+bool Table::erase(sint_t key, bool &found, PageNumber *pageNumber) {
+  bool suc;
+  auto res = searchRecord(typeName, key, false, true, suc);
+
+  found = !res.first.empty();
+
+  if (pageNumber) *pageNumber = res.second;
+
+  return suc;
+}
+
+bool Table::findBy(size_t field, sint_t value,
+                   const function<void(Record, PageNumber)> &onRecord,
+                   uint_t threadCount) {
+  return searchBy(typeName, field, value, onRecord, threadCount);
+}
+
+Cursor Table::openScan() const {
+  return Cursor(typeName, names.size(), dataFormat);
+}
+
+bool Table::scan(const function<void(Record)> &onRecord, uint_t threadCount,
+                 bool ordered) {
+  return listRecords(
+      typeName, [&onRecord](Record rec, PageNumber) { onRecord(rec); },
+      threadCount, ordered);
+}
+
+bool Table::aggregate(size_t field, int groupField,
+                      vector<pair<sint_t, Aggregate>> &groups,
+                      uint_t threadCount) {
+  return ::aggregate(typeName, field, groupField, groups, threadCount);
+}
+
+bool Table::createIndex(size_t field) {
+  return ::createIndex(typeName, field);
+}
+
+bool Table::bulkLoad(const string &path, bool binary, uint_t &count,
+                     const function<void(Record, PageNumber)> &onRecord) {
+  return ::bulkLoad(typeName, path, binary, count, onRecord);
+}
+
+bool Table::vacuum(uint_t &freedPages, uint_t maxPages, bool *done) {
+  bool compacted;
+
+  if (!::vacuum(typeName, maxPages, freedPages, compacted)) return false;
+
+  if (done) *done = compacted;
+
+  return true;
+}
+
+Table::operator bool() const { return exists; }
+
+Database::~Database() { close(); }
+
+bool Database::format(Disc::Backend backend, uint_t pageSize,
+                      uint_t maxPageCount) {
+  if (!::format(backend, pageSize, maxPageCount)) return false;
+
+  persistGlobPageAddr();
+  return true;
+}
+
+bool Database::open(string *error) { return openWith(nullptr, error); }
+
+bool Database::open(Disc::Backend backend, string *error) {
+  return openWith(&backend, error);
+}
+
+bool Database::openWith(const Disc::Backend *backend, string *error) {
+  uint_t maxLoggedGlobAddr;
+
+  if (opened) return true;
+
+  auto fail = [error](const char *reason) {
+    if (error) *error = reason;
+    return false;
+  };
+
+  if (!loadGeometry()) {
+    return fail("Could not read the general system catalogue!");
+  }
+
+  if (!Wal::recover(maxLoggedGlobAddr)) return fail("Recovery failed!");
+
+  initGlobPageAddr();
+
+  auto chosen = backend ? *backend : defaultBackend();
+
+  if (chosen != Disc::backend) {
+    BufferPool::discardFile(SYS_CATALOGUE_GENERAL_FILE_NAME);
+    Disc::setBackend(chosen);
+  }
+
+  Catalogue::load();
+  recoverGlobPageAddr(maxLoggedGlobAddr);
+
+  if (!Wal::open()) return fail("Could not open the log!");
+
+  opened = true;
+  return true;
+}
+
+bool Database::close() {
+  if (!opened) return true;
+
+  abortTransaction();
+
+  // The pool may next hold the pages of another database, in another
+  // directory or of another page size
+  bool suc = ::commit() && checkpoint() && BufferPool::discardAll();
+
+  Wal::close();
+  Disc::closeAll();
+  opened = false;
+
+  return suc;
+}
+
+bool Database::isOpen() const { return opened; }
+
+bool Database::commit() { return ::commit(); }
+
+bool Database::begin() { return beginTransaction(); }
+
+bool Database::abort() { return abortTransaction(); }
+
+bool Database::inTransaction() const { return ::inTransaction(); }
+
+bool Database::sync() { return Wal::sync(); }
+
+bool Database::createTable(const string &name, const vector<string> &fieldNames,
+                           DataLayout::Format format) {
+  return createType(name, fieldNames, format);
+}
+
+bool Database::dropTable(const string &name) { return deleteType(name); }
+
+bool Database::vacuum(uint_t &freedPages) {
+  if (!vacuumCatalogue(freedPages)) return false;
+
+  for (auto &table : tables()) {
+    uint_t freed;
+
+    if (!table.vacuum(freed)) return false;
+
+    freedPages += freed;
+  }
+
+  return true;
+}
+
+Table Database::table(const string &name) {
+  Table table;
+  TypeLock lock(name, Lock::INTENT_SHARED);
+  auto schema = Catalogue::find(name);
+
+  if (schema) {
+    table.typeName = name;
+    table.names = schema->fieldNames;
+    table.dataFormat = schema->format;
+    table.exists = true;
+  }
+
+  return table;
+}
+
+vector<Table> Database::tables() {
+  vector<Table> res;
+
+  for (const auto &type : Catalogue::list()) {
+    res.push_back(table(type.first));
+  }
+
+  return res;
+}
@@ -0,0 +1,335 @@
+//
+// Created by Alper Çakan on 9.04.2018.
+//
+
+#ifndef STGMGR_DATABASE_H
+#define STGMGR_DATABASE_H
+
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Aggregate.h"
+#include "Cursor.h"
+#include "DataLayout.h"
+#include "Disc.h"
+#include "Record.h"
+#include "constants.h"
+
+/**
+ * A type of the database, through which its records are accessed.
+ *
+ * A table is only a handle: the schema is read from the system catalogue when
+ * the table is got from Database::table(). A table which does not exist is
+ * false when converted to bool.
+ */
+class Table {
+ public:
+  Table() = default;
+
+  /**
+   * Gives the name of the type.
+   */
+  const std::string &name() const;
+
+  /**
+   * Gives the names of the fields, the first of which is the primary key.
+   */
+  const std::vector<std::string> &fieldNames() const;
+
+  size_t fieldCount() const;
+
+  /**
+   * Gives the format of the data pages.
+   */
+  DataLayout::Format format() const;
+
+  /**
+   * Gives the index of the field with the given name.
+   *
+   * @return The index, or -1 if there is no such field
+   */
+  int fieldIndex(const std::string &fieldName) const;
+
+  /**
+   * Creates a record.
+   *
+   * @param record The field values. There must be exactly one value for each
+   * field.
+   * @param pageNumber If not null, the page in which the record is placed
+   * will be stored here.
+   * @return Success/failure. If the primary key is indexed, creating a record
+   * with an existing key is a failure.
+   */
+  bool insert(Record record, PageNumber *pageNumber = nullptr);
+
+  /**
+   * Searches for the record with the given primary key.
+   *
+   * @param key The primary key
+   * @param values A reference to a vector. The field values of the record will
+   * be stored here if it exists.
+   * @param found A reference to a boolean variable. This will be set to
+   * whether the record exists.
+   * @param pageNumber If not null, the page in which the record is placed
+   * will be stored here.
+   * @param threadCount The number of threads to scan with
+   * @return Success/failure
+   */
+  bool find(sint_t key, std::vector<sint_t> &values, bool &found,
+            PageNumber *pageNumber = nullptr, uint_t threadCount = 1);
+
+  /**
+   * Deletes the record with the given primary key.
+   *
+   * @param key The primary key
+   * @param found A reference to a boolean variable. This will be set to
+   * whether the record existed.
+   * @param pageNumber If not null, the page from which the record is deleted
+   * will be stored here.
+   * @return Success/failure
+   */
+  bool erase(sint_t key, bool &found, PageNumber *pageNumber = nullptr);
+
+  /**
+   * Searches for all the records whose given field has the given value,
+   * through the index on the field if it exists. See ::searchBy().
+   *
+   * @param field The index of the field
+   * @param value The value
+   * @param onRecord Called with each found record and its page. The record is
+   * valid only during the call.
+   * @param threadCount The number of threads to scan with
+   * @return Success/failure
+   */
+  bool findBy(size_t field, sint_t value,
+              const std::function<void(Record, PageNumber)> &onRecord,
+              uint_t threadCount = 1);
+
+  /**
+   * Opens a serial scan of the records, in the order of the data file. See
+   * Cursor.
+   *
+   * @return The cursor. If the data file could not be read, it has no records
+   * and Cursor::failed() is true.
+   */
+  Cursor openScan() const;
+
+  /**
+   * Gives all the records to a callback as they are read, without collecting
+   * them. See ::listRecords().
+   *
+   * @param onRecord Called with each record. The record is valid only during
+   * the call.
+   * @param threadCount The number of threads to scan with
+   * @param ordered If false, the records may be given in any order
+   * @return Success/failure
+   */
+  bool scan(const std::function<void(Record)> &onRecord,
+            uint_t threadCount = 1, bool ordered = true);
+
+  /**
+   * Aggregates a field of all the records, optionally grouped by another
+   * field. See ::aggregate().
+   *
+   * @param field The index of the aggregated field
+   * @param groupField The index of the field to group by, or -1 for none
+   * @param groups A reference to a vector. The pairs (Group Value, Aggregate)
+   * will be stored here, in ascending order of the group value.
+   * @param threadCount The number of threads to scan with
+   * @return Success/failure
+   */
+  bool aggregate(size_t field, int groupField,
+                 std::vector<std::pair<sint_t, Aggregate>> &groups,
+                 uint_t threadCount = 1);
+
+  /**
+   * Creates the index on a field. See ::createIndex().
+   *
+   * @param field The index of the field (0 for the primary key)
+   * @return Success/failure
+   */
+  bool createIndex(size_t field = 0);
+
+  /**
+   * Loads records from a file. See ::bulkLoad().
+   *
+   * @return Success/failure
+   */
+  bool bulkLoad(const std::string &path, bool binary, uint_t &count,
+                const std::function<void(Record, PageNumber)> &onRecord =
+                    nullptr);
+
+  /**
+   * Compacts the data file, so that it has as few pages as the records take.
+   * See ::vacuum().
+   *
+   * @param freedPages A reference to an integer variable. This will contain
+   * the number of the pages cut off the file.
+   * @param maxPages The most pages to be emptied, or 0 for no limit
+   * @param done If not null, this will be set to whether the file is
+   * compacted as much as it can be. It is always so without a limit.
+   * @return Success/failure
+   */
+  bool vacuum(uint_t &freedPages, uint_t maxPages = 0, bool *done = nullptr);
+
+  operator bool() const;
+
+ private:
+  friend class Database;
+
+  std::string typeName;
+  std::vector<std::string> names;
+  DataLayout::Format dataFormat = DataLayout::FORMAT_ROW;
+  bool exists = false;
+};
+
+/**
+ * The database in the current directory.
+ *
+ * The storage manager keeps its state in static modules, so only one database
+ * may be open at a time. Every operation which modifies the database is to be
+ * followed by commit(), or be run in a transaction:
+ *
+ *     db.begin();
+ *     table.insert(a);
+ *     table.erase(key, found);
+ *
+ *     if (!db.commit()) ...  // Neither of them is done
+ */
+class Database {
+ public:
+  Database() = default;
+
+  Database(const Database &) = delete;
+
+  Database &operator=(const Database &) = delete;
+
+  /**
+   * Closes the database, if it is open.
+   */
+  ~Database();
+
+  /**
+   * Formats the current directory to be an empty database. See ::format().
+   *
+   * @return Success/failure
+   */
+  static bool format(Disc::Backend backend = Disc::BACKEND_PREAD,
+                     uint_t pageSize = DEFAULT_PAGE_SIZE,
+                     uint_t maxPageCount = DEFAULT_STORAGE_SIZE /
+                                           DEFAULT_PAGE_SIZE);
+
+  /**
+   * Opens the database with its default Disc backend. The changes which were
+   * committed but had not reached the files are redone from the log.
+   *
+   * @param error If not null, the reason of a failure will be stored here.
+   * @return Success/failure
+   */
+  bool open(std::string *error = nullptr);
+
+  /**
+   * Opens the database with the given Disc backend.
+   *
+   * @param backend The backend to be used in place of the default
+   * @param error If not null, the reason of a failure will be stored here.
+   * @return Success/failure
+   */
+  bool open(Disc::Backend backend, std::string *error = nullptr);
+
+  /**
+   * Commits the outstanding changes, writes all the pages back to their files
+   * and closes them. An open transaction of the calling thread is aborted.
+   * The buffer pool is emptied, so another database may be opened next.
+   *
+   * @return Success/failure
+   */
+  bool close();
+
+  bool isOpen() const;
+
+  /**
+   * Commits the changes made since the last commit to the log, or the open
+   * transaction of the calling thread. See ::commit().
+   *
+   * @return Success/failure. A transaction which conflicts with another
+   * operation fails to commit, and is aborted.
+   */
+  bool commit();
+
+  /**
+   * Opens a transaction in the calling thread, so that the record operations
+   * up to commit() or abort() are committed together, or not at all. See
+   * ::beginTransaction().
+   *
+   * @return Success/failure
+   */
+  bool begin();
+
+  /**
+   * Drops the changes of the open transaction of the calling thread.
+   *
+   * @return Success/failure. Fails if there is no open transaction.
+   */
+  bool abort();
+
+  /**
+   * Whether the calling thread has an open transaction.
+   */
+  bool inTransaction() const;
+
+  /**
+   * Makes the commits so far durable.
+   *
+   * @return Success/failure
+   */
+  bool sync();
+
+  /**
+   * Creates a type. See ::createType().
+   *
+   * @return Success/failure
+   */
+  bool createTable(const std::string &name,
+                   const std::vector<std::string> &fieldNames,
+                   DataLayout::Format format = DataLayout::FORMAT_ROW);
+
+  /**
+   * Deletes a type, with all its records.
+   *
+   * @return Success/failure
+   */
+  bool dropTable(const std::string &name);
+
+  /**
+   * Compacts the system catalogue and the data files of all the types. See
+   * ::vacuumCatalogue() and Table::vacuum().
+   *
+   * @param freedPages A reference to an integer variable. This will contain
+   * the number of the pages cut off the files.
+   * @return Success/failure
+   */
+  bool vacuum(uint_t &freedPages);
+
+  /**
+   * Gives a type.
+   *
+   * @param name The name of the type
+   * @return The table, which is false if there is no such type
+   */
+  Table table(const std::string &name);
+
+  /**
+   * Gives all the types, in the order in which they are placed in the system
+   * catalogue.
+   */
+  std::vector<Table> tables();
+
+ private:
+  bool openWith(const Disc::Backend *backend, std::string *error);
+
+  bool opened = false;
+};
+
+#endif  // STGMGR_DATABASE_H
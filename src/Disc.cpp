@@ -3,90 +3,530 @@
 //
 
 #include "Disc.h"
+#include "PageAllocator.h"
+#include "Stats.h"
+#include "Wal.h"
 
-#include <fstream>
-#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
 #include <cstring>
+#include <iostream>
+#include <vector>
 
 using std::cout;
 using std::endl;
-using std::fstream;
-using std::ifstream;
-using std::ofstream;
+using std::lock_guard;
 using std::string;
+using std::unordered_map;
+using std::vector;
 
 uint_t Disc::newPageAddr = 1;
-bool Disc::discFull = false;
+uint_t Disc::pageSize = DEFAULT_PAGE_SIZE;
+uint_t Disc::maxPageCount = DEFAULT_STORAGE_SIZE / DEFAULT_PAGE_SIZE;
+std::atomic<bool> Disc::discFull(false);
+Disc::Backend Disc::backend = Disc::BACKEND_PREAD;
+std::mutex Disc::mutex;
+unordered_map<string, Disc::FileHandle> Disc::handles;
+
+/**
+ * Like pread/pwrite, but retries until the whole range is transferred.
+ */
+template <typename Buf, typename Op>
+static bool transferAll(Op op, int fd, Buf buf, size_t len, off_t off) {
+  while (len > 0) {
+    auto n = op(fd, buf, len, off);
+
+    if (n <= 0) return false;
+
+    buf += n;
+    len -= n;
+    off += n;
+  }
+
+  return true;
+}
+
+Disc::FileHandle *Disc::handle(const string &fileName, bool create) {
+  auto it = handles.find(fileName);
+
+  if (it != handles.end()) return &it->second;
+
+  int fd = open(fileName.c_str(), O_RDWR | (create ? O_CREAT : 0), 0644);
+
+  if (fd < 0) return nullptr;
+
+  struct stat st;
+
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return nullptr;
+  }
+
+  FileHandle file = {fd, uint_t(st.st_size) / pageSize, nullptr, 0, 0, 0, 0};
+
+  if (backend == BACKEND_MMAP) {
+    void *reserved = mmap(nullptr, MMAP_RESERVE_SIZE, PROT_NONE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    if (reserved == MAP_FAILED) {
+      close(fd);
+      return nullptr;
+    }
+
+    file.map = static_cast<char *>(reserved);
+
+    if (!mapPages(file, file.pageCount)) {
+      munmap(file.map, MMAP_RESERVE_SIZE);
+      close(fd);
+      return nullptr;
+    }
+  }
+
+  // A file may end with padding pages which were never appended, if it was
+  // grown by whole extents and not closed properly. Appended pages always
+  // have a nonzero global address.
+  char header[PAGE_HEADER_SIZE];
+
+  while (file.pageCount > 0 &&
+         readAt(file, header, PAGE_HEADER_SIZE, file.pageCount - 1) &&
+         *(reinterpret_cast<uint_t *>(header) + 2) == 0) {
+    --file.pageCount;
+  }
+
+  return &(handles[fileName] = file);
+}
+
+bool Disc::mapPages(FileHandle &file, uint_t pageCount) {
+  if (pageCount <= file.mappedPages) return true;
+
+  // Grow the file and the mapping by whole extents, which also keeps the
+  // mapped ranges aligned to the pages of the memory
+  auto extents = (pageCount + MMAP_EXTENT_PAGES - 1) / MMAP_EXTENT_PAGES;
+  auto newMappedPages = extents * MMAP_EXTENT_PAGES;
+
+  if (uint64_t(newMappedPages) * pageSize > MMAP_RESERVE_SIZE ||
+      ftruncate(file.fd, off_t(pageSize) * newMappedPages) != 0) {
+    return false;
+  }
+
+  auto offset = off_t(file.mappedPages) * pageSize;
+  auto len = size_t(newMappedPages - file.mappedPages) * pageSize;
+
+  if (mmap(file.map + offset, len, PROT_READ | PROT_WRITE,
+           MAP_SHARED | MAP_FIXED, file.fd, offset) == MAP_FAILED) {
+    return false;
+  }
+
+  file.mappedPages = newMappedPages;
+  return true;
+}
+
+bool Disc::readAt(FileHandle &file, char *dest, size_t len, uint_t pageIndex) {
+  auto offset = off_t(pageSize) * pageIndex;
+
+  Stats::add(Stats::DISC_PAGES_READ, len / pageSize);
+  Stats::add(Stats::DISC_BYTES_READ, len);
+
+  if (file.map) {
+    memcpy(dest, file.map + offset, len);
+    return true;
+  }
+
+  Stats::add(Stats::DISC_READ_CALLS);
+
+  return transferAll(pread, file.fd, dest, len, offset);
+}
+
+bool Disc::writeAt(FileHandle &file, const char *content, uint_t pageCount,
+                   uint_t pageIndex) {
+  auto offset = off_t(pageSize) * pageIndex;
+  auto len = size_t(pageSize) * pageCount;
+
+  Stats::add(Stats::DISC_PAGES_WRITTEN, pageCount);
+  Stats::add(Stats::DISC_BYTES_WRITTEN, len);
+
+  if (!file.map) {
+    Stats::add(Stats::DISC_WRITE_CALLS);
+    return transferAll(pwrite, file.fd, content, len, offset);
+  }
+
+  if (!mapPages(file, pageIndex + pageCount)) return false;
+
+  memcpy(file.map + offset, content, len);
+  return true;
+}
+
+bool Disc::releasePages(FileHandle &file, uint_t pageIndex) {
+  vector<char> chunk(size_t(pageSize) * READ_AHEAD_PAGES);
+
+  for (auto i = pageIndex; i < file.pageCount; i += READ_AHEAD_PAGES) {
+    auto count = std::min<uint_t>(READ_AHEAD_PAGES, file.pageCount - i);
+
+    if (!readAt(file, chunk.data(), size_t(pageSize) * count, i)) return false;
+
+    for (uint_t j = 0; j < count; ++j) {
+      PageAllocator::release(*(
+          reinterpret_cast<const uint_t *>(chunk.data() + j * pageSize) + 2));
+    }
+  }
+
+  return true;
+}
+
+void Disc::closeFile(FileHandle &file) {
+  if (file.map) {
+    munmap(file.map, MMAP_RESERVE_SIZE);
+
+    // Drop the padding of the last extent
+    if (ftruncate(file.fd, off_t(pageSize) * file.pageCount) != 0) {
+      // The padding pages will be skipped when the file is opened next time
+    }
+  }
+
+  close(file.fd);
+}
+
+void Disc::noteRead(FileHandle &file, uint_t pageIndex, uint_t count) {
+  file.seqRun = pageIndex == file.nextSeqPage ? file.seqRun + count : count;
+  file.nextSeqPage = pageIndex + count;
+
+  if (file.seqRun < READ_AHEAD_TRIGGER) return;
+
+  // Keep the hinted window READ_AHEAD_PAGES ahead of the reader, extending it
+  // half a window at a time so that the hints do not cost a call per page
+  auto end = std::min(file.pageCount, file.nextSeqPage + READ_AHEAD_PAGES);
+  auto begin = std::max(file.hintedUntil, file.nextSeqPage);
+
+  if (begin >= end || (end - begin < READ_AHEAD_PAGES / 2 &&
+                       end < file.pageCount)) {
+    return;
+  }
+
+  auto offset = off_t(pageSize) * begin;
+  auto len = size_t(pageSize) * (end - begin);
+
+  if (file.map) {
+    madvise(file.map + offset, len, MADV_WILLNEED);
+  } else {
+    posix_fadvise(file.fd, offset, len, POSIX_FADV_WILLNEED);
+  }
+
+  file.hintedUntil = end;
+}
+
+void Disc::setBackend(Backend backend) {
+  closeAll();
+  Disc::backend = backend;
+}
+
+char *Disc::mappedPage(const string &fileName, size_t locPageAddr) {
+  lock_guard<std::mutex> guard(mutex);
+  auto file = handle(fileName);
+
+  if (!file || !file->map || locPageAddr == 0 ||
+      locPageAddr > file->pageCount) {
+    return nullptr;
+  }
+
+  noteRead(*file, locPageAddr - 1, 1);
+  Stats::add(Stats::DISC_PAGES_READ);
+
+  return file->map + off_t(pageSize) * (locPageAddr - 1);
+}
+
+bool Disc::readPage(const string &fileName, const size_t locPageAddr,
+                    char *const data) {
+  FileHandle file;
+
+  {
+    lock_guard<std::mutex> guard(mutex);
+    auto open = handle(fileName);
+
+    if (!open || locPageAddr == 0 || locPageAddr > open->pageCount) {
+      return false;
+    }
+
+    noteRead(*open, locPageAddr - 1, 1);
+    file = *open;
+  }
+
+  if (!readAt(file, data, pageSize, locPageAddr - 1)) {
+    return false;
+  }
 
-char *Disc::readPage(const string &fileName, const size_t locPageAddr) {
-  ifstream file(fileName, ifstream::binary);
+  if (Stats::trace) {
+    cout << "-- Reading page #" << *(reinterpret_cast<uint_t *>(data) + 2)
+         << ":" << locPageAddr << " (file: " << fileName << ")" << endl;
+  }
+
+  return true;
+}
+
+bool Disc::readPages(const string &fileName, const size_t firstPageAddr,
+                     const uint_t count, char *const dest) {
+  FileHandle file;
+
+  {
+    lock_guard<std::mutex> guard(mutex);
+    auto open = handle(fileName);
+
+    if (!open || firstPageAddr == 0 ||
+        firstPageAddr + count - 1 > open->pageCount) {
+      return false;
+    }
+
+    noteRead(*open, firstPageAddr - 1, count);
+    file = *open;
+  }
+
+  if (!readAt(file, dest, size_t(pageSize) * count, firstPageAddr - 1)) {
+    return false;
+  }
 
-  file.seekg(PAGE_SIZE * (locPageAddr - 1));
+  for (uint_t i = 0; Stats::trace && i < count; ++i) {
+    cout << "-- Reading page #"
+         << *(reinterpret_cast<uint_t *>(dest + i * pageSize) + 2) << ":"
+         << firstPageAddr + i << " (file: " << fileName << ")" << endl;
+  }
 
-  char *data = new char[PAGE_SIZE];
+  return true;
+}
 
-  file.read(data, PAGE_SIZE);
+bool Disc::readPagesShared(const string &fileName, const size_t firstPageAddr,
+                           const uint_t count, char *const dest) {
+  FileHandle file;
 
-  file.close();
+  {
+    lock_guard<std::mutex> guard(mutex);
+    auto it = handles.find(fileName);
 
-  if (!file) return nullptr;
+    if (it == handles.end() || firstPageAddr == 0 ||
+        firstPageAddr + count - 1 > it->second.pageCount) {
+      return false;
+    }
 
-  cout << "-- Reading page #" << *(reinterpret_cast<uint_t *>(data) + 2) << ":"
-       << locPageAddr << " (file: " << fileName << ")" << endl;
+    file = it->second;
+  }
 
-  return data;
+  return readAt(file, dest, size_t(pageSize) * count, firstPageAddr - 1);
 }
 
 bool Disc::writePage(const string &fileName, const size_t locPageAddr,
                      const char *const content) {
-  fstream file(fileName, fstream::binary | fstream::in | fstream::out);
+  lock_guard<std::mutex> guard(mutex);
+  auto file = handle(fileName);
+
+  if (!file || locPageAddr == 0 || locPageAddr > file->pageCount) return false;
 
-  file.seekp(PAGE_SIZE * (locPageAddr - 1));
-  file.write(content, PAGE_SIZE);
+  if (!writeAt(*file, content, 1, locPageAddr - 1)) {
+    return false;
+  }
 
-  file.close();
+  if (Stats::trace) {
+    cout << "-- Writing to page #"
+         << *(reinterpret_cast<const uint_t *>(content) + 2) << ":"
+         << locPageAddr << " (file: " << fileName << ")" << endl;
+  }
 
-  if (!file) return false;
+  return true;
+}
 
-  cout << "-- Writing to page #"
-       << *(reinterpret_cast<const uint_t *>(content) + 2) << ":" << locPageAddr
-       << " (file: " << fileName << ")" << endl;
+bool Disc::writePages(const string &fileName, const size_t firstPageAddr,
+                      const uint_t count, const char *const content) {
+  lock_guard<std::mutex> guard(mutex);
+  auto file = handle(fileName);
+
+  if (!file || firstPageAddr == 0 ||
+      firstPageAddr + count - 1 > file->pageCount) {
+    return false;
+  }
+
+  if (!writeAt(*file, content, count, firstPageAddr - 1)) {
+    return false;
+  }
+
+  for (uint_t i = 0; Stats::trace && i < count; ++i) {
+    cout << "-- Writing to page #"
+         << *(reinterpret_cast<const uint_t *>(content + i * pageSize) + 2)
+         << ":" << firstPageAddr + i << " (file: " << fileName << ")" << endl;
+  }
 
   return true;
 }
 
 uint_t Disc::getPageCount(const string &fileName) {
-  ifstream file(fileName, ifstream::binary);
+  lock_guard<std::mutex> guard(mutex);
+  auto file = handle(fileName);
+
+  return file ? file->pageCount : 0;
+}
 
-  file.seekg(0, file.end);
-  auto size = file.tellg();
+bool Disc::appendPage(const string &fileName, uint_t *locPageAddr) {
+  lock_guard<std::mutex> guard(mutex);
+  auto file = handle(fileName, true);
 
-  file.close();
+  if (!file) return false;
+
+  uint_t globAddr;
 
-  return size / PAGE_SIZE;
+  if (!PageAllocator::allocate(1, &globAddr)) {
+    discFull = true;
+    return false;
+  }
+
+  vector<char> emptyPageData(pageSize);
+  *(reinterpret_cast<uint_t *>(emptyPageData.data()) + 2) = globAddr;
+
+  if (!((!Wal::isOpen() || Wal::appendPage(fileName, file->pageCount + 1,
+                                           emptyPageData.data())) &&
+        writeAt(*file, emptyPageData.data(), 1, file->pageCount))) {
+    PageAllocator::release(globAddr);
+    return false;
+  }
+
+  ++file->pageCount;
+  Stats::add(Stats::DISC_PAGES_APPENDED);
+
+  if (locPageAddr) *locPageAddr = file->pageCount;
+
+  return true;
 }
 
-bool Disc::appendPage(const string &fileName) {
-  if (newPageAddr == MAX_PAGE_COUNT) {
+bool Disc::appendPages(const string &fileName, char *const pages,
+                       const uint_t count) {
+  lock_guard<std::mutex> guard(mutex);
+  auto file = handle(fileName, true);
+
+  if (!file) return false;
+
+  vector<uint_t> globAddrs(count);
+
+  if (!PageAllocator::allocate(count, globAddrs.data())) {
     discFull = true;
     return false;
   }
 
-  auto emptyPageData = new char[PAGE_SIZE];
-  memset(emptyPageData, 0, PAGE_SIZE);
-  *(reinterpret_cast<uint_t *>(emptyPageData) + 2) = newPageAddr++;
+  const bool logged = Wal::isOpen();
+  bool suc = true;
+  vector<char> emptyPages(logged ? size_t(count) * pageSize : 0);
+
+  for (uint_t i = 0; suc && i < count; ++i) {
+    auto page = pages + i * pageSize;
+    *(reinterpret_cast<uint_t *>(page) + 2) = globAddrs[i];
+
+    if (logged) {
+      *(reinterpret_cast<uint_t *>(emptyPages.data() + i * pageSize) + 2) =
+          globAddrs[i];
+      suc = Wal::appendPage(fileName, file->pageCount + i + 1, page);
+    }
+  }
+
+  if (!(suc && writeAt(*file, logged ? emptyPages.data() : pages, count,
+                       file->pageCount))) {
+    for (auto globAddr : globAddrs) {
+      PageAllocator::release(globAddr);
+    }
+
+    return false;
+  }
+
+  file->pageCount += count;
+  Stats::add(Stats::DISC_PAGES_APPENDED, count);
+
+  return true;
+}
+
+bool Disc::restorePage(const string &fileName, const size_t locPageAddr,
+                       const char *const content) {
+  lock_guard<std::mutex> guard(mutex);
+  auto file = handle(fileName, true);
+
+  if (!file || locPageAddr == 0 ||
+      !writeAt(*file, content, 1, locPageAddr - 1)) {
+    return false;
+  }
+
+  if (locPageAddr > file->pageCount) file->pageCount = locPageAddr;
+
+  return true;
+}
+
+bool Disc::syncAll() {
+  lock_guard<std::mutex> guard(mutex);
+  bool suc = true;
+
+  for (const auto &file : handles) {
+    Stats::add(Stats::DISC_SYNC_CALLS, file.second.map ? 2 : 1);
+
+    if (file.second.map &&
+        msync(file.second.map, size_t(pageSize) * file.second.mappedPages,
+              MS_SYNC) != 0) {
+      suc = false;
+    }
+
+    if (fsync(file.second.fd) != 0) suc = false;
+  }
+
+  return suc;
+}
 
-  ofstream file(fileName, ofstream::app | ofstream::binary);
+bool Disc::truncateFile(const string &fileName, uint_t pageCount) {
+  lock_guard<std::mutex> guard(mutex);
+  auto file = handle(fileName);
 
-  file.write(emptyPageData, PAGE_SIZE);
+  if (!file) return false;
 
-  file.close();
+  if (pageCount >= file->pageCount) return true;
 
-  delete[] emptyPageData;
+  if (!releasePages(*file, pageCount)) return false;
 
-  if (!file) {
+  if (file->map) {
+    // The mapping keeps its extents; the cut pages become padding, which is
+    // dropped when the file is closed
+    memset(file->map + size_t(pageSize) * pageCount, 0,
+           size_t(pageSize) * (file->pageCount - pageCount));
+  } else if (ftruncate(file->fd, off_t(pageSize) * pageCount) != 0) {
     return false;
   }
 
+  file->pageCount = pageCount;
+  file->nextSeqPage = std::min(file->nextSeqPage, pageCount);
+  file->hintedUntil = std::min(file->hintedUntil, pageCount);
+
   return true;
 }
+
+void Disc::removeFile(const string &fileName, bool releaseAddrs) {
+  lock_guard<std::mutex> guard(mutex);
+
+  if (releaseAddrs) {
+    auto file = handle(fileName);
+
+    if (file) releasePages(*file, 0);
+  }
+
+  Wal::appendRemove(fileName);
+
+  auto it = handles.find(fileName);
+
+  if (it != handles.end()) {
+    closeFile(it->second);
+    handles.erase(it);
+  }
+
+  remove(fileName.c_str());
+}
+
+void Disc::closeAll() {
+  lock_guard<std::mutex> guard(mutex);
+
+  for (auto &file : handles) {
+    closeFile(file.second);
+  }
+
+  handles.clear();
+}
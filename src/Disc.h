@@ -5,26 +5,275 @@
 #ifndef STGMGR_DISC_H
 #define STGMGR_DISC_H
 
+#include <atomic>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include "constants.h"
 
+/**
+ * The page-granular access to the files of the database.
+ *
+ * There are two backends. The pread backend transfers pages with positioned
+ * reads and writes. The mmap backend maps each file into memory, so pages can
+ * be read in place through mappedPage() and the kernel page cache does the
+ * caching; the files are grown by MMAP_EXTENT_PAGES pages at a time. The
+ * pages are never changed in place, only written with writePage(), since the
+ * kernel may write a mapped page to its file at any time (see BufferPool).
+ *
+ * The functions may be called by several threads at once. The open files are
+ * guarded by a mutex, which the reads hold only to find the file, so the
+ * reads themselves run in parallel. A file must not be truncated or removed
+ * while other threads use it, which the locks of the types ensure (see
+ * LockManager).
+ */
 class Disc {
  public:
-  static char *readPage(const std::string &fileName, size_t locPageAddr);
+  enum Backend : uint_t { BACKEND_PREAD = 0, BACKEND_MMAP = 1 };
+
+  /**
+   * Selects the backend. All the open files are closed.
+   *
+   * @param backend The backend
+   */
+  static void setBackend(Backend backend);
+
+  static Backend backend;
+
+  /**
+   * Gives a page of a file in place, inside the mapping of the file. Only
+   * for the mmap backend.
+   *
+   * @param fileName The name of the file
+   * @param locPageAddr The local address of the page
+   * @return The pointer to the first byte of the page, or null if the page
+   * does not exist or the backend is not mmap. The pointer stays valid until
+   * the file is closed.
+   */
+  static char *mappedPage(const std::string &fileName, size_t locPageAddr);
+
+  static bool readPage(const std::string &fileName, size_t locPageAddr,
+                       char *dest);
+
+  /**
+   * Reads several consecutive pages of a file with a single read.
+   *
+   * @param fileName The name of the file
+   * @param firstPageAddr The local address of the first page
+   * @param count The number of pages
+   * @param dest The buffer to read into, large enough for all the pages
+   * @return Success/failure
+   */
+  static bool readPages(const std::string &fileName, size_t firstPageAddr,
+                        uint_t count, char *dest);
+
+  /**
+   * Like readPages(), but changes no state of this class, so that the reads
+   * of a parallel scan do not disturb the read-ahead of the serial ones. The
+   * file must already be open (e.g., through getPageCount()). Nothing is
+   * traced.
+   *
+   * @param fileName The name of the file
+   * @param firstPageAddr The local address of the first page
+   * @param count The number of pages
+   * @param dest The buffer to read into, large enough for all the pages
+   * @return Success/failure
+   */
+  static bool readPagesShared(const std::string &fileName,
+                              size_t firstPageAddr, uint_t count, char *dest);
 
   static bool writePage(const std::string &fileName, size_t locPageAddr,
                         const char *content);
 
-  static bool appendPage(const std::string &fileName);
+  /**
+   * Writes several consecutive pages of a file with a single write.
+   *
+   * @param fileName The name of the file
+   * @param firstPageAddr The local address of the first page
+   * @param count The number of pages, which must all exist
+   * @param content The pages, one after another
+   * @return Success/failure
+   */
+  static bool writePages(const std::string &fileName, size_t firstPageAddr,
+                         uint_t count, const char *content);
+
+  /**
+   * Appends an empty page to a file, creating the file if it does not exist.
+   * The page is given a global address by PageAllocator.
+   *
+   * @param fileName The name of the file
+   * @param locPageAddr If not null, the local address of the new page will be
+   * stored here.
+   * @return Success/failure
+   */
+  static bool appendPage(const std::string &fileName,
+                         uint_t *locPageAddr = nullptr);
+
+  /**
+   * Appends several pages to a file with a single write. Each page is given
+   * a global address by PageAllocator, which is written into its header.
+   *
+   * While the log is open, the pages are logged, but written to the file
+   * empty (like appendPage() does): their contents may not reach the file
+   * before they are committed, so the caller should write them once they are
+   * (see BufferPool::writePages()).
+   *
+   * @param fileName The name of the file
+   * @param pages The pages, one after another
+   * @param count The number of pages
+   * @return Success/failure
+   */
+  static bool appendPages(const std::string &fileName, char *pages,
+                          uint_t count);
 
   static uint_t getPageCount(const std::string &fileName);
 
-  static bool discFull;
+  /**
+   * Writes a page to a file during recovery. Unlike writePage(), the file is
+   * created if it does not exist, and it is extended if the page is beyond
+   * its end.
+   *
+   * @param fileName The name of the file
+   * @param locPageAddr The local address of the page
+   * @param content The whole page
+   * @return Success/failure
+   */
+  static bool restorePage(const std::string &fileName, size_t locPageAddr,
+                          const char *content);
 
   /**
-   * The global address of the first newly created page will be this
+   * Flushes all the open files to the disc.
+   *
+   * @return Success/failure
+   */
+  static bool syncAll();
+
+  /**
+   * Cuts the pages at the end of a file off, and gives their global
+   * addresses back to PageAllocator. The pages should not be in the buffer
+   * pool, nor in the log (i.e. the log should be checkpointed first).
+   *
+   * @param fileName The name of the file
+   * @param pageCount The number of the pages to be kept
+   * @return Success/failure
+   */
+  static bool truncateFile(const std::string &fileName, uint_t pageCount);
+
+  /**
+   * Closes the file (if it is open) and removes it from the disc.
+   *
+   * @param fileName The name of the file
+   * @param releaseAddrs Whether the global addresses of the pages are given
+   * back to PageAllocator. Only for the files of the database; a file left
+   * over from an interrupted run may have addresses which are already reused.
+   */
+  static void removeFile(const std::string &fileName,
+                         bool releaseAddrs = false);
+
+  /**
+   * Closes all the open files.
+   */
+  static void closeAll();
+
+  /**
+   * Whether a page could not be appended since the capacity of the database
+   * was reached
+   */
+  static std::atomic<bool> discFull;
+
+  /**
+   * The size of the pages of the database, which is chosen when formatting.
+   * Must be set before any page is read.
+   */
+  static uint_t pageSize;
+
+  /**
+   * The largest number of pages the database may have (0 if unlimited)
+   */
+  static uint_t maxPageCount;
+
+  /**
+   * The global addresses from this one on have never been used. See
+   * PageAllocator for the addresses below it, and for the mutex which guards
+   * this.
    */
   static uint_t newPageAddr;
+
+ private:
+  /**
+   * An open file, together with its page count. The page count is tracked in
+   * memory after the file is opened, so that it is not derived from the file
+   * size on every call.
+   */
+  struct FileHandle {
+    int fd;
+    uint_t pageCount;
+
+    /**
+     * The start of the address range reserved for the mapping of the file
+     * (mmap backend only), and the number of pages mapped in it.
+     */
+    char *map;
+    uint_t mappedPages;
+
+    /**
+     * The page index a sequential reader would read next, the number of
+     * pages read sequentially so far, and the page index up to which the
+     * kernel was already asked to read ahead
+     */
+    uint_t nextSeqPage;
+    uint_t seqRun;
+    uint_t hintedUntil;
+  };
+
+  /**
+   * Gives the handle of a file, opening the file if it is not open yet.
+   *
+   * @param fileName The name of the file
+   * @param create Whether the file should be created if it does not exist
+   * @return The handle, or null if the file could not be opened
+   */
+  static FileHandle *handle(const std::string &fileName, bool create = false);
+
+  static bool mapPages(FileHandle &file, uint_t pageCount);
+
+  static bool readAt(FileHandle &file, char *dest, size_t len,
+                     uint_t pageIndex);
+
+  static bool writeAt(FileHandle &file, const char *content, uint_t pageCount,
+                      uint_t pageIndex);
+
+  /**
+   * Gives the global addresses of the pages of a file from the given one on
+   * back to PageAllocator.
+   *
+   * @param file The file
+   * @param pageIndex The index of the first page
+   * @return Success/failure
+   */
+  static bool releasePages(FileHandle &file, uint_t pageIndex);
+
+  static void closeFile(FileHandle &file);
+
+  /**
+   * Records a read of the given pages. Once the file is read sequentially,
+   * asks the kernel to read the next READ_AHEAD_PAGES pages in the
+   * background, so that the following reads do not wait for the disc.
+   *
+   * @param file The file
+   * @param pageIndex The index of the first page read
+   * @param count The number of pages read
+   */
+  static void noteRead(FileHandle &file, uint_t pageIndex, uint_t count);
+
+  /**
+   * The size of the page header fields read by this class (up to the global
+   * address)
+   */
+  static const size_t PAGE_HEADER_SIZE = 3 * sizeof(uint_t);
+
+  static std::mutex mutex;
+  static std::unordered_map<std::string, FileHandle> handles;
 };
 
 #endif  // STGMGR_DISC_H
@@ -0,0 +1,107 @@
+//
+// Created by Alper Çakan on 9.04.2018.
+//
+
+#include "FreeSpaceMap.h"
+#include "Disc.h"
+#include "Page.h"
+#include "Transaction.h"
+
+#include <algorithm>
+
+using std::lock_guard;
+using std::string;
+
+std::mutex FreeSpaceMap::mutex;
+
+/**
+ * The number of pages covered by one page of a map file.
+ */
+static uint_t pagesPerMapPage() { return Page::contentSize() * 8; }
+
+string FreeSpaceMap::mapFileName(const string &fileName) {
+  return fileName + ".fsm";
+}
+
+uint_t FreeSpaceMap::findPage(const string &fileName) {
+  lock_guard<std::mutex> guard(mutex);
+  auto pageCount = Disc::getPageCount(fileName);
+  auto mapName = mapFileName(fileName);
+  auto mapPageCount = Disc::getPageCount(mapName);
+
+  for (uint_t mapPage = 1; mapPage <= mapPageCount; ++mapPage) {
+    auto first = (mapPage - 1) * pagesPerMapPage();
+
+    if (first >= pageCount) return 0;
+
+    Page page(mapName, mapPage);
+
+    if (!page) return 0;
+
+    auto words = reinterpret_cast<const uint_t *>(page.content());
+
+    for (uint_t i = 0; i < Page::contentSize() / sizeof(uint_t); ++i) {
+      if (~words[i] == 0) continue;
+
+      auto locAddr = first + i * 64 + __builtin_ctzll(~words[i]) + 1;
+
+      return locAddr <= pageCount ? locAddr : 0;
+    }
+  }
+
+  // The pages beyond the map have never been marked
+  auto covered = mapPageCount * pagesPerMapPage();
+
+  return covered < pageCount ? covered + 1 : 0;
+}
+
+bool FreeSpaceMap::setFull(const string &fileName, uint_t locPageAddr,
+                           bool full) {
+  return setFull(fileName, locPageAddr, 1, full);
+}
+
+bool FreeSpaceMap::setFull(const string &fileName, uint_t firstPageAddr,
+                           uint_t pageCount, bool full) {
+  lock_guard<std::mutex> guard(mutex);
+
+  // The maps are hints, so they are changed in place even in a transaction
+  Transaction::Scope scope(nullptr);
+  auto mapName = mapFileName(fileName);
+  auto end = firstPageAddr + pageCount;  // Exclusive
+
+  for (auto locAddr = firstPageAddr; locAddr < end;) {
+    auto mapPage = (locAddr - 1) / pagesPerMapPage() + 1;
+    auto mapPageEnd = std::min(end, mapPage * pagesPerMapPage() + 1);
+
+    if (!full && Disc::getPageCount(mapName) < mapPage) {
+      return true;  // Unmarked pages already count as having room
+    }
+
+    while (Disc::getPageCount(mapName) < mapPage) {
+      if (!Disc::appendPage(mapName)) return false;
+    }
+
+    Page page(mapName, mapPage, Page::LATCH_EXCLUSIVE);
+
+    if (!page) return false;
+
+    for (; locAddr < mapPageEnd; ++locAddr) {
+      auto bit = (locAddr - 1) % pagesPerMapPage();
+      auto pos = bit / 64 * sizeof(uint_t);
+      auto word = page.getUIntAtPos(pos);
+      auto mask = uint_t(1) << (bit % 64);
+      auto newWord = full ? word | mask : word & ~mask;
+
+      if (newWord != word) {
+        page.writeContent(reinterpret_cast<const char *>(&newWord),
+                          sizeof(uint_t), pos);
+      }
+    }
+
+    if (!page.isUsed()) page.setIsUsed(true);
+
+    if (!page.persist()) return false;
+  }
+
+  return true;
+}
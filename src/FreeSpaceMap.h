@@ -0,0 +1,71 @@
+//
+// Created by Alper Çakan on 9.04.2018.
+//
+
+#ifndef STGMGR_FREESPACEMAP_H
+#define STGMGR_FREESPACEMAP_H
+
+#include <mutex>
+#include <string>
+#include "constants.h"
+
+/**
+ * A persistent bitmap which tells, for each page of a file, whether the page
+ * is known to be full.
+ *
+ * The bitmap of a file is stored in a separate file (see mapFileName()). A
+ * clear bit means that the page may have room, so a page which has never
+ * been marked is considered to have room.
+ *
+ * The maps are guarded by a mutex, so they may be used by several threads at
+ * once. A page found by findPage() may be filled by another thread before it
+ * is latched, so its room must be checked again under the latch. The maps
+ * are changed in place even while a transaction is open (see Transaction).
+ */
+class FreeSpaceMap {
+ public:
+  /**
+   * Finds the first page of a file which is not marked as full.
+   *
+   * @param fileName The name of the file
+   * @return The local address of the page, or 0 if all the pages of the file
+   * are marked as full
+   */
+  static uint_t findPage(const std::string &fileName);
+
+  /**
+   * Marks a page of a file as full or as having room.
+   *
+   * @param fileName The name of the file
+   * @param locPageAddr The local address of the page
+   * @param full Whether the page is full
+   * @return Success/failure
+   */
+  static bool setFull(const std::string &fileName, uint_t locPageAddr,
+                      bool full);
+
+  /**
+   * Marks a range of consecutive pages of a file as full or as having room.
+   *
+   * @param fileName The name of the file
+   * @param firstPageAddr The local address of the first page of the range
+   * @param pageCount The number of pages in the range
+   * @param full Whether the pages are full
+   * @return Success/failure
+   */
+  static bool setFull(const std::string &fileName, uint_t firstPageAddr,
+                      uint_t pageCount, bool full);
+
+  /**
+   * Gives the name of the file in which the map of a file is stored.
+   *
+   * @param fileName The name of the file
+   * @return The name of the map file
+   */
+  static std::string mapFileName(const std::string &fileName);
+
+ private:
+  static std::mutex mutex;
+};
+
+#endif  // STGMGR_FREESPACEMAP_H
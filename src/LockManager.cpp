@@ -0,0 +1,260 @@
+//
+// Created by Alper Çakan on 9.04.2018.
+//
+
+#include "LockManager.h"
+
+#include <pthread.h>
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using std::pair;
+using std::string;
+using std::unique_ptr;
+using std::unordered_map;
+using std::vector;
+
+/**
+ * The locks held by the current thread, with their modes, in the order in
+ * which they were acquired, or null if it holds none. The list exists only
+ * while the thread holds a lock, so the thread-local objects which take
+ * locks when the thread exits (e.g. its Transaction) never find it destroyed.
+ */
+static thread_local vector<pair<const Lock *, Lock::Mode>> *held = nullptr;
+
+bool Lock::compatible(Mode a, Mode b) {
+  static const bool table[MODE_COUNT][MODE_COUNT] = {
+      {true, true, true, false},
+      {true, true, false, false},
+      {true, false, true, false},
+      {false, false, false, false}};
+
+  return table[a][b];
+}
+
+bool Lock::grantable(Mode mode, const uint_t *own, uint_t ticket) const {
+  for (int m = 0; m < MODE_COUNT; ++m) {
+    if (holders[m] > own[m] && !compatible(Mode(m), mode)) return false;
+  }
+
+  if (!ticket) return true;
+
+  for (const auto &request : queue) {
+    if (request.ticket == ticket) break;
+
+    if (!compatible(request.mode, mode)) return false;
+  }
+
+  return true;
+}
+
+void Lock::acquire(Mode mode) {
+  uint_t own[MODE_COUNT] = {};
+
+  if (held) {
+    for (const auto &entry : *held) {
+      if (entry.first == this) ++own[entry.second];
+    }
+  }
+
+  std::unique_lock<std::mutex> guard(mutex);
+
+  if (held || (queue.empty() && grantable(mode, own, 0))) {
+    changed.wait(guard, [&] { return grantable(mode, own, 0); });
+  } else {
+    auto ticket = nextTicket++;
+    queue.push_back({ticket, mode});
+    changed.wait(guard, [&] { return grantable(mode, own, ticket); });
+
+    queue.erase(std::find_if(
+        queue.begin(), queue.end(),
+        [ticket](const Request &request) { return request.ticket == ticket; }));
+
+    // The requests after this one may have waited only for it
+    if (!queue.empty()) changed.notify_all();
+  }
+
+  ++holders[mode];
+  guard.unlock();
+
+  if (!held) held = new vector<pair<const Lock *, Lock::Mode>>();
+
+  held->push_back({this, mode});
+}
+
+void Lock::release(Mode mode) {
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    --holders[mode];
+  }
+
+  changed.notify_all();
+
+  for (auto it = held->rbegin(); it != held->rend(); ++it) {
+    if (it->first == this && it->second == mode) {
+      held->erase(std::next(it).base());
+      break;
+    }
+  }
+
+  if (held->empty()) {
+    delete held;
+    held = nullptr;
+  }
+}
+
+LockGuard::LockGuard(Lock &lock, Lock::Mode mode) : lock(&lock), mode(mode) {
+  lock.acquire(mode);
+}
+
+LockGuard::LockGuard(LockGuard &&other) noexcept { *this = std::move(other); }
+
+LockGuard &LockGuard::operator=(LockGuard &&other) noexcept {
+  if (this != &other) {
+    release();
+    lock = other.lock;
+    mode = other.mode;
+    other.lock = nullptr;
+  }
+
+  return *this;
+}
+
+LockGuard::~LockGuard() { release(); }
+
+void LockGuard::release() {
+  if (lock) lock->release(mode);
+
+  lock = nullptr;
+}
+
+TypeLock::TypeLock(const string &typeName, Lock::Mode mode)
+    : database(LockManager::database(),
+               mode == Lock::INTENT_SHARED || mode == Lock::SHARED
+                   ? Lock::INTENT_SHARED
+                   : Lock::INTENT_EXCLUSIVE),
+      type(LockManager::of(typeName), mode) {}
+
+Lock &LockManager::database() {
+  static Lock lock;
+
+  return lock;
+}
+
+Lock &LockManager::commits() {
+  static Lock lock;
+
+  return lock;
+}
+
+Lock &LockManager::of(const string &fileName) {
+  static std::mutex mutex;
+  static unordered_map<string, unique_ptr<Lock>> locks;
+
+  std::lock_guard<std::mutex> guard(mutex);
+  auto &lock = locks[fileName];
+
+  if (!lock) lock.reset(new Lock());
+
+  return *lock;
+}
+
+/**
+ * A latch of a page, which exists while a thread holds or waits for it, and
+ * is kept for a while after that in case the page is latched again
+ */
+struct Latch {
+  pthread_rwlock_t lock;
+  uint_t users;
+};
+
+struct LatchKey {
+  string fileName;
+  uint_t locAddr;
+  size_t hash;  // Computed once, for both the part and the table
+
+  LatchKey(const string &fileName, uint_t locAddr)
+      : fileName(fileName),
+        locAddr(locAddr),
+        hash(std::hash<string>()(fileName) ^ (locAddr * 31)) {}
+
+  bool operator==(const LatchKey &other) const {
+    return locAddr == other.locAddr && fileName == other.fileName;
+  }
+};
+
+struct LatchKeyHash {
+  size_t operator()(const LatchKey &key) const { return key.hash; }
+};
+
+/**
+ * A part of the latches, which are spread over the parts by their pages so
+ * that the threads rarely wait for each other to find a latch
+ */
+struct LatchShard {
+  std::mutex mutex;
+  unordered_map<LatchKey, Latch, LatchKeyHash> latches;
+  uint_t idle = 0;  // The number of the latches without users
+};
+
+static LatchShard latchShards[LATCH_SHARD_COUNT];
+
+/**
+ * Gives the part of the latches to which the latch of a page belongs.
+ */
+static LatchShard &shardOf(const LatchKey &key) {
+  return latchShards[key.hash % LATCH_SHARD_COUNT];
+}
+
+void LockManager::latch(const string &fileName, uint_t locPageAddr,
+                        bool exclusive) {
+  LatchKey key(fileName, locPageAddr);
+  auto &shard = shardOf(key);
+  Latch *latch;
+
+  {
+    std::lock_guard<std::mutex> guard(shard.mutex);
+    auto it = shard.latches.find(key);
+
+    if (it == shard.latches.end()) {
+      it = shard.latches.emplace(std::move(key), Latch()).first;
+      pthread_rwlock_init(&it->second.lock, nullptr);
+    } else if (it->second.users == 0) {
+      --shard.idle;
+    }
+
+    latch = &it->second;
+    ++latch->users;
+  }
+
+  // The entry stays in place while it has users
+  if (exclusive) {
+    pthread_rwlock_wrlock(&latch->lock);
+  } else {
+    pthread_rwlock_rdlock(&latch->lock);
+  }
+}
+
+void LockManager::unlatch(const string &fileName, uint_t locPageAddr) {
+  LatchKey key(fileName, locPageAddr);
+  auto &shard = shardOf(key);
+
+  std::lock_guard<std::mutex> guard(shard.mutex);
+  auto it = shard.latches.find(key);
+
+  if (it == shard.latches.end()) return;
+
+  pthread_rwlock_unlock(&it->second.lock);
+
+  if (--it->second.users > 0) return;
+
+  if (shard.idle < LATCH_IDLE_LIMIT) {
+    ++shard.idle;
+  } else {
+    pthread_rwlock_destroy(&it->second.lock);
+    shard.latches.erase(it);
+  }
+}
@@ -0,0 +1,214 @@
+//
+// Created by Alper Çakan on 9.04.2018.
+//
+
+#ifndef STGMGR_LOCKMANAGER_H
+#define STGMGR_LOCKMANAGER_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include "constants.h"
+
+/**
+ * A lock of multiple granularity locking, which threads hold in one of four
+ * modes. A mode is granted when it is compatible with the modes held by the
+ * other threads:
+ *
+ *          IS  IX  S   X
+ *      IS  yes yes yes no
+ *      IX  yes yes no  no
+ *      S   yes no  yes no
+ *      X   no  no  no  no
+ *
+ * The intent modes (IS, IX) are taken on the database by the operations on a
+ * single type, and on a type by the operations which latch its pages one at
+ * a time. The modes a thread already holds never block it, so a thread may
+ * take the same lock again, or a stronger mode of it.
+ *
+ * Requests are granted in the order in which they arrive, so a waiting
+ * exclusive request is not starved by a stream of shared ones. A thread which
+ * already holds some lock skips the queue, since it may be what the requests
+ * before it are waiting for.
+ */
+class Lock {
+ public:
+  enum Mode : int {
+    INTENT_SHARED,
+    INTENT_EXCLUSIVE,
+    SHARED,
+    EXCLUSIVE,
+    MODE_COUNT
+  };
+
+  Lock() = default;
+
+  Lock(const Lock &) = delete;
+
+  Lock &operator=(const Lock &) = delete;
+
+  /**
+   * Waits until the lock is granted in the given mode.
+   */
+  void acquire(Mode mode);
+
+  /**
+   * Releases one acquisition of the lock in the given mode.
+   */
+  void release(Mode mode);
+
+  /**
+   * Whether two modes may be held by two threads at once.
+   */
+  static bool compatible(Mode a, Mode b);
+
+ private:
+  struct Request {
+    uint_t ticket;
+    Mode mode;
+  };
+
+  /**
+   * Whether a mode may be granted now.
+   *
+   * @param mode The mode
+   * @param own The number of times the requesting thread holds each mode
+   * @param ticket The ticket of the request, or 0 if it skips the queue
+   */
+  bool grantable(Mode mode, const uint_t *own, uint_t ticket) const;
+
+  std::mutex mutex;
+  std::condition_variable changed;
+  uint_t holders[MODE_COUNT] = {};
+  std::deque<Request> queue;
+  uint_t nextTicket = 1;
+};
+
+/**
+ * Holds a lock in a mode from its construction to its destruction.
+ */
+class LockGuard {
+ public:
+  LockGuard() = default;
+
+  LockGuard(Lock &lock, Lock::Mode mode);
+
+  LockGuard(LockGuard &&other) noexcept;
+
+  LockGuard &operator=(LockGuard &&other) noexcept;
+
+  LockGuard(const LockGuard &) = delete;
+
+  LockGuard &operator=(const LockGuard &) = delete;
+
+  ~LockGuard();
+
+  /**
+   * Releases the lock before the destruction.
+   */
+  void release();
+
+ private:
+  Lock *lock = nullptr;
+  Lock::Mode mode = Lock::SHARED;
+};
+
+/**
+ * Holds the lock of a type in a mode, and the lock of the database in the
+ * matching intent mode, which is taken first.
+ */
+class TypeLock {
+ public:
+  TypeLock() = default;
+
+  /**
+   * @param typeName The name of the type
+   * @param mode The mode of the lock of the type
+   */
+  TypeLock(const std::string &typeName, Lock::Mode mode);
+
+ private:
+  LockGuard database, type;
+};
+
+/**
+ * The locks of the storage manager, and the latches of the pages.
+ *
+ * The locks are taken for a whole operation, by the functions of
+ * StorageManager.h, in this order:
+ *
+ *  1. The database: IS by the readers of a type, IX by its writers, S by
+ *     ::commit() and ::checkpoint() (so a commit never takes in half of an
+ *     operation) and by ::vacuum(), ::createIndex(), ::bulkLoad() and
+ *     ::searchRecord() deleting all the records of a type, which commit as
+ *     they go and so keep the writers out, and X by the operations on the
+ *     whole system catalogue and by ::commit() of a transaction (see
+ *     Transaction), which holds no lock before.
+ *  2. A type: IS by the lookups and the serial scans, IX by the operations
+ *     which create or delete records, S by the parallel scans (which read
+ *     the data file past the buffer pool) and X by the operations which
+ *     change the schema, move records or commit as they go.
+ *  3. The commits: X by an operation which commits as it goes, from the
+ *     start of each of its steps until the commit which ends it, and S by
+ *     ::commit() and ::checkpoint(), so that no other thread commits (or
+ *     checkpoints) a step half made. Since the database is only locked
+ *     shared by them, two such operations may run at once, but their steps
+ *     take turns. No page is latched while it is waited for.
+ *  4. The primary key index of a type: X from the uniqueness check of a
+ *     new record until its entry is added, and by the deletes.
+ *
+ * A latch is held on a page while a Page object of it exists: shared by the
+ * readers, exclusive by the writers. The latch of a page in the buffer pool
+ * belongs to its frame; with Disc::BACKEND_MMAP, where a page is read either
+ * from its frame or from the mapping, the latches of all the pages are kept
+ * here instead. A thread may latch several pages of a file at once only in
+ * ascending order of their local addresses, unless it holds the type
+ * exclusively. The indexes other than the primary key are
+ * latched after the data pages, and the free-space maps after both. The
+ * modules below them (BufferPool, Disc, Wal and PageAllocator) have mutexes
+ * of their own, which are never held while waiting for a lock or a latch.
+ */
+class LockManager {
+ public:
+  /**
+   * Gives the lock of the whole database.
+   */
+  static Lock &database();
+
+  /**
+   * Gives the lock of the commits, which an operation committing as it goes
+   * holds exclusively during each of its steps.
+   */
+  static Lock &commits();
+
+  /**
+   * Gives the lock of a type, or of an index, by the name of its file. The
+   * lock exists as long as the program runs.
+   *
+   * @param fileName The name of the data file of the type, or of the index
+   * file
+   */
+  static Lock &of(const std::string &fileName);
+
+  /**
+   * Waits until a page is latched by the latch kept here (with the mmap
+   * backend only, see above).
+   *
+   * @param fileName The name of the file in which the page resides
+   * @param locPageAddr The local address of the page
+   * @param exclusive Whether the latch is exclusive (or shared)
+   */
+  static void latch(const std::string &fileName, uint_t locPageAddr,
+                    bool exclusive);
+
+  /**
+   * Releases a latch taken by latch().
+   *
+   * @param fileName The name of the file in which the page resides
+   * @param locPageAddr The local address of the page
+   */
+  static void unlatch(const std::string &fileName, uint_t locPageAddr);
+};
+
+#endif  // STGMGR_LOCKMANAGER_H
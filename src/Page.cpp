@@ -3,21 +3,87 @@
 //
 
 #include "Page.h"
+#include "BufferPool.h"
 #include "Disc.h"
+#include "LockManager.h"
+#include "Stats.h"
+#include "Transaction.h"
+#include "Wal.h"
+#include <algorithm>
 #include <cstring>
+#include <utility>
 
 using std::exception;
 using std::string;
 
-Page::Page() : data(new char[PAGE_SIZE]), isModified(true) {
-  memset(this->data, 0, PAGE_SIZE);
+Page::Page() : data(new char[Disc::pageSize]), isModified(true) {
+  memset(this->data, 0, Disc::pageSize);
 }
 
-Page::Page(string fileName, uint_t pageAddr)
-    : data(Disc::readPage(fileName, pageAddr)),
+Page::Page(string fileName, uint_t pageAddr, Latch latch)
+    : data(nullptr),
+      isModified(false),
+      latch(latch),
       locAddr(pageAddr),
-      fileName(fileName),
-      isModified(false) {}
+      fileName(std::move(fileName)) {
+  Stats::add(Stats::PAGE_ACCESSES);
+
+  if (auto transaction = Transaction::active()) {
+    data = transaction->find(this->fileName, locAddr);
+
+    if (data) {
+      frame = KEPT;
+      return;
+    }
+
+    // The copy is changed instead of the page, which the other threads go on
+    // reading
+    if (latch == LATCH_EXCLUSIVE) {
+      Page original(this->fileName, locAddr);
+
+      if (original) {
+        data = new char[Disc::pageSize];
+        memcpy(data, original.image(), Disc::pageSize);
+        copiedLsn = original.lsn();
+      }
+
+      return;
+    }
+  }
+
+  const bool mapped = Disc::backend == Disc::BACKEND_MMAP;
+
+  // With the mmap backend, a writer changes the page in the buffer pool,
+  // which keeps it until it is committed (see BufferPool), so a reader reads
+  // the frame of the page if there is one, and the mapping otherwise. The
+  // latch is taken first, so that no writer brings the page into the pool
+  // meanwhile.
+  if (mapped && latch != LATCH_NONE) {
+    LockManager::latch(this->fileName, locAddr, latch == LATCH_EXCLUSIVE);
+  }
+
+  if (!mapped || latch == LATCH_EXCLUSIVE) {
+    frame = BufferPool::pin(this->fileName, locAddr);
+  } else if ((frame = BufferPool::pinCached(this->fileName, locAddr)) < 0) {
+    frame = MAPPED;
+  }
+
+  if (frame == MAPPED) {
+    data = Disc::mappedPage(this->fileName, locAddr);
+  } else if (frame >= 0) {
+    data = BufferPool::frameData(frame);
+  }
+
+  if (!data) {
+    if (mapped && latch != LATCH_NONE) {
+      LockManager::unlatch(this->fileName, locAddr);
+    }
+
+    this->latch = LATCH_NONE;
+  } else if (!mapped && latch != LATCH_NONE) {
+    lock(latch == LATCH_EXCLUSIVE);
+  }
+}
 
 bool Page::isUsed() {
   return *(reinterpret_cast<const uint_t *>(whole()) +
@@ -34,29 +100,67 @@ uint_t Page::globAddr() {
            PAGE_HEADER_GLOB_ADDR_INDEX);
 }
 
+uint_t Page::lsn() { return lsnOf(whole()); }
+
+uint_t Page::globAddrOf(const char *image) {
+  return *(reinterpret_cast<const uint_t *>(image) +
+           PAGE_HEADER_GLOB_ADDR_INDEX);
+}
+
+uint_t Page::categoryOf(const char *image) {
+  return *(reinterpret_cast<const uint_t *>(image) +
+           PAGE_HEADER_PAGE_CAT_INDEX);
+}
+
+bool Page::isUsedOf(const char *image) {
+  return *(reinterpret_cast<const uint_t *>(image) + PAGE_HEADER_IS_USED_INDEX);
+}
+
+const uint_t *Page::slotBitmapOf(const char *image) {
+  return reinterpret_cast<const uint_t *>(image) +
+         PAGE_HEADER_SLOT_BITMAP_INDEX;
+}
+
+uint_t Page::liveCountOf(const char *image) {
+  return *(reinterpret_cast<const uint_t *>(image) +
+           PAGE_HEADER_LIVE_COUNT_INDEX);
+}
+
+const char *Page::contentOf(const char *image) {
+  return image + headerSize();
+}
+
+uint_t Page::lsnOf(const char *image) {
+  return *(reinterpret_cast<const uint_t *>(image) + PAGE_HEADER_LSN_INDEX);
+}
+
+void Page::setLsnOf(char *image, uint_t lsn) {
+  *(reinterpret_cast<uint_t *>(image) + PAGE_HEADER_LSN_INDEX) = lsn;
+}
+
 void Page::setIsUsed(bool isUsed) {
-  isModified = true;
-  *(reinterpret_cast<uint_t *>(whole()) + PAGE_HEADER_IS_USED_INDEX) = isUsed;
+  *(reinterpret_cast<uint_t *>(writable()) + PAGE_HEADER_IS_USED_INDEX) =
+      isUsed;
 }
 
 void Page::setPageCategory(uint_t pageCategory) {
-  isModified = true;
-  *(reinterpret_cast<uint_t *>(whole()) + PAGE_HEADER_PAGE_CAT_INDEX) =
+  *(reinterpret_cast<uint_t *>(writable()) + PAGE_HEADER_PAGE_CAT_INDEX) =
       pageCategory;
 }
 
 void Page::setGlobAddr(uint_t globAddr) {
-  isModified = true;
-  *(reinterpret_cast<uint_t *>(whole()) + PAGE_HEADER_GLOB_ADDR_INDEX) =
+  *(reinterpret_cast<uint_t *>(writable()) + PAGE_HEADER_GLOB_ADDR_INDEX) =
       globAddr;
 }
 
 char *Page::contentAddr() {
-  return whole() + sizeof(uint_t) * PAGE_HEADER_ELEM_COUNT;
+  return whole() + headerSize();
 }
 
 const char *Page::content() { return contentAddr(); }
 
+const char *Page::image() { return whole(); }
+
 char *Page::whole() {
   if (!(*this)) {
     throw exception();
@@ -65,23 +169,89 @@ char *Page::whole() {
   return data;
 }
 
+char *Page::writable() {
+  if (frame == MAPPED && !copied) {
+    auto copy = new char[Disc::pageSize];
+
+    memcpy(copy, whole(), Disc::pageSize);
+    data = copy;
+    copied = true;
+  }
+
+  isModified = true;
+  return whole();
+}
+
 uint_t Page::getUIntAtPos(uint_t pos) {
   return *reinterpret_cast<const uint_t *>(contentAddr() + pos);
 }
 
-bool Page::writeContent(const char *const data, uint_t len, uint_t pos) {
-  if (len > PAGE_SIZE - PAGE_HEADER_ELEM_COUNT - pos) return false;
+bool Page::restore(const char *image) {
+  if (!(*this) || latch != LATCH_EXCLUSIVE) return false;
 
-  isModified = true;
+  memcpy(data, image, Disc::pageSize);
+
+  if (frame >= 0) {
+    BufferPool::markDirty(frame);
+  } else if (!BufferPool::writePage(fileName, locAddr, data)) {
+    return false;
+  }
+
+  return true;
+}
+
+bool Page::writeContent(const char *const data, uint_t len, uint_t pos) {
+  if (pos > contentSize() || len > contentSize() - pos) return false;
 
-  memcpy(contentAddr() + pos, data, len);
+  memcpy(writable() + headerSize() + pos, data, len);
 
   return true;
 }
 
-Page::~Page() { delete[] data; }
+Page::~Page() {
+  if (latch != LATCH_NONE) unlock();
+
+  if (frame >= 0) {
+    BufferPool::unpin(frame, isModified);
+  } else if (frame == MAPPED) {
+    if (copied) delete[] data;
+  } else if (frame == KEPT) {
+    // The copy belongs to the transaction
+  } else {
+    delete[] data;
+  }
+}
+
+void Page::lock(bool exclusive) {
+  if (Disc::backend == Disc::BACKEND_MMAP && (frame >= 0 || frame == MAPPED)) {
+    LockManager::latch(fileName, locAddr, exclusive);
+  } else if (frame >= 0) {
+    BufferPool::latch(frame, exclusive);
+  }
+}
+
+void Page::unlock() {
+  if (Disc::backend == Disc::BACKEND_MMAP && (frame >= 0 || frame == MAPPED)) {
+    LockManager::unlatch(fileName, locAddr);
+  } else if (frame >= 0) {
+    BufferPool::unlatch(frame);
+  }
+}
 
 bool Page::persist(string fileName, uint_t locAddr) {
+  // Whether the page is written to the place it was read from
+  bool inPlace = (fileName.empty() || fileName == this->fileName) &&
+                 (locAddr == 0 || locAddr == this->locAddr);
+
+  // Other threads may be reading a page which is latched shared, and a copy
+  // of a mapped page is only ever read from the mapping
+  if (isModified && (latch == LATCH_SHARED || copied)) return false;
+
+  if (!inPlace && latch != LATCH_NONE) {
+    unlock();
+    latch = LATCH_NONE;
+  }
+
   if (fileName.empty()) {
     fileName = this->fileName;
   } else {
@@ -98,8 +268,30 @@ bool Page::persist(string fileName, uint_t locAddr) {
     return false;
   }
 
-  if (isModified) {
-    return Disc::writePage(fileName, locAddr, whole());
+  if (isModified && Transaction::active()) {
+    // Logged when the transaction commits
+    auto kept = Transaction::active()->keep(fileName, locAddr, whole(),
+                                            copiedLsn);
+
+    if (frame == OWN_BUFFER) {
+      delete[] data;
+      data = kept;
+      frame = KEPT;
+    }
+
+    isModified = false;
+  } else if (isModified) {
+    bool logged = Wal::isOpen();
+
+    if (logged && !Wal::appendPage(fileName, locAddr, whole())) return false;
+
+    if (logged && frame >= 0 && inPlace) {
+      BufferPool::markDirty(frame);
+    } else if (!BufferPool::writePage(fileName, locAddr, whole())) {
+      return false;
+    }
+
+    isModified = false;
   }
 
   return true;
@@ -114,10 +306,10 @@ Page *Page::getConsecPage(bool forceGet) {
         return nullptr;
       }
 
-      consecPage = new Page(fileName, locAddr + 1);
+      consecPage = new Page(fileName, locAddr + 1, latch);
     }
   } else {
-    consecPage = new Page(fileName, locAddr + 1);
+    consecPage = new Page(fileName, locAddr + 1, latch);
   }
 
   if (!consecPage || !(*consecPage)) {
@@ -136,23 +328,54 @@ int Page::firstEmptyCellIndex(size_t cellSize) {
     return 0;
   }
 
-  for (int i = 0; i < CONTENT_SIZE / cellSize; ++i) {
-    if (getUIntAtPos(cellSize * i) == 0) {
-      return i;
+  const auto capacity = cellCapacity(cellSize);
+
+  if (liveCount() >= capacity) return -1;
+
+  auto bitmap = slotBitmapOf(whole());
+
+  for (uint_t w = 0; w * 64 < capacity; ++w) {
+    if (~bitmap[w]) {
+      size_t index = w * 64 + __builtin_ctzll(~bitmap[w]);
+      return index < capacity ? int(index) : -1;
     }
   }
 
   return -1;  // No empty cell in this page
 }
 
+size_t Page::cellCapacity(size_t cellSize) {
+  return std::min<size_t>(contentSize() / cellSize, maxSlotCount());
+}
+
+bool Page::isCellUsed(size_t cellIndex) {
+  return (slotBitmapOf(whole())[cellIndex / 64] >> (cellIndex % 64)) & 1;
+}
+
+void Page::setCellUsed(size_t cellIndex, bool used) {
+  if (isCellUsed(cellIndex) == used) return;
+
+  auto header = reinterpret_cast<uint_t *>(writable());
+  header[PAGE_HEADER_SLOT_BITMAP_INDEX + cellIndex / 64] ^=
+      uint_t(1) << (cellIndex % 64);
+
+  if (used) {
+    ++header[PAGE_HEADER_LIVE_COUNT_INDEX];
+  } else {
+    --header[PAGE_HEADER_LIVE_COUNT_INDEX];
+  }
+}
+
+uint_t Page::liveCount() { return liveCountOf(whole()); }
+
 void Page::reset() {
   auto glob = globAddr();
-  memset(whole(), 0, PAGE_SIZE);
+  memset(writable(), 0, Disc::pageSize);
   setGlobAddr(glob);
 }
 
 void Page::resetRange(size_t pos, size_t len) {
-  memset((void *)(contentAddr() + pos), 0, len);
+  memset((void *)(writable() + headerSize() + pos), 0, len);
 }
 
 Page::operator bool() const { return data; }
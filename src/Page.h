@@ -6,29 +6,48 @@
 #define STGMGR_PAGE_H
 
 #include <string>
+#include "Disc.h"
 #include "constants.h"
 
 class Page final {
  public:
+  /**
+   * How a page on the disc is latched while its Page object exists. See
+   * LockManager.
+   */
+  enum Latch { LATCH_NONE, LATCH_SHARED, LATCH_EXCLUSIVE };
+
   /**
    * Constructs an empty page which does not correspond to a page on the disc.
    */
   Page();
 
   /**
-   * Constructs a page from the disc.
+   * Constructs a page from the disc. The page is served from (and pinned in)
+   * the buffer pool until the object is destroyed. With the mmap backend of
+   * Disc, a page which is not latched exclusively is a view into the mapping
+   * of the file instead, unless it is in the buffer pool; it is copied once
+   * it is changed, so the mapping only ever gets the pages written back by
+   * the buffer pool. While a transaction is open, the page is served from its
+   * copy if the transaction keeps one, and a page latched exclusively is
+   * copied (see Transaction).
    *
    * @param fileName The file name of the file in which the requested page
    * resides
    * @param pageAddr Teh local page address of the requested page
+   * @param latch How the page is latched. A page which is modified must be
+   * latched exclusively.
    */
-  Page(std::string fileName, uint_t pageAddr);
+  Page(std::string fileName, uint_t pageAddr, Latch latch = LATCH_SHARED);
 
   /**
    * The destructor.
    */
   ~Page();
 
+  Page(const Page&) = delete;
+  Page& operator=(const Page&) = delete;
+
   /**
    * Gives "Is Used" field of the page header.
    *
@@ -69,12 +88,102 @@ class Page final {
    */
   uint_t globAddr();
 
+  /**
+   * Gives the log sequence number of the last change to the page which was
+   * written to the write-ahead log (0 if there is none).
+   *
+   * @return The LSN of the page
+   */
+  uint_t lsn();
+
+  /**
+   * Gives the global address stored in the header of a page image.
+   *
+   * @param image The whole page, including the header
+   * @return The global address of the page
+   */
+  static uint_t globAddrOf(const char* image);
+
+  /**
+   * Gives the "Page Category" field stored in the header of a page image.
+   *
+   * @param image The whole page, including the header
+   * @return The category of the page
+   */
+  static uint_t categoryOf(const char* image);
+
+  /**
+   * Gives the "Is Used" field stored in the header of a page image.
+   *
+   * @param image The whole page, including the header
+   * @return Whether the page has meaningful, not-deleted data or not
+   */
+  static bool isUsedOf(const char* image);
+
+  /**
+   * Gives the occupancy bitmap stored in the header of a page image. Bit i of
+   * word i / 64 is set if and only if the cell (slot) i is used.
+   *
+   * @param image The whole page, including the header
+   * @return The words of the bitmap
+   */
+  static const uint_t* slotBitmapOf(const char* image);
+
+  /**
+   * Gives the number of the used cells stored in the header of a page image.
+   *
+   * @param image The whole page, including the header
+   * @return The number of the set bits of the occupancy bitmap
+   */
+  static uint_t liveCountOf(const char* image);
+
+  /**
+   * Gives the content of a page image.
+   *
+   * @param image The whole page, including the header
+   * @return The pointer to the start of the content
+   */
+  static const char* contentOf(const char* image);
+
+  /**
+   * Gives the LSN stored in the header of a page image.
+   *
+   * @param image The whole page, including the header
+   * @return The LSN of the page
+   */
+  static uint_t lsnOf(const char* image);
+
+  /**
+   * Sets the LSN stored in the header of a page image.
+   *
+   * @param image The whole page, including the header
+   * @param lsn The LSN of the page
+   */
+  static void setLsnOf(char* image, uint_t lsn);
+
+  /**
+   * Overwrites the whole page with an image which is already in the log,
+   * stamped with its LSN, e.g. by Transaction::log().
+   * Unlike persist(), nothing is logged. The page should be latched
+   * exclusively.
+   *
+   * @param image The page image
+   * @return Success/failure
+   */
+  bool restore(const char* image);
+
   /**
    * Gives the pointer to the start of the page content
    * @return The pointer to the start of the page content
    */
   const char* content();
 
+  /**
+   * Gives the pointer to the start of the whole page, including the header
+   * @return The pointer to the first byte of the page
+   */
+  const char* image();
+
   /**
    * Writes bytes to the content of the page.
    *
@@ -86,16 +195,31 @@ class Page final {
   bool writeContent(const char* const data, uint_t len, uint_t pos = 0);
 
   /**
-   * The number of elements in the page header. All of them are 8-byte integers.
+   * Gives the largest number of cells of a page, which is the number of the
+   * bits of the occupancy bitmap. There is a bit for each 8 bytes of the
+   * page, since no cell is smaller.
+   *
+   * @param pageSize The page size
+   */
+  static uint_t maxSlotCount(uint_t pageSize = Disc::pageSize) {
+    return pageSize / sizeof(uint_t);
+  }
+
+  /**
+   * Gives the size of the page header, which has 8-byte integer fields
+   * followed by the occupancy bitmap.
+   *
+   * @param pageSize The page size
    */
-  static const uint_t PAGE_HEADER_ELEM_COUNT = 3;
+  static uint_t headerSize(uint_t pageSize = Disc::pageSize) {
+    return PAGE_HEADER_FIXED_SIZE + maxSlotCount(pageSize) / 8;
+  }
 
   /**
-   * The size left to actual content of a page. It is simply the size of the
-   * page minus the size of the page header.
+   * Gives the size left to actual content of a page. It is simply the size of
+   * the page minus the size of the page header.
    */
-  static const uint_t CONTENT_SIZE =
-      PAGE_SIZE - PAGE_HEADER_ELEM_COUNT * sizeof(uint_t);
+  static uint_t contentSize() { return Disc::pageSize - headerSize(); }
 
   /**
    * Gives the 8-byte unsigned integer which starts at the given byte position.
@@ -121,6 +245,10 @@ class Page final {
    * Writes the page to the disk (only if the page did not exist in the disc
    * before or has been updated after being read from the disk).
    *
+   * If the write-ahead log is open, the page is appended to the log, and the
+   * page itself is written back later by the buffer pool. While a transaction
+   * is open, the page is kept by the transaction instead.
+   *
    * If you do not supply fileName and locAddr, the page will be written to its
    * current file and local address. Note that this is only possible for the
    * Page objects constructed from a physical page (i.e., constructed with a
@@ -128,12 +256,14 @@ class Page final {
    *
    * @param fileName File name of the file in which this page is to be written
    * @param locAddr Local address of the page
-   * @return Success/failure
+   * @return Success/failure. A modified page which is latched shared, or
+   * which is a copy of a mapped page, is never written.
    */
   bool persist(std::string fileName = "", uint_t locAddr = 0);
 
   /**
-   * Gets (or creates) the consecutive page in the file.
+   * Gets (or creates) the consecutive page in the file, latched as this page
+   * is.
    *
    * @param forceGet
    * @return If an error occurs or there is no consecutive page (this is only if
@@ -144,11 +274,14 @@ class Page final {
   Page* getConsecPage(bool forceGet = false);
 
   /**
-   * Finds the first empty cell in the page.
+   * Finds the first empty cell in the page. A page which is not used is reset
+   * first.
    *
    * A "cell" is a user-define logical unit in a page. This class is not
    * interested in how you store your content in a page, hence the size of a
-   * cell is required for looping over the cells.
+   * cell is required for knowing the number of the cells. Whether a cell is
+   * used is kept in the occupancy bitmap of the page header (see
+   * setCellUsed()).
    *
    * @param cellSize Size of one cell
    * @return The index of the first empty cell in the page, or -1 if all cells
@@ -156,6 +289,35 @@ class Page final {
    */
   int firstEmptyCellIndex(size_t cellSize);
 
+  /**
+   * Gives the number of the cells of the given size in a page.
+   *
+   * @param cellSize Size of one cell
+   * @return The number of the cells
+   */
+  static size_t cellCapacity(size_t cellSize);
+
+  /**
+   * Checks whether a cell is used, according to the occupancy bitmap.
+   *
+   * @param cellIndex The index of the cell
+   */
+  bool isCellUsed(size_t cellIndex);
+
+  /**
+   * Marks a cell as used or empty in the occupancy bitmap, keeping the live
+   * count in sync.
+   *
+   * @param cellIndex The index of the cell
+   * @param used Whether the cell is used
+   */
+  void setCellUsed(size_t cellIndex, bool used);
+
+  /**
+   * Gives the number of the used cells.
+   */
+  uint_t liveCount();
+
   /**
    * Nullifies the whole page, including the header; preserving only the global
    * page address header field.
@@ -185,15 +347,69 @@ class Page final {
   void setGlobAddr(uint_t);
 
   char* whole();
-  char* const data;
+
+  /**
+   * Gives the page for a change, and marks it as modified. A mapped page is
+   * copied first, since the mapping is the file itself (see the
+   * constructor).
+   *
+   * @return The pointer to the first byte of the page
+   */
+  char* writable();
+
+  char* data;
+
+  /**
+   * The buffer pool frame holding the page, or one of the special values
+   * below.
+   */
+  int frame = OWN_BUFFER;
+
+  /**
+   * The page has its own buffer (i.e., it was not constructed from a
+   * physical page)
+   */
+  static const int OWN_BUFFER = -1;
+
+  /**
+   * The page is a view into the mapping of its file, or a copy of it if it
+   * has been changed (see writable())
+   */
+  static const int MAPPED = -2;
+
+  /**
+   * The page is a copy kept by the current transaction
+   */
+  static const int KEPT = -3;
 
   static const uint_t PAGE_HEADER_IS_USED_INDEX = 0;
   static const uint_t PAGE_HEADER_PAGE_CAT_INDEX = 1;
   static const uint_t PAGE_HEADER_GLOB_ADDR_INDEX = 2;
+  static const uint_t PAGE_HEADER_LSN_INDEX = 3;
+  static const uint_t PAGE_HEADER_LIVE_COUNT_INDEX = 4;
+  static const uint_t PAGE_HEADER_SLOT_BITMAP_INDEX = 5;
+  static const uint_t PAGE_HEADER_FIXED_SIZE =
+      PAGE_HEADER_SLOT_BITMAP_INDEX * sizeof(uint_t);
 
   char* contentAddr();
 
+  /**
+   * Takes the latch of the page: that of its frame if it is in the buffer
+   * pool, or with the mmap backend the one kept by LockManager. The copies
+   * kept by the transactions have no latches.
+   */
+  void lock(bool exclusive);
+
+  void unlock();
+
   bool isModified;
+  bool copied = false;  // Whether a mapped page has been copied
+  Latch latch = LATCH_NONE;
+
+  /**
+   * The LSN of the page when it was copied for the current transaction
+   */
+  uint_t copiedLsn = 0;
 
   uint_t locAddr = 0;
   std::string fileName;
@@ -0,0 +1,204 @@
+//
+// Created by Alper Çakan on 9.04.2018.
+//
+
+#include "PageAllocator.h"
+#include "Disc.h"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+using std::lock_guard;
+using std::map;
+using std::pair;
+using std::vector;
+
+std::mutex PageAllocator::mutex;
+map<uint_t, uint_t> PageAllocator::extents;
+bool PageAllocator::modified = false;
+
+void PageAllocator::take(map<uint_t, uint_t>::iterator extent, uint_t count,
+                         uint_t *addrs) {
+  auto first = extent->first, length = extent->second;
+  extents.erase(extent);
+
+  for (uint_t i = 0; i < count; ++i) {
+    addrs[i] = first + i;
+  }
+
+  if (length > count) extents[first + count] = length - count;
+
+  modified = true;
+}
+
+bool PageAllocator::allocate(uint_t count, uint_t *addrs) {
+  if (count == 0) return true;
+
+  lock_guard<std::mutex> guard(mutex);
+
+  for (auto it = extents.begin(); it != extents.end(); ++it) {
+    if (it->second >= count) {
+      take(it, count, addrs);
+      return true;
+    }
+  }
+
+  // The addresses which may still be taken after Disc::newPageAddr
+  uint_t fresh = 0;
+
+  if (!Disc::maxPageCount) {
+    fresh = count;
+  } else if (Disc::maxPageCount > Disc::newPageAddr) {
+    fresh = std::min(count, Disc::maxPageCount - Disc::newPageAddr);
+  }
+
+  if (fresh < count && countFree() < count - fresh) return false;
+
+  // Take the extents in order, and the rest after Disc::newPageAddr
+  uint_t taken = 0;
+
+  while (count - taken > fresh) {
+    auto length = std::min(extents.begin()->second, count - taken - fresh);
+    take(extents.begin(), length, addrs + taken);
+    taken += length;
+  }
+
+  for (; taken < count; ++taken) {
+    addrs[taken] = Disc::newPageAddr++;
+  }
+
+  return true;
+}
+
+void PageAllocator::release(uint_t first, uint_t count) {
+  lock_guard<std::mutex> guard(mutex);
+
+  insertExtent(first, count);
+}
+
+void PageAllocator::insertExtent(uint_t first, uint_t count) {
+  if (count == 0) return;
+
+  modified = true;
+
+  auto next = extents.find(first + count);
+
+  if (next != extents.end()) {
+    count += next->second;
+    extents.erase(next);
+  }
+
+  auto it = extents.lower_bound(first);
+
+  if (it != extents.begin()) {
+    auto prev = std::prev(it);
+
+    if (prev->first + prev->second == first) {
+      first = prev->first;
+      count += prev->second;
+      extents.erase(prev);
+    }
+  }
+
+  if (first + count == Disc::newPageAddr) {
+    Disc::newPageAddr = first;
+  } else {
+    extents[first] = count;
+  }
+}
+
+void PageAllocator::reserve(uint_t addr) {
+  lock_guard<std::mutex> guard(mutex);
+
+  if (addr >= Disc::newPageAddr) {
+    auto first = Disc::newPageAddr;
+    Disc::newPageAddr = addr + 1;
+    insertExtent(first, addr - first);
+    return;
+  }
+
+  auto it = extents.upper_bound(addr);
+
+  if (it == extents.begin()) return;
+
+  --it;
+
+  auto first = it->first, length = it->second;
+
+  if (addr >= first + length) return;
+
+  extents.erase(it);
+
+  if (addr > first) extents[first] = addr - first;
+
+  if (first + length > addr + 1) extents[addr + 1] = first + length - addr - 1;
+
+  modified = true;
+}
+
+bool PageAllocator::isFree(uint_t addr) {
+  lock_guard<std::mutex> guard(mutex);
+
+  if (addr >= Disc::newPageAddr) return true;
+
+  auto it = extents.upper_bound(addr);
+
+  return it != extents.begin() && addr < std::prev(it)->first +
+                                             std::prev(it)->second;
+}
+
+uint_t PageAllocator::freeCount() {
+  lock_guard<std::mutex> guard(mutex);
+
+  return countFree();
+}
+
+uint_t PageAllocator::countFree() {
+  uint_t count = 0;
+
+  for (const auto &extent : extents) {
+    count += extent.second;
+  }
+
+  return count;
+}
+
+void PageAllocator::clear() {
+  lock_guard<std::mutex> guard(mutex);
+  extents.clear();
+  Disc::newPageAddr = 1;
+  modified = true;
+}
+
+void PageAllocator::load(const uint_t *words, uint_t count) {
+  extents.clear();
+
+  for (uint_t i = 0; i < count; ++i) {
+    extents[words[2 * i]] = words[2 * i + 1];
+  }
+
+  modified = false;
+}
+
+uint_t PageAllocator::save(uint_t *words, uint_t maxCount) {
+  vector<pair<uint_t, uint_t>> stored(extents.begin(), extents.end());
+
+  if (stored.size() > maxCount) {
+    std::partial_sort(stored.begin(), stored.begin() + maxCount, stored.end(),
+                      [](const pair<uint_t, uint_t> &a,
+                         const pair<uint_t, uint_t> &b) {
+                        return a.second > b.second;
+                      });
+    stored.resize(maxCount);
+  }
+
+  for (size_t i = 0; i < stored.size(); ++i) {
+    words[2 * i] = stored[i].first;
+    words[2 * i + 1] = stored[i].second;
+  }
+
+  modified = false;
+  return stored.size();
+}
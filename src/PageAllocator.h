@@ -0,0 +1,128 @@
+//
+// Created by Alper Çakan on 9.04.2018.
+//
+
+#ifndef STGMGR_PAGEALLOCATOR_H
+#define STGMGR_PAGEALLOCATOR_H
+
+#include <map>
+#include <mutex>
+#include "constants.h"
+
+/**
+ * The allocator of the global addresses of the pages.
+ *
+ * The addresses below Disc::newPageAddr which are not used by any page are
+ * kept as free extents, i.e. ranges of consecutive addresses, which are
+ * merged with their neighbours when they are freed. An extent which reaches
+ * Disc::newPageAddr is given back to it. New pages take their addresses from
+ * the extents first, so that the capacity of the database (see
+ * Disc::maxPageCount) limits the pages which exist, not the pages which were
+ * ever appended.
+ *
+ * The extents are stored in the general system catalogue together with
+ * Disc::newPageAddr, by ::persistGlobPageAddr().
+ *
+ * The addresses may be allocated and released by several threads at once:
+ * the extents and Disc::newPageAddr are guarded by a mutex, so each call is
+ * atomic. load(), save() and modified are used only while no thread
+ * allocates (see ::commit()).
+ */
+class PageAllocator {
+ public:
+  /**
+   * Allocates the addresses of new pages. The first extent which can hold
+   * all of them is taken from; if there is none, the addresses after
+   * Disc::newPageAddr are taken if the capacity allows, and the extents are
+   * taken in order otherwise.
+   *
+   * @param count The number of addresses
+   * @param addrs The array to store the addresses in, in ascending order
+   * @return Success/failure. On failure, the capacity of the database is
+   * reached and nothing is allocated.
+   */
+  static bool allocate(uint_t count, uint_t *addrs);
+
+  /**
+   * Frees the addresses of pages which no longer exist.
+   *
+   * @param first The first address of the range
+   * @param count The number of addresses in the range
+   */
+  static void release(uint_t first, uint_t count = 1);
+
+  /**
+   * Marks an address as used by a page which was found during recovery. If
+   * it is beyond Disc::newPageAddr, the addresses before it are freed.
+   *
+   * @param addr The address
+   */
+  static void reserve(uint_t addr);
+
+  /**
+   * Whether an address is free, i.e. in an extent or beyond
+   * Disc::newPageAddr.
+   */
+  static bool isFree(uint_t addr);
+
+  /**
+   * Gives the number of the free addresses below Disc::newPageAddr.
+   */
+  static uint_t freeCount();
+
+  /**
+   * Frees all the addresses, i.e. sets Disc::newPageAddr back to 1.
+   */
+  static void clear();
+
+  /**
+   * Replaces the extents with the stored ones.
+   *
+   * @param words The pairs (First Address, Address Count), one after another
+   * @param count The number of the extents
+   */
+  static void load(const uint_t *words, uint_t count);
+
+  /**
+   * Stores the extents. If there are more than the given number of them, only
+   * the largest ones are stored, and the addresses of the rest are lost once
+   * the database is closed.
+   *
+   * @param words The array to store the pairs (First Address, Address Count)
+   * in, one after another
+   * @param maxCount The largest number of extents to be stored
+   * @return The number of the stored extents
+   */
+  static uint_t save(uint_t *words, uint_t maxCount);
+
+  /**
+   * Whether the extents have changed since they were last loaded or stored
+   */
+  static bool modified;
+
+ private:
+  /**
+   * Takes addresses from the extent which starts at the given address.
+   */
+  static void take(std::map<uint_t, uint_t>::iterator extent, uint_t count,
+                   uint_t *addrs);
+
+  /**
+   * Like release(), for a caller which holds the mutex.
+   */
+  static void insertExtent(uint_t first, uint_t count);
+
+  /**
+   * Like freeCount(), for a caller which holds the mutex.
+   */
+  static uint_t countFree();
+
+  static std::mutex mutex;
+
+  /**
+   * The extents, as (First Address -> Address Count)
+   */
+  static std::map<uint_t, uint_t> extents;
+};
+
+#endif  // STGMGR_PAGEALLOCATOR_H
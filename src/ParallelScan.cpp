@@ -0,0 +1,238 @@
+//
+// Created by Alper Çakan on 9.04.2018.
+//
+
+#include "ParallelScan.h"
+#include "BufferPool.h"
+#include "Disc.h"
+#include "Page.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+using std::string;
+using std::vector;
+
+bool ParallelScan::run(const string &fileName, const size_t fieldCount,
+                       const DataLayout::Format format, uint_t threadCount,
+                       const bool ordered, const bool firstOnly,
+                       const Filter *filter, const MatchCallback &onMatch) {
+  // The file is read directly, so its changes which are only in the buffer
+  // pool must reach it first
+  auto pageCount = Disc::getPageCount(fileName);
+
+  if (pageCount == 0 || !BufferPool::flushFile(fileName)) return false;
+
+  const uint_t chunkCount =
+      (pageCount + PARALLEL_SCAN_CHUNK_PAGES - 1) / PARALLEL_SCAN_CHUNK_PAGES;
+  threadCount = std::max<uint_t>(1, std::min(threadCount, chunkCount));
+
+  // The matches of a chunk, with the fields of all of them in one vector
+  struct Part {
+    vector<sint_t> fields;
+    vector<std::pair<uint_t, uint_t>> pages;
+  };
+
+  // If the order matters, the finished chunks wait here until all the chunks
+  // before them are given; the threads stay at most a window of chunks ahead
+  const bool inOrder = ordered || firstOnly;
+  const uint_t window = PARALLEL_SCAN_WINDOW * threadCount;
+  vector<Part> parts(inOrder ? window : 0);
+  vector<bool> finished(inOrder ? window : 0);
+  uint_t given = 0;  // The number of chunks given so far, in order
+
+  std::mutex mutex;
+  std::condition_variable progressed;
+  std::atomic<uint_t> nextChunk(0), firstMatchChunk(chunkCount);
+  std::atomic<bool> failed(false), stopped(false);
+
+  auto give = [&](const Part &part) {
+    for (size_t i = 0; i < part.pages.size() && !stopped; ++i) {
+      onMatch(Record(part.fields.data() + i * fieldCount, fieldCount),
+              part.pages[i].first, part.pages[i].second);
+
+      if (firstOnly) stopped = true;
+    }
+  };
+
+  auto worker = [&]() {
+    vector<char> buffer(size_t(PARALLEL_SCAN_CHUNK_PAGES) * Disc::pageSize);
+    vector<size_t> slots;
+    Part part;
+
+    while (!failed && !stopped) {
+      uint_t chunk = nextChunk++;
+
+      // Chunks are taken in increasing order, so once a chunk is past the
+      // first match, so are all the remaining ones
+      if (chunk >= chunkCount || (firstOnly && chunk > firstMatchChunk)) {
+        break;
+      }
+
+      if (inOrder) {
+        std::unique_lock<std::mutex> lock(mutex);
+        progressed.wait(lock, [&] {
+          return chunk < given + window || failed || stopped;
+        });
+
+        if (failed || stopped) break;
+      }
+
+      uint_t first = chunk * PARALLEL_SCAN_CHUNK_PAGES + 1;
+      uint_t count = std::min<uint_t>(PARALLEL_SCAN_CHUNK_PAGES,
+                                      pageCount - first + 1);
+
+      if (!Disc::readPagesShared(fileName, first, count, buffer.data())) {
+        std::lock_guard<std::mutex> lock(mutex);
+        failed = true;
+        progressed.notify_all();
+        break;
+      }
+
+      part.fields.clear();
+      part.pages.clear();
+
+      for (uint_t p = 0; p < count; ++p) {
+        const char *image = buffer.data() + p * Disc::pageSize;
+
+        if (!Page::isUsedOf(image)) continue;
+
+        auto layout = DataLayout::ofImage(image, fieldCount, format);
+
+        slots.clear();
+
+        if (filter) {
+          layout.select(image, filter->field, filter->low, filter->high,
+                        slots);
+        } else {
+          layout.usedSlots(image, slots);
+        }
+
+        if (firstOnly && slots.size() > 1) slots.resize(1);
+
+        auto offset = part.fields.size();
+        part.fields.resize(offset + slots.size() * fieldCount);
+        layout.readSlots(image, slots, part.fields.data() + offset);
+        part.pages.insert(part.pages.end(), slots.size(),
+                          {Page::globAddrOf(image), first + p});
+
+        if (firstOnly && !part.pages.empty()) break;
+      }
+
+      if (firstOnly && !part.pages.empty()) {
+        uint_t seen = firstMatchChunk;
+
+        while (chunk < seen &&
+               !firstMatchChunk.compare_exchange_weak(seen, chunk)) {
+        }
+      }
+
+      std::lock_guard<std::mutex> lock(mutex);
+
+      if (!inOrder) {
+        give(part);
+        continue;
+      }
+
+      std::swap(parts[chunk % window], part);
+      finished[chunk % window] = true;
+
+      while (given < chunkCount && finished[given % window]) {
+        give(parts[given % window]);
+        finished[given % window] = false;
+        ++given;
+      }
+
+      progressed.notify_all();
+    }
+  };
+
+  vector<std::thread> threads;
+
+  for (uint_t t = 1; t < threadCount; ++t) {
+    threads.emplace_back(worker);
+  }
+
+  worker();
+
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  return !failed;
+}
+
+bool ParallelScan::run(const string &fileName, const size_t fieldCount,
+                       const DataLayout::Format format, uint_t threadCount,
+                       const bool ordered, const bool firstOnly,
+                       const Filter *filter, vector<Match> &res) {
+  return run(fileName, fieldCount, format, threadCount, ordered, firstOnly,
+             filter, [&res](Record fields, uint_t globAddr, uint_t locAddr) {
+               res.push_back(Match{fields.toVector(), globAddr, locAddr});
+             });
+}
+
+bool ParallelScan::forEachPage(
+    const string &fileName, uint_t threadCount,
+    const std::function<bool(uint_t, const char *, uint_t)> &onPage) {
+  auto pageCount = Disc::getPageCount(fileName);
+
+  if (pageCount == 0 || !BufferPool::flushFile(fileName)) return false;
+
+  const uint_t chunkCount =
+      (pageCount + PARALLEL_SCAN_CHUNK_PAGES - 1) / PARALLEL_SCAN_CHUNK_PAGES;
+  threadCount = std::max<uint_t>(1, std::min(threadCount, chunkCount));
+
+  std::atomic<uint_t> nextChunk(0);
+  std::atomic<bool> failed(false);
+
+  auto worker = [&](uint_t thread) {
+    vector<char> buffer(size_t(PARALLEL_SCAN_CHUNK_PAGES) * Disc::pageSize);
+
+    while (!failed) {
+      uint_t chunk = nextChunk++;
+
+      if (chunk >= chunkCount) break;
+
+      uint_t first = chunk * PARALLEL_SCAN_CHUNK_PAGES + 1;
+      uint_t count = std::min<uint_t>(PARALLEL_SCAN_CHUNK_PAGES,
+                                      pageCount - first + 1);
+
+      if (!Disc::readPagesShared(fileName, first, count, buffer.data())) {
+        failed = true;
+        break;
+      }
+
+      for (uint_t p = 0; p < count && !failed; ++p) {
+        const char *image = buffer.data() + p * Disc::pageSize;
+
+        if (Page::isUsedOf(image) && !onPage(thread, image, first + p)) {
+          failed = true;
+        }
+      }
+    }
+  };
+
+  vector<std::thread> threads;
+
+  for (uint_t t = 1; t < threadCount; ++t) {
+    threads.emplace_back(worker, t);
+  }
+
+  worker(0);
+
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  return !failed;
+}
+
+uint_t ParallelScan::defaultThreadCount() {
+  uint_t cores = std::thread::hardware_concurrency();
+
+  return std::max<uint_t>(1, std::min<uint_t>(cores, MAX_SCAN_THREADS));
+}
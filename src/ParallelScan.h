@@ -0,0 +1,111 @@
+//
+// Created by Alper Çakan on 9.04.2018.
+//
+
+#ifndef STGMGR_PARALLELSCAN_H
+#define STGMGR_PARALLELSCAN_H
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "DataLayout.h"
+#include "Record.h"
+#include "constants.h"
+
+/**
+ * A read-only scan of the data file of a type, shared among several threads.
+ *
+ * The page range of the file is split into chunks of PARALLEL_SCAN_CHUNK_PAGES
+ * pages, which the threads take one after another. Each thread reads its
+ * chunk with a single read, bypassing the buffer pool, and decodes the cells
+ * on its own. The matches of each chunk are given as soon as the chunk (and,
+ * for an ordered scan, every chunk before it) is done, so only a window of
+ * chunks is in memory at a time.
+ *
+ * Nothing else may access the disc while a scan runs.
+ */
+class ParallelScan {
+ public:
+  /**
+   * A matching record, together with the addresses of its page.
+   */
+  struct Match {
+    std::vector<sint_t> fields;
+    uint_t globAddr;
+    uint_t locAddr;
+  };
+
+  /**
+   * Matches the records whose given field is in the range [low, high].
+   */
+  struct Filter {
+    size_t field;
+    sint_t low;
+    sint_t high;
+  };
+
+  /**
+   * Called with the fields of a match and the global and local addresses of
+   * its page. The record is valid only during the call.
+   */
+  typedef std::function<void(Record, uint_t, uint_t)> MatchCallback;
+
+  /**
+   * Scans the data file of a type, giving the matches to a callback as they
+   * are found.
+   *
+   * @param fileName The name of the data file
+   * @param fieldCount The number of fields of the type
+   * @param format The format of the type
+   * @param threadCount The number of threads to scan with
+   * @param ordered If true, the matches are given in the order of the file,
+   * as a serial scan would give them. Otherwise, the order is unspecified.
+   * @param firstOnly If true, only the first match in the order of the file
+   * is given, and the scan stops as soon as it is known
+   * @param filter The filter which the records should match, or null to
+   * match all the records
+   * @param onMatch Called with each match. It may be called by any of the
+   * threads, but by one at a time.
+   * @return Success/failure
+   */
+  static bool run(const std::string &fileName, size_t fieldCount,
+                  DataLayout::Format format, uint_t threadCount, bool ordered,
+                  bool firstOnly, const Filter *filter,
+                  const MatchCallback &onMatch);
+
+  /**
+   * Scans the data file of a type, collecting the matches. See the other
+   * run() for the parameters.
+   *
+   * @param res A reference to a vector. The matches are appended to this.
+   * @return Success/failure
+   */
+  static bool run(const std::string &fileName, size_t fieldCount,
+                  DataLayout::Format format, uint_t threadCount, bool ordered,
+                  bool firstOnly, const Filter *filter,
+                  std::vector<Match> &res);
+
+  /**
+   * Gives each used page of a file to a callback, in no particular order. The
+   * pages are read in chunks as in run().
+   *
+   * @param fileName The name of the file
+   * @param threadCount The number of threads to scan with
+   * @param onPage Called with the index of the calling thread (less than
+   * threadCount), the image of a page and the local address of the page. It
+   * is called by several threads at once, but never by the same thread twice
+   * at once. Returning false stops the scan as a failure.
+   * @return Success/failure
+   */
+  static bool forEachPage(
+      const std::string &fileName, uint_t threadCount,
+      const std::function<bool(uint_t, const char *, uint_t)> &onPage);
+
+  /**
+   * Gives the number of threads to scan with by default, which is the number
+   * of the cores (at most MAX_SCAN_THREADS).
+   */
+  static uint_t defaultThreadCount();
+};
+
+#endif  // STGMGR_PARALLELSCAN_H
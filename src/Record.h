@@ -0,0 +1,59 @@
+//
+// Created by Alper Çakan on 9.04.2018.
+//
+
+#ifndef STGMGR_RECORD_H
+#define STGMGR_RECORD_H
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include "constants.h"
+
+/**
+ * The pair (Glob. Page Addr., Loc. Page Addr.) of a page. (0, 0) means no
+ * page.
+ */
+typedef std::pair<uint_t, uint_t> PageNumber;
+
+/**
+ * The field values of a record, one 64-bit signed integer per field, the
+ * first of which is the primary key.
+ *
+ * A record is only a view of the values, which it does not own; it is valid
+ * as long as the array it was made from.
+ */
+class Record {
+ public:
+  Record() : values(nullptr), count(0) {}
+
+  Record(const sint_t *values, size_t count) : values(values), count(count) {}
+
+  Record(const std::vector<sint_t> &values)
+      : values(values.data()), count(values.size()) {}
+
+  const sint_t *data() const { return values; }
+
+  size_t size() const { return count; }
+
+  bool empty() const { return count == 0; }
+
+  sint_t operator[](size_t field) const { return values[field]; }
+
+  const sint_t *begin() const { return values; }
+
+  const sint_t *end() const { return values + count; }
+
+  /**
+   * Gives a copy of the values, which outlives the record.
+   */
+  std::vector<sint_t> toVector() const {
+    return std::vector<sint_t>(begin(), end());
+  }
+
+ private:
+  const sint_t *values;
+  size_t count;
+};
+
+#endif  // STGMGR_RECORD_H
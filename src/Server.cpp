@@ -0,0 +1,405 @@
+//
+// Created by Alper Çakan on 9.04.2018.
+//
+
+#include "Server.h"
+
+#include <poll.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <utility>
+
+using std::function;
+using std::ostringstream;
+using std::string;
+using std::vector;
+
+static const char BINARY_FRAME_MARK = '\0';
+static const size_t FRAME_HEADER_SIZE = 5;  // Mark or status, and length
+
+/**
+ * Gives a 32-bit little-endian integer.
+ */
+static uint32_t readLength(const char *bytes) {
+  auto b = reinterpret_cast<const unsigned char *>(bytes);
+
+  return uint32_t(b[0]) | uint32_t(b[1]) << 8 | uint32_t(b[2]) << 16 |
+         uint32_t(b[3]) << 24;
+}
+
+/**
+ * Appends a frame header: a byte, then a 32-bit little-endian integer.
+ */
+static void appendHeader(string &dest, char first, uint32_t length) {
+  dest += first;
+
+  for (int i = 0; i < 4; ++i) {
+    dest += char(length >> (8 * i));
+  }
+}
+
+Server::Server(Database &db, Handler handler)
+    : db(db), handler(std::move(handler)) {}
+
+Server::~Server() {
+  for (auto &conn : connections) {
+    ::close(conn.first);
+  }
+
+  if (listenFd >= 0) {
+    ::close(listenFd);
+    unlink(socketPath.c_str());
+  }
+
+  if (signalFd >= 0) ::close(signalFd);
+
+  if (epollFd >= 0) ::close(epollFd);
+}
+
+bool Server::listen(const string &socketPath, string *error) {
+  auto fail = [error](const string &reason) {
+    if (error) *error = reason + ": " + strerror(errno);
+
+    return false;
+  };
+
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+
+  if (socketPath.empty() || socketPath.size() >= sizeof(addr.sun_path)) {
+    errno = ENAMETOOLONG;
+    return fail("Invalid socket path");
+  }
+
+  memcpy(addr.sun_path, socketPath.c_str(), socketPath.size());
+
+  // Only a socket is replaced, never another kind of file
+  struct stat st;
+
+  if (lstat(socketPath.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+    unlink(socketPath.c_str());
+  }
+
+  listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+  if (listenFd < 0) return fail("Could not create the socket");
+
+  if (bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+    ::close(listenFd);
+    listenFd = -1;
+    return fail("Could not bind the socket");
+  }
+
+  this->socketPath = socketPath;
+
+  if (::listen(listenFd, SOMAXCONN) != 0) return fail("Could not listen");
+
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+
+  if (sigprocmask(SIG_BLOCK, &signals, nullptr) != 0) {
+    return fail("Could not block the signals");
+  }
+
+  signalFd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+  epollFd = epoll_create1(EPOLL_CLOEXEC);
+
+  if (signalFd < 0 || epollFd < 0) return fail("Could not create epoll");
+
+  epoll_event event;
+  event.events = EPOLLIN;
+
+  for (auto fd : {listenFd, signalFd}) {
+    event.data.fd = fd;
+
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+      return fail("Could not create epoll");
+    }
+  }
+
+  return true;
+}
+
+bool Server::pending() const {
+  pollfd fd = {epollFd, POLLIN, 0};
+
+  return poll(&fd, 1, 0) > 0 && (fd.revents & POLLIN);
+}
+
+bool Server::run(const function<void()> &onIdle) {
+  epoll_event events[SERVER_MAX_EVENTS];
+  vector<int> touched;
+
+  while (!stopped) {
+    if (onIdle && ready.empty() && !pending()) onIdle();
+
+    int n = epoll_wait(epollFd, events, SERVER_MAX_EVENTS,
+                       ready.empty() ? -1 : 0);
+
+    if (n < 0) {
+      if (errno == EINTR) continue;
+
+      return false;
+    }
+
+    touched.clear();
+
+    for (auto fd : ready) {
+      auto it = connections.find(fd);
+
+      if (it == connections.end()) continue;
+
+      if (process(it->second)) {
+        touched.push_back(fd);
+      } else {
+        close(fd);
+      }
+    }
+
+    ready.clear();
+
+    for (int i = 0; i < n; ++i) {
+      auto fd = events[i].data.fd;
+
+      if (fd == listenFd) {
+        accept();
+        continue;
+      }
+
+      if (fd == signalFd) {
+        stopped = true;
+        continue;
+      }
+
+      auto it = connections.find(fd);
+
+      if (it == connections.end()) continue;
+
+      auto &conn = it->second;
+
+      // The output written here was produced before the last sync
+      bool suc = !(events[i].events & EPOLLOUT) || write(conn);
+
+      if (suc && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+        suc = read(conn);
+      }
+
+      if (!(suc && process(conn))) {
+        close(fd);
+        continue;
+      }
+
+      touched.push_back(fd);
+    }
+
+    if (touched.empty()) continue;
+
+    if (!db.sync()) std::cerr << "Could not sync the log!" << std::endl;
+
+    for (auto fd : touched) {
+      auto it = connections.find(fd);
+
+      if (it == connections.end()) continue;
+
+      auto &conn = it->second;
+
+      if (!write(conn)) {
+        close(fd);
+        continue;
+      }
+
+      if (conn.blocked && conn.out.size() < SERVER_OUTPUT_LIMIT) {
+        ready.push_back(fd);
+      }
+
+      update(conn);
+    }
+  }
+
+  return true;
+}
+
+void Server::accept() {
+  while (true) {
+    int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+    if (fd < 0) return;  // No more clients, or they can not be accepted now
+
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+      ::close(fd);
+      continue;
+    }
+
+    std::unique_ptr<Transaction> transaction(new Transaction());
+
+    connections[fd] = {fd,      "", "", false, false, false,
+                       EPOLLIN, std::move(transaction)};
+  }
+}
+
+bool Server::read(Connection &conn) {
+  char buffer[65536];
+
+  while (!conn.eof) {
+    auto n = recv(conn.fd, buffer, sizeof(buffer), 0);
+
+    if (n > 0) {
+      conn.in.append(buffer, n);
+    } else if (n == 0) {
+      conn.eof = true;
+    } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      return true;
+    } else if (errno != EINTR) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool Server::write(Connection &conn) {
+  size_t pos = 0;
+
+  while (pos < conn.out.size()) {
+    auto n = send(conn.fd, conn.out.data() + pos, conn.out.size() - pos,
+                  MSG_NOSIGNAL);
+
+    if (n >= 0) {
+      pos += n;
+    } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      break;
+    } else if (errno != EINTR) {
+      return false;
+    }
+  }
+
+  conn.out.erase(0, pos);
+  return true;
+}
+
+bool Server::process(Connection &conn) {
+  size_t pos = 0;
+  Transaction::Scope scope(conn.transaction.get());
+
+  conn.blocked = false;
+
+  while (!conn.closing && pos < conn.in.size()) {
+    if (conn.out.size() >= SERVER_OUTPUT_LIMIT) {
+      conn.blocked = true;
+      break;
+    }
+
+    bool binary = conn.in[pos] == BINARY_FRAME_MARK;
+    string command;
+
+    if (binary) {
+      if (conn.in.size() - pos < FRAME_HEADER_SIZE) break;
+
+      auto length = readLength(conn.in.data() + pos + 1);
+
+      if (length > SERVER_MAX_COMMAND_SIZE) return false;
+
+      if (conn.in.size() - pos - FRAME_HEADER_SIZE < length) break;
+
+      command = conn.in.substr(pos + FRAME_HEADER_SIZE, length);
+      pos += FRAME_HEADER_SIZE + length;
+    } else {
+      auto end = conn.in.find('\n', pos);
+
+      if (end == string::npos) {
+        if (conn.in.size() - pos > SERVER_MAX_COMMAND_SIZE) return false;
+
+        if (!conn.eof) break;
+
+        end = conn.in.size();  // The last line of the input
+      }
+
+      command = conn.in.substr(pos, end - pos);
+      pos = std::min(end + 1, conn.in.size());
+
+      if (!command.empty() && command.back() == '\r') command.pop_back();
+    }
+
+    string cmd;
+    std::istringstream(command) >> cmd;
+
+    if (cmd == "exit") {
+      if (binary) appendHeader(conn.out, 0, 0);
+
+      conn.closing = true;
+      break;
+    }
+
+    ostringstream output;
+    bool suc = handler(command, output);
+
+    if (binary) {
+      auto text = output.str();
+      appendHeader(conn.out, suc ? 0 : 1, uint32_t(text.size()));
+      conn.out += text;
+    } else {
+      conn.out += output.str();
+      conn.out += "> ";
+    }
+  }
+
+  conn.in.erase(0, pos);
+
+  // Nothing more will be run for a client which is gone
+  if (conn.eof && (conn.in.empty() || conn.closing)) conn.closing = true;
+
+  return true;
+}
+
+void Server::update(Connection &conn) {
+  uint32_t events = 0;
+
+  if (!conn.out.empty()) events |= EPOLLOUT;
+
+  if (!(conn.closing || conn.eof) && conn.out.size() < SERVER_OUTPUT_LIMIT) {
+    events |= EPOLLIN;
+  }
+
+  // A client whose commands wait for its output to drain is served when
+  // EPOLLOUT comes, so it needs no EPOLLIN meanwhile
+  if (events == 0) {
+    if ((conn.closing || conn.eof) && !conn.blocked) close(conn.fd);
+
+    return;
+  }
+
+  if (events != conn.events) {
+    epoll_event event;
+    event.events = events;
+    event.data.fd = conn.fd;
+
+    if (epoll_ctl(epollFd, EPOLL_CTL_MOD, conn.fd, &event) != 0) {
+      close(conn.fd);
+      return;
+    }
+
+    conn.events = events;
+  }
+}
+
+void Server::close(int fd) {
+  epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+  ::close(fd);
+  connections.erase(fd);
+}
@@ -0,0 +1,156 @@
+//
+// Created by Alper Çakan on 9.04.2018.
+//
+
+#ifndef STGMGR_SERVER_H
+#define STGMGR_SERVER_H
+
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Database.h"
+#include "Transaction.h"
+
+/**
+ * Serves the console commands of a database to many clients at once, over a
+ * Unix domain socket.
+ *
+ * A single thread waits for all the clients with epoll and runs their
+ * commands one at a time, in the order in which they arrive, so the storage
+ * manager is never entered concurrently. A client may send commands in
+ * either of two forms, even mixed:
+ *
+ *  - Text: a command line ending with '\n'. The output is the same as in the
+ *    console, followed by the prompt "> ".
+ *  - Binary: a zero byte, the length of the command as a 32-bit little-endian
+ *    integer, then the command. The response is the status (0 for success,
+ *    1 for failure) as a byte, the length of the output as a 32-bit
+ *    little-endian integer, then the output.
+ *
+ * Each client has a transaction of its own, which is current while its
+ * commands run, so the "begin" of a client opens a transaction only for its
+ * own commands. The transaction is aborted if the client goes away before
+ * committing it.
+ *
+ * The "exit" command closes the connection of the client. The responses to
+ * the commands run for one batch of events are sent after a single
+ * Database::sync(), so that a response is never sent before its command is
+ * durable, and the commits of all the clients share the sync.
+ *
+ *     Server server(db, handler);
+ *
+ *     if (server.listen(socketPath, &error)) server.run();
+ */
+class Server {
+ public:
+  /**
+   * Runs and commits a command.
+   *
+   * @param command The command line
+   * @param out The stream to print the output to
+   * @return Success/failure
+   */
+  typedef std::function<bool(const std::string &command, std::ostream &out)>
+      Handler;
+
+  /**
+   * @param db The database, which should be open
+   * @param handler The handler of the commands
+   */
+  Server(Database &db, Handler handler);
+
+  Server(const Server &) = delete;
+
+  Server &operator=(const Server &) = delete;
+
+  /**
+   * Closes the connections and removes the socket.
+   */
+  ~Server();
+
+  /**
+   * Creates the socket and starts accepting clients. A socket file left at
+   * the path by an earlier server is replaced.
+   *
+   * SIGINT and SIGTERM are blocked, and make run() return instead.
+   *
+   * @param socketPath The path of the socket
+   * @param error If not null, the reason of a failure will be stored here.
+   * @return Success/failure
+   */
+  bool listen(const std::string &socketPath, std::string *error = nullptr);
+
+  /**
+   * Serves the clients until SIGINT or SIGTERM is received.
+   *
+   * @param onIdle If not null, called whenever there is nothing to be done.
+   * It should return soon after pending() becomes true.
+   * @return Success/failure
+   */
+  bool run(const std::function<void()> &onIdle = nullptr);
+
+  /**
+   * Whether there are events which are waiting to be handled.
+   */
+  bool pending() const;
+
+ private:
+  /**
+   * A client, with the data read from it and not yet run, and the output not
+   * yet written to it.
+   */
+  struct Connection {
+    int fd;
+    std::string in, out;
+    bool eof;      // Whether the client has shut its side down
+    bool closing;  // Whether the connection is closed once out is written
+    bool blocked;  // Whether commands wait for out to drain
+    uint32_t events;
+    std::unique_ptr<Transaction> transaction;
+  };
+
+  void accept();
+
+  /**
+   * Reads all the available data of a client.
+   *
+   * @return Success/failure
+   */
+  bool read(Connection &conn);
+
+  /**
+   * Writes as much of the output of a client as it accepts.
+   *
+   * @return Success/failure
+   */
+  bool write(Connection &conn);
+
+  /**
+   * Runs the complete commands received from a client, while its output is
+   * below SERVER_OUTPUT_LIMIT.
+   *
+   * @return Success/failure. Failure means that the client broke the framing.
+   */
+  bool process(Connection &conn);
+
+  /**
+   * Makes epoll wait for the events the connection needs next, or closes it
+   * if it needs none.
+   */
+  void update(Connection &conn);
+
+  void close(int fd);
+
+  Database &db;
+  Handler handler;
+  std::string socketPath;
+  int listenFd = -1, epollFd = -1, signalFd = -1;
+  bool stopped = false;
+  std::unordered_map<int, Connection> connections;
+  std::vector<int> ready;  // Blocked clients whose output has drained
+};
+
+#endif  // STGMGR_SERVER_H
@@ -0,0 +1,189 @@
+//
+// Created by Alper Çakan on 9.04.2018.
+//
+
+#include "Stats.h"
+
+#include <algorithm>
+#include <iomanip>
+
+using std::endl;
+using std::lock_guard;
+using std::ostream;
+using std::string;
+
+static const char *const COUNTER_NAMES[] = {
+    "disc.pages_read",  "disc.pages_written", "disc.pages_appended",
+    "disc.bytes_read",  "disc.bytes_written", "disc.read_calls",
+    "disc.write_calls", "disc.sync_calls",    "pool.hits",
+    "pool.misses",      "pool.read_ahead",    "pool.evictions",
+    "page.accesses",    "wal.bytes",          "wal.syncs"};
+
+static_assert(sizeof(COUNTER_NAMES) / sizeof(COUNTER_NAMES[0]) ==
+                  Stats::COUNTER_COUNT,
+              "Each counter must have a name");
+
+/**
+ * The percentiles printed for each command
+ */
+static const double PERCENTILES[] = {0.5, 0.9, 0.99, 0.999};
+static const char *const PERCENTILE_NAMES[] = {"p50", "p90", "p99", "p999"};
+
+bool Stats::trace = false;
+std::atomic<uint_t> Stats::counters[COUNTER_COUNT];
+std::mutex Stats::mutex;
+std::map<string, Stats::Histogram> Stats::latencies;
+
+const char *Stats::name(Counter counter) { return COUNTER_NAMES[counter]; }
+
+size_t Stats::bucketOf(uint_t value) {
+  if (value < LATENCY_SUB_BUCKETS) return value;
+
+  // The values of [2^e, 2^(e+1)) share LATENCY_SUB_BUCKETS buckets, which are
+  // told apart by the 4 bits after the leading one
+  size_t exponent = 63 - __builtin_clzll(value);
+  size_t sub = (value >> (exponent - 4)) & (LATENCY_SUB_BUCKETS - 1);
+
+  return (exponent - 3) * LATENCY_SUB_BUCKETS + sub;
+}
+
+uint_t Stats::bucketUpperBound(size_t bucket) {
+  if (bucket < LATENCY_SUB_BUCKETS) return bucket;
+
+  size_t exponent = bucket / LATENCY_SUB_BUCKETS + 3;
+  uint_t sub = bucket % LATENCY_SUB_BUCKETS;
+
+  return ((LATENCY_SUB_BUCKETS + sub + 1) << (exponent - 4)) - 1;
+}
+
+void Stats::Histogram::record(uint_t value) {
+  auto bucket = bucketOf(value);
+
+  if (bucket >= buckets.size()) buckets.resize(bucket + 1);
+
+  ++buckets[bucket];
+  ++count;
+  sum += value;
+
+  if (value > max) max = value;
+}
+
+void Stats::Histogram::merge(const Histogram &other) {
+  if (other.buckets.size() > buckets.size()) {
+    buckets.resize(other.buckets.size());
+  }
+
+  for (size_t i = 0; i < other.buckets.size(); ++i) {
+    buckets[i] += other.buckets[i];
+  }
+
+  count += other.count;
+  sum += other.sum;
+  max = std::max(max, other.max);
+}
+
+uint_t Stats::Histogram::percentile(double fraction) const {
+  uint_t rank = uint_t(fraction * count), seen = 0;
+
+  for (size_t i = 0; i < buckets.size(); ++i) {
+    seen += buckets[i];
+
+    if (seen > rank) return std::min(bucketUpperBound(i), max);
+  }
+
+  return max;
+}
+
+void Stats::recordLatency(const string &cmd, uint_t nanos) {
+  lock_guard<std::mutex> guard(mutex);
+  latencies[cmd].record(nanos);
+}
+
+Stats::Timer::~Timer() {
+  if (cmd.empty()) return;
+
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  recordLatency(
+      cmd,
+      std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+}
+
+void Stats::print(ostream &out, bool json) {
+  lock_guard<std::mutex> guard(mutex);
+
+  if (json) {
+    out << "{\"counters\": {";
+
+    for (int i = 0; i < COUNTER_COUNT; ++i) {
+      out << (i ? ", " : "") << "\"" << COUNTER_NAMES[i]
+          << "\": " << counters[i].load(std::memory_order_relaxed);
+    }
+
+    out << "}, \"latency_ns\": {";
+
+    bool first = true;
+
+    for (const auto &entry : latencies) {
+      const auto &hist = entry.second;
+      out << (first ? "" : ", ") << "\"" << entry.first
+          << "\": {\"count\": " << hist.count
+          << ", \"mean\": " << hist.sum / hist.count;
+
+      for (size_t i = 0; i < sizeof(PERCENTILES) / sizeof(double); ++i) {
+        out << ", \"" << PERCENTILE_NAMES[i]
+            << "\": " << hist.percentile(PERCENTILES[i]);
+      }
+
+      out << ", \"max\": " << hist.max << "}";
+      first = false;
+    }
+
+    out << "}}" << endl;
+    return;
+  }
+
+  for (int i = 0; i < COUNTER_COUNT; ++i) {
+    out << std::left << std::setw(24) << COUNTER_NAMES[i]
+        << counters[i].load(std::memory_order_relaxed) << "\n";
+  }
+
+  if (latencies.empty()) {
+    out.flush();
+    return;
+  }
+
+  out << "\n"
+      << std::left << std::setw(16) << "latency (us)" << std::right
+      << std::setw(10) << "count" << std::setw(10) << "mean";
+
+  for (auto name : PERCENTILE_NAMES) out << std::setw(10) << name;
+
+  out << std::setw(10) << "max"
+      << "\n";
+
+  for (const auto &entry : latencies) {
+    const auto &hist = entry.second;
+    out << std::left << std::setw(16) << entry.first << std::right
+        << std::setw(10) << hist.count << std::setw(10)
+        << hist.sum / hist.count / 1000;
+
+    for (auto fraction : PERCENTILES) {
+      out << std::setw(10) << hist.percentile(fraction) / 1000;
+    }
+
+    out << std::setw(10) << hist.max / 1000 << "\n";
+  }
+
+  out << std::left;
+  out.flush();
+}
+
+void Stats::reset() {
+  for (auto &counter : counters) {
+    counter.store(0, std::memory_order_relaxed);
+  }
+
+  lock_guard<std::mutex> guard(mutex);
+  latencies.clear();
+}
@@ -0,0 +1,146 @@
+//
+// Created by Alper Çakan on 9.04.2018.
+//
+
+#ifndef STGMGR_STATS_H
+#define STGMGR_STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "constants.h"
+
+/**
+ * Counters of the I/O done by the storage manager, and the latency histograms
+ * of the console commands.
+ *
+ * The counters are relaxed atomics, so they cost next to nothing and may be
+ * bumped by any thread. Latencies are kept in log-linear histograms (as in
+ * HdrHistogram), guarded by a mutex: each power of two is split into
+ * LATENCY_SUB_BUCKETS buckets, so a percentile is off by at most 1/16.
+ */
+class Stats {
+ public:
+  enum Counter {
+    DISC_PAGES_READ,
+    DISC_PAGES_WRITTEN,
+    DISC_PAGES_APPENDED,
+    DISC_BYTES_READ,
+    DISC_BYTES_WRITTEN,
+    DISC_READ_CALLS,
+    DISC_WRITE_CALLS,
+    DISC_SYNC_CALLS,
+    POOL_HITS,
+    POOL_MISSES,
+    POOL_READ_AHEAD,
+    POOL_EVICTIONS,
+    PAGE_ACCESSES,
+    WAL_BYTES,
+    WAL_SYNCS,
+    COUNTER_COUNT
+  };
+
+  /**
+   * Adds to a counter.
+   *
+   * @param counter The counter
+   * @param n The amount
+   */
+  static void add(Counter counter, uint_t n = 1) {
+    counters[counter].fetch_add(n, std::memory_order_relaxed);
+  }
+
+  /**
+   * Gives the value of a counter.
+   */
+  static uint_t get(Counter counter) {
+    return counters[counter].load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Gives the name of a counter, e.g. "disc.pages_read".
+   */
+  static const char *name(Counter counter);
+
+  /**
+   * Records the latency of a command.
+   *
+   * @param cmd The name of the command
+   * @param nanos The latency in nanoseconds
+   */
+  static void recordLatency(const std::string &cmd, uint_t nanos);
+
+  /**
+   * Prints all the counters and the latency percentiles of each command.
+   *
+   * @param out The stream to print to
+   * @param json If true, everything is printed as a single JSON object.
+   * Otherwise, as a human-readable table.
+   */
+  static void print(std::ostream &out, bool json);
+
+  /**
+   * Zeroes all the counters and histograms.
+   */
+  static void reset();
+
+  /**
+   * Whether each page transferred by Disc is traced to the standard output
+   */
+  static bool trace;
+
+  /**
+   * A log-linear histogram of nonnegative values.
+   */
+  struct Histogram {
+    std::vector<uint_t> buckets;
+    uint_t count = 0;
+    uint_t sum = 0;
+    uint_t max = 0;
+
+    void record(uint_t value);
+
+    /**
+     * Adds the values of another histogram to this one.
+     */
+    void merge(const Histogram &other);
+
+    /**
+     * Gives the value below which the given fraction of the values are (the
+     * upper bound of its bucket).
+     */
+    uint_t percentile(double fraction) const;
+  };
+
+  /**
+   * Measures the time from its construction to its destruction, and records
+   * it as the latency of a command.
+   */
+  class Timer {
+   public:
+    explicit Timer(const std::string &cmd)
+        : cmd(cmd), start(std::chrono::steady_clock::now()) {}
+
+    ~Timer();
+
+   private:
+    std::string cmd;
+    std::chrono::steady_clock::time_point start;
+  };
+
+ private:
+  static const uint_t LATENCY_SUB_BUCKETS = 16;
+
+  static size_t bucketOf(uint_t value);
+  static uint_t bucketUpperBound(size_t bucket);
+
+  static std::atomic<uint_t> counters[COUNTER_COUNT];
+  static std::mutex mutex;
+  static std::map<std::string, Histogram> latencies;
+};
+
+#endif  // STGMGR_STATS_H
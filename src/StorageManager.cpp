@@ -0,0 +1,1724 @@
+//
+// Created by Alper Çakan on 9.04.2018.
+//
+
+#include "StorageManager.h"
+#include "BTree.h"
+#include "BufferPool.h"
+#include "Catalogue.h"
+#include "Cursor.h"
+#include "FreeSpaceMap.h"
+#include "LockManager.h"
+#include "Page.h"
+#include "PageAllocator.h"
+#include "ParallelScan.h"
+#include "Transaction.h"
+#include "Wal.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace std;
+
+/**
+ * Removes a file from the disc, together with its pages in the buffer pool.
+ *
+ * @param fileName The name of the file
+ * @param releaseAddrs Whether the global addresses of the pages are freed.
+ * See Disc::removeFile().
+ */
+static void removeFile(const string &fileName, bool releaseAddrs = false) {
+  BufferPool::discardFile(fileName);
+  Disc::removeFile(fileName, releaseAddrs);
+}
+
+/**
+ * Commits a step of an operation which commits as it goes, then waits for
+ * the lock of the commits again, after the commits of the other threads (see
+ * LockManager). No page may be latched meanwhile.
+ *
+ * @param step Holds the lock of the commits exclusively
+ * @param committed If not null, called once the step is committed, before
+ * the lock is released, so that no checkpoint comes in between
+ * @return Success/failure
+ */
+static bool commitStep(LockGuard &step,
+                       const function<bool()> &committed = nullptr) {
+  bool suc = commit() && (!committed || committed());
+
+  step.release();
+  step = LockGuard(LockManager::commits(), Lock::EXCLUSIVE);
+  return suc;
+}
+
+/**
+ * Whether a scan of a type is shared among several threads: only if its data
+ * file is large enough, and not in a transaction, whose changes are not in
+ * the file (see ParallelScan). If so, the type is locked shared, since the
+ * file is read past the buffer pool, and the writers must be kept out.
+ *
+ * The scan is not shared either if a change of the file is not committed
+ * yet, which may not be written to the file (see BufferPool).
+ *
+ * @param typeName The name of the type
+ * @param threadCount The number of threads to scan with
+ * @param shared Holds the lock of the type if the scan is shared
+ */
+static bool scansInParallel(const string &typeName, uint_t threadCount,
+                            LockGuard &shared) {
+  if (!(threadCount > 1 && !inTransaction() &&
+        Disc::getPageCount(typeName) >= PARALLEL_SCAN_MIN_PAGES)) {
+    return false;
+  }
+
+  shared = LockGuard(LockManager::of(typeName), Lock::SHARED);
+
+  if (BufferPool::isCommitted(typeName)) return true;
+
+  shared.release();
+  return false;
+}
+
+/**
+ * Gives a page of a file which has an empty cell, latched exclusively. The
+ * free-space map of the file is consulted to skip the full pages, and a new
+ * page is appended to the file if all of its pages are full.
+ *
+ * @param fileName The name of the file
+ * @param firstEmptyCell Gives the index of the first empty cell of a page, or
+ * -1 if the page is full
+ * @param emptyCellIndex A reference to an integer variable. This will contain
+ * the index of the empty cell in the page.
+ * @return A pointer to a dynamically allocated Page object, or null on failure
+ */
+static Page *pageWithEmptyCell(const string &fileName,
+                               const function<int(Page &)> &firstEmptyCell,
+                               int &emptyCellIndex) {
+  while (true) {
+    auto locAddr = FreeSpaceMap::findPage(fileName);
+
+    if (!locAddr && !Disc::appendPage(fileName, &locAddr)) {
+      return nullptr;
+    }
+
+    Page *page = new Page(fileName, locAddr, Page::LATCH_EXCLUSIVE);
+
+    if (!(*page)) {
+      delete page;
+      return nullptr;
+    }
+
+    if ((emptyCellIndex = firstEmptyCell(*page)) >= 0) {
+      return page;
+    }
+
+    // The map was stale, or another thread has filled the page since
+    delete page;
+
+    if (!FreeSpaceMap::setFull(fileName, locAddr, true)) {
+      return nullptr;
+    }
+  }
+}
+
+/**
+ * Gives a page of a file which has an empty cell of the given size. See
+ * above.
+ */
+static Page *pageWithEmptyCell(const string &fileName, size_t cellSize,
+                               int &emptyCellIndex) {
+  return pageWithEmptyCell(
+      fileName,
+      [cellSize](Page &page) { return page.firstEmptyCellIndex(cellSize); },
+      emptyCellIndex);
+}
+
+/**
+ * Marks a page as full in the free-space map of its file if the page has no
+ * empty cells left. Should be called after filling a cell of the page.
+ *
+ * @param fileName The name of the file in which the page resides
+ * @param page The page
+ * @param cellSize Size of one cell
+ * @return Success/failure
+ */
+static bool updateFreeSpace(const string &fileName, Page &page,
+                            size_t cellSize) {
+  return page.firstEmptyCellIndex(cellSize) >= 0 ||
+         FreeSpaceMap::setFull(fileName, page.getLocAddr(), true);
+}
+
+/**
+ * Like above, but for a data page with the given layout.
+ */
+static bool updateFreeSpace(const string &fileName, Page &page,
+                            const DataLayout &layout) {
+  return layout.firstEmptySlot(page) >= 0 ||
+         FreeSpaceMap::setFull(fileName, page.getLocAddr(), true);
+}
+
+/**
+ * Adds the entries of a record to the indexes of its type, or removes them.
+ *
+ * @param typeName The name of the type
+ * @param schema The schema of the type
+ * @param values The field values of the record
+ * @param rid The record id of the record, see BTree::makeRid()
+ * @param add Whether the entries are added (or removed)
+ * @return Success/failure. If an entry cannot be added, the entries added
+ * before it are removed.
+ */
+static bool updateIndexes(const string &typeName, const TypeSchema &schema,
+                          Record values, uint_t rid, bool add) {
+  for (size_t i = 0; i < schema.indexed.size(); ++i) {
+    if (!schema.indexed[i]) continue;
+
+    BTree index(Catalogue::indexFileName(typeName, i));
+
+    if (!(add ? index.insert(values[i], rid) : index.remove(values[i], rid))) {
+      while (add && i-- > 0) {
+        if (schema.indexed[i]) {
+          BTree(Catalogue::indexFileName(typeName, i)).remove(values[i], rid);
+        }
+      }
+
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * Removes an index file, along with its free-space map (see BTree).
+ *
+ * @param fileName The name of the index file
+ * @param releaseAddrs Whether the global addresses of the pages are freed
+ */
+static void removeIndexFile(const string &fileName, bool releaseAddrs) {
+  removeFile(FreeSpaceMap::mapFileName(fileName), releaseAddrs);
+  removeFile(fileName, releaseAddrs);
+}
+
+/**
+ * Removes the index files of a type.
+ *
+ * @param typeName The name of the type
+ * @param fieldCount The number of fields of the type
+ * @param releaseAddrs Whether the global addresses of the pages are freed
+ */
+static void removeIndexFiles(const string &typeName, size_t fieldCount,
+                             bool releaseAddrs = false) {
+  for (size_t i = 0; i < fieldCount; ++i) {
+    removeIndexFile(Catalogue::indexFileName(typeName, i), releaseAddrs);
+  }
+}
+
+bool createType(const string &typeName, const vector<string> &fieldNames,
+                DataLayout::Format format) {
+  if (inTransaction()) return false;
+
+  TypeLock lock(typeName, Lock::EXCLUSIVE);
+
+  if (fieldNames.empty() || fieldNames.size() > Catalogue::maxFieldCount() ||
+      Catalogue::find(typeName)) {
+    return false;
+  }
+
+  // First, prepare an empty data file for the new type, so that the type is
+  // never registered without one
+  removeIndexFiles(typeName, fieldNames.size());
+  removeFile(FreeSpaceMap::mapFileName(typeName));
+  removeFile(typeName);
+
+  if (!Disc::appendPage(typeName)) {
+    return false;
+  }
+
+  // Then, register the field names to the system catalogue. Each type has
+  // a whole page, hence a page is a single cell.
+
+  int emptyCellIndex;
+  Page *fieldPage = pageWithEmptyCell(SYS_CATALOGUE_FIELDS_FILE_NAME,
+                                      Page::contentSize(), emptyCellIndex);
+
+  if (!fieldPage) {
+    return false;
+  }
+
+  // Clean the garbage
+  fieldPage->reset();
+
+  // Write the names of the fields
+  for (size_t i = 0; i < fieldNames.size(); ++i) {
+    auto name = fieldNames[i];
+
+    if (!(fieldPage->writeContent(name.c_str(), name.length(),
+                                  i * FIELD_NAME_SIZE))) {
+      delete fieldPage;
+      return false;
+    }
+  }
+
+  // The format follows the names
+  uint_t formatVal = format;
+  fieldPage->writeContent(reinterpret_cast<char *>(&formatVal), sizeof(uint_t),
+                          Catalogue::fieldPageFormatPos());
+
+  // Save the page
+  fieldPage->setCellUsed(0, true);
+  fieldPage->setIsUsed(true);
+  fieldPage->setPageCategory(PAGE_CATEGORY_FIELD_NAMES);
+
+  if (!(fieldPage->persist() &&
+        FreeSpaceMap::setFull(SYS_CATALOGUE_FIELDS_FILE_NAME,
+                              fieldPage->getLocAddr(), true))) {
+    delete fieldPage;
+    return false;
+  }
+
+  uint_t fieldPageAddr = fieldPage->getLocAddr();
+  delete fieldPage;
+
+  // Now, onto registering the type into the system catalogue
+
+  Page *typePage = pageWithEmptyCell(SYS_CATALOGUE_TYPES_FILE_NAME,
+                                     TYPE_DATA_SIZE, emptyCellIndex);
+
+  if (!typePage) {
+    return false;
+  }
+
+  uint_t fieldCount = fieldNames.size();
+  size_t cellStart = emptyCellIndex * TYPE_DATA_SIZE;
+
+  typePage->resetRange(cellStart, TYPE_DATA_SIZE);
+
+  typePage->writeContent(typeName.c_str(), typeName.length(), cellStart);
+
+  typePage->writeContent(reinterpret_cast<char *>(&fieldCount), sizeof(uint_t),
+                         TYPE_NAME_SIZE + cellStart);
+
+  typePage->writeContent(reinterpret_cast<char *>(&fieldPageAddr),
+                         sizeof(uint_t),
+                         cellStart + TYPE_NAME_SIZE + sizeof(uint_t));
+
+  typePage->setCellUsed(emptyCellIndex, true);
+  typePage->setIsUsed(true);
+  typePage->setPageCategory(PAGE_CATEGORY_TYPES);
+  if (!(typePage->persist() && updateFreeSpace(SYS_CATALOGUE_TYPES_FILE_NAME,
+                                               *typePage, TYPE_DATA_SIZE))) {
+    delete typePage;
+    return false;
+  }
+
+  TypeSchema schema;
+  schema.fieldNames = fieldNames;
+  schema.indexed.resize(fieldCount);
+  schema.format = format;
+  schema.fieldPageAddr = fieldPageAddr;
+  schema.typePageAddr = typePage->getLocAddr();
+  schema.typeCellIndex = emptyCellIndex;
+  Catalogue::put(typeName, schema);
+
+  delete typePage;
+  return true;
+}
+
+vector<pair<string, vector<string>>> getTypeList(bool all,
+                                                 const string &typeName) {
+  vector<pair<string, vector<string>>> typeNames;
+
+  if (!all) {
+    TypeLock lock(typeName, Lock::INTENT_SHARED);
+    auto schema = Catalogue::find(typeName);
+
+    if (schema) typeNames.push_back({typeName, schema->fieldNames});
+
+    return typeNames;
+  }
+
+  for (const auto &type : Catalogue::list()) {
+    typeNames.push_back({type.first, type.second.fieldNames});
+  }
+
+  return typeNames;
+}
+
+bool deleteType(const string &typeName) {
+  if (inTransaction()) return false;
+
+  TypeLock lock(typeName, Lock::EXCLUSIVE);
+  auto schema = Catalogue::find(typeName);
+
+  if (!schema) {
+    return false;
+  }
+
+  auto typeCellIndex = schema->typeCellIndex;
+  Page typePage(SYS_CATALOGUE_TYPES_FILE_NAME, schema->typePageAddr,
+                Page::LATCH_EXCLUSIVE);
+  Page fieldPage(SYS_CATALOGUE_FIELDS_FILE_NAME, schema->fieldPageAddr,
+                 Page::LATCH_EXCLUSIVE);
+
+  if (!(typePage && fieldPage)) {
+    return false;
+  }
+
+  removeIndexFiles(typeName, schema->fieldNames.size(), true);
+  removeFile(FreeSpaceMap::mapFileName(typeName), true);
+  removeFile(typeName, true);
+  Catalogue::erase(typeName);
+
+  fieldPage.setIsUsed(false);
+  typePage.setCellUsed(typeCellIndex, false);
+
+  return fieldPage.persist() && typePage.persist() &&
+         FreeSpaceMap::setFull(SYS_CATALOGUE_FIELDS_FILE_NAME,
+                               fieldPage.getLocAddr(), false) &&
+         FreeSpaceMap::setFull(SYS_CATALOGUE_TYPES_FILE_NAME,
+                               typePage.getLocAddr(), false);
+}
+
+bool format(Disc::Backend backend, uint_t pageSize, uint_t maxPageCount) {
+  if (inTransaction()) return false;
+
+  // Just remove all system catalogue files and initialize each of them with a
+  // single null page.
+  LockGuard lock(LockManager::database(), Lock::EXCLUSIVE);
+
+  // The pages in the pool are of the old page size
+  if (!BufferPool::discardAll()) return false;
+
+  Disc::pageSize = pageSize;
+  Disc::maxPageCount = maxPageCount;
+
+  Catalogue::invalidate();
+  PageAllocator::clear();
+  removeFile(WAL_FILE_NAME);
+
+  for (auto fileName :
+       {SYS_CATALOGUE_GENERAL_FILE_NAME, SYS_CATALOGUE_TYPES_FILE_NAME,
+        SYS_CATALOGUE_FIELDS_FILE_NAME}) {
+    removeFile(fileName);
+    removeFile(FreeSpaceMap::mapFileName(fileName));
+  }
+
+  if (!(Disc::appendPage(SYS_CATALOGUE_GENERAL_FILE_NAME) &&
+        Disc::appendPage(SYS_CATALOGUE_TYPES_FILE_NAME) &&
+        Disc::appendPage(SYS_CATALOGUE_FIELDS_FILE_NAME))) {
+    return false;
+  }
+
+  Page genSysCat(SYS_CATALOGUE_GENERAL_FILE_NAME, 1, Page::LATCH_EXCLUSIVE);
+  uint_t backendVal = backend;
+
+  return genSysCat &&
+         genSysCat.writeContent(reinterpret_cast<char *>(&backendVal),
+                                sizeof(uint_t), GEN_CAT_BACKEND_POS) &&
+         genSysCat.writeContent(reinterpret_cast<char *>(&pageSize),
+                                sizeof(uint_t), GEN_CAT_PAGE_SIZE_POS) &&
+         genSysCat.writeContent(reinterpret_cast<char *>(&maxPageCount),
+                                sizeof(uint_t), GEN_CAT_MAX_PAGE_COUNT_POS) &&
+         genSysCat.persist();
+}
+
+pair<uint_t, uint_t> createRecord(const string &typeName, Record values) {
+  TypeLock lock(typeName, Lock::INTENT_EXCLUSIVE);
+  auto schema = Catalogue::find(typeName);
+
+  if (!schema || values.size() != schema->fieldNames.size()) {
+    return {0, 0};
+  }
+
+  LockGuard unique;
+
+  if (schema->indexed[0]) {
+    // Held until the entry of the record is added, so that no other record
+    // with the same key is created meanwhile
+    unique = LockGuard(LockManager::of(Catalogue::indexFileName(typeName, 0)),
+                       Lock::EXCLUSIVE);
+    BTree index(Catalogue::indexFileName(typeName, 0));
+    vector<uint_t> rids;
+
+    if (!index.find(values[0], rids, 1) || !rids.empty()) {
+      return {0, 0};
+    }
+  }
+
+  int emptyCellIndex;
+  const auto fieldCount = values.size();
+  const auto format = schema->format;
+  Page *page = pageWithEmptyCell(
+      typeName,
+      [fieldCount, format, values](Page &page) {
+        return DataLayout::of(page, fieldCount, format)
+            .firstEmptySlot(page, values.data());
+      },
+      emptyCellIndex);
+
+  if (!page) {
+    return {0, 0};
+  }
+
+  auto layout = DataLayout::of(*page, fieldCount, format);
+  auto rid = BTree::makeRid(page->getLocAddr(), emptyCellIndex);
+
+  // The entries are added first, while the page is latched, so that the
+  // record is not written if they cannot be
+  if (!updateIndexes(typeName, *schema, values, rid, true)) {
+    delete page;
+    return {0, 0};
+  }
+
+  if (!(layout.write(*page, emptyCellIndex, values.data()) &&
+        page->persist())) {
+    delete page;
+    updateIndexes(typeName, *schema, values, rid, false);
+    return {0, 0};
+  }
+
+  pair<uint_t, uint_t> addr = {page->globAddr(), page->getLocAddr()};
+
+  // The map is only a hint, which the next insert corrects if it is stale,
+  // so the record is created even if the map is not updated
+  updateFreeSpace(typeName, *page, layout);
+  delete page;
+
+  return addr;
+}
+
+/**
+ * Looks up (and deletes) the record with the given primary key through the
+ * primary key index of its type. See searchRecord() for the parameters and
+ * the return value.
+ *
+ * The index is locked until the page of the record is read, so the record id
+ * found in it is not stale.
+ */
+static pair<vector<vector<sint_t>>, pair<uint_t, uint_t>> lookupRecord(
+    const string &typeName, const TypeSchema &schema, sint_t keyValue,
+    bool del, bool &suc) {
+  suc = true;
+  const auto fieldCount = schema.fieldNames.size();
+  vector<vector<sint_t>> res;
+  auto indexFileName = Catalogue::indexFileName(typeName, 0);
+  LockGuard lock(LockManager::of(indexFileName),
+                 del ? Lock::EXCLUSIVE : Lock::SHARED);
+  BTree index(indexFileName);
+  vector<uint_t> rids;
+
+  if (!index.find(keyValue, rids, 1)) {
+    suc = false;
+    return {res, {0, 0}};
+  }
+
+  if (rids.empty()) {
+    return {res, {0, 0}};
+  }
+
+  Page page(typeName, BTree::ridPage(rids[0]),
+            del ? Page::LATCH_EXCLUSIVE : Page::LATCH_SHARED);
+
+  if (!page) {
+    suc = false;
+    return {res, {0, 0}};
+  }
+
+  auto layout = DataLayout::of(page, fieldCount, schema.format);
+  const auto slot = BTree::ridSlot(rids[0]);
+
+  res.push_back(vector<sint_t>(fieldCount));
+  layout.read(page.image(), slot, res.back().data());
+
+  if (del) {
+    layout.erase(page, slot);
+
+    if (!(page.persist() &&
+          updateIndexes(typeName, schema, res.back(), rids[0], false) &&
+          FreeSpaceMap::setFull(typeName, page.getLocAddr(), false))) {
+      suc = false;
+      return {res, {0, 0}};
+    }
+  }
+
+  return {res, {page.globAddr(), page.getLocAddr()}};
+}
+
+pair<vector<vector<sint_t>>, pair<uint_t, uint_t>> searchRecord(
+    const string &typeName, sint_t keyValue, bool all, bool del, bool &suc,
+    uint_t threadCount, bool ordered) {
+  suc = true;
+
+  // Deleting all the records may change more pages than the buffer pool
+  // holds, so outside a transaction it commits as it goes, as createIndex()
+  // does, and keeps the writers out likewise
+  const bool inSteps = del && all && !inTransaction();
+  TypeLock lock;
+  LockGuard database, type, step;
+
+  if (inSteps) {
+    database = LockGuard(LockManager::database(), Lock::SHARED);
+    type = LockGuard(LockManager::of(typeName), Lock::EXCLUSIVE);
+    step = LockGuard(LockManager::commits(), Lock::EXCLUSIVE);
+  } else {
+    lock =
+        TypeLock(typeName, del ? Lock::INTENT_EXCLUSIVE : Lock::INTENT_SHARED);
+  }
+
+  vector<vector<sint_t>> res;
+  uint_t glob = 0, loc = 0;
+  auto schema = Catalogue::find(typeName);
+
+  if (!schema) {
+    suc = false;
+    return {res, {0, 0}};
+  }
+
+  const auto fieldCount = schema->fieldNames.size();
+  const auto format = schema->format;
+  bool indexed = schema->indexed[0];
+
+  if (indexed && !all) {
+    return lookupRecord(typeName, *schema, keyValue, del, suc);
+  }
+
+  LockGuard shared;
+
+  if (!del && scansInParallel(typeName, threadCount, shared)) {
+    vector<ParallelScan::Match> matches;
+    ParallelScan::Filter byKey = {0, keyValue, keyValue};
+
+    if (!ParallelScan::run(typeName, fieldCount, format, threadCount, ordered,
+                           !all, all ? nullptr : &byKey, matches)) {
+      suc = false;
+      return {res, {0, 0}};
+    }
+
+    for (auto &match : matches) {
+      res.push_back(move(match.fields));
+      glob = match.globAddr;
+      loc = match.locAddr;
+    }
+
+    return {res, {glob, loc}};
+  }
+
+  // The primary key index is locked before the data pages are latched
+  LockGuard unique;
+
+  if (del && indexed) {
+    unique = LockGuard(LockManager::of(Catalogue::indexFileName(typeName, 0)),
+                       Lock::EXCLUSIVE);
+  }
+
+  Page *page = new Page(typeName, 1,
+                        del ? Page::LATCH_EXCLUSIVE : Page::LATCH_SHARED);
+
+  if (!(*page)) {
+    delete page;
+    suc = false;
+    return {res, {0, 0}};
+  }
+
+  vector<size_t> slots;
+
+  while (page) {
+    if (page->isUsed()) {
+      auto layout = DataLayout::of(*page, fieldCount, format);
+
+      slots.clear();
+
+      if (all) {
+        layout.usedSlots(page->image(), slots);
+      } else {
+        layout.select(page->image(), 0, keyValue, keyValue, slots);
+      }
+
+      for (auto i : slots) {
+        vector<sint_t> record(fieldCount);
+        layout.read(page->image(), i, record.data());
+
+        res.push_back(record);
+
+        if (del) {
+          layout.erase(*page, i);
+
+          if (!(page->persist() &&
+                FreeSpaceMap::setFull(typeName, page->getLocAddr(), false) &&
+                updateIndexes(typeName, *schema, record,
+                              BTree::makeRid(page->getLocAddr(), i), false))) {
+            delete page;
+            suc = false;
+            return {res, {0, 0}};
+          }
+        }
+
+        glob = page->globAddr();
+        loc = page->getLocAddr();
+
+        if (!all) {
+          delete page;
+          return {res, {glob, loc}};
+        }
+      }
+    }
+
+    if (!inSteps) {
+      auto tmp = page;
+      page = page->getConsecPage();
+      delete tmp;
+      continue;
+    }
+
+    // No page is latched while the step is committed
+    auto next = page->getLocAddr() + 1;
+    delete page;
+    page = nullptr;
+
+    if (BufferPool::needsCommit() && !commitStep(step)) {
+      suc = false;
+      return {res, {0, 0}};
+    }
+
+    if (next <= Disc::getPageCount(typeName)) {
+      page = new Page(typeName, next, Page::LATCH_EXCLUSIVE);
+
+      if (!(*page)) {
+        delete page;
+        suc = false;
+        return {res, {0, 0}};
+      }
+    }
+  }
+
+  delete page;
+  return {res, {glob, loc}};
+}
+
+/**
+ * Records in the fields catalogue whether a field of a type is indexed, and
+ * updates the in-memory catalogue.
+ *
+ * @param typeName The name of the type
+ * @param schema The schema of the type
+ * @param field The index of the field
+ * @param indexed Whether the field is indexed
+ * @return Success/failure
+ */
+static bool setIndexed(const string &typeName, const TypeSchema &schema,
+                       size_t field, bool indexed) {
+  Page fieldPage(SYS_CATALOGUE_FIELDS_FILE_NAME, schema.fieldPageAddr,
+                 Page::LATCH_EXCLUSIVE);
+
+  if (!fieldPage) return false;
+
+  auto pos = Catalogue::fieldPageIndexedPos() + field / 64 * sizeof(uint_t);
+  auto bits = fieldPage.getUIntAtPos(pos);
+  auto bit = uint_t(1) << (field % 64);
+
+  bits = indexed ? bits | bit : bits & ~bit;
+
+  if (!(fieldPage.writeContent(reinterpret_cast<const char *>(&bits),
+                               sizeof(uint_t), pos) &&
+        fieldPage.persist())) {
+    return false;
+  }
+
+  Catalogue::setIndexed(typeName, field, indexed);
+  return true;
+}
+
+bool createIndex(const string &typeName, size_t field) {
+  if (inTransaction()) return false;
+
+  // The index is unused until it is complete, so it is committed as it is
+  // built, if it fills the buffer pool. A commit waits for the writers of all
+  // the types, so they are kept out from the start.
+  LockGuard database(LockManager::database(), Lock::SHARED);
+  LockGuard type(LockManager::of(typeName), Lock::EXCLUSIVE);
+  LockGuard step(LockManager::commits(), Lock::EXCLUSIVE);
+  auto schema = Catalogue::find(typeName);
+
+  if (!schema || field >= schema->fieldNames.size()) {
+    return false;
+  }
+
+  auto fileName = Catalogue::indexFileName(typeName, field);
+
+  // The old index, if any, is no longer used from here on, and the new one
+  // is used only once it is complete
+  if (!((!schema->indexed[field] ||
+         setIndexed(typeName, *schema, field, false)) &&
+        BTree::create(fileName))) {
+    removeIndexFile(fileName, true);
+    return false;
+  }
+
+  BTree index(fileName);
+  const auto fieldCount = schema->fieldNames.size();
+  Page *page = new Page(typeName, 1);
+  vector<size_t> slots;
+
+  while (page && *page) {
+    if (page->isUsed()) {
+      auto layout = DataLayout::of(*page, fieldCount, schema->format);
+
+      slots.clear();
+      layout.usedSlots(page->image(), slots);
+
+      for (auto i : slots) {
+        auto key = layout.field(page->image(), i, field);
+        vector<uint_t> rids;
+
+        // Only the primary key is unique
+        if (!((field != 0 || (index.find(key, rids, 1) && rids.empty())) &&
+              index.insert(key, BTree::makeRid(page->getLocAddr(), i)))) {
+          delete page;
+          removeIndexFile(fileName, true);
+          return false;
+        }
+      }
+    }
+
+    auto next = page->getLocAddr() + 1;
+    delete page;
+    page = nullptr;
+
+    if (BufferPool::needsCommit() && !commitStep(step)) {
+      removeIndexFile(fileName, true);
+      return false;
+    }
+
+    if (next <= Disc::getPageCount(typeName)) page = new Page(typeName, next);
+  }
+
+  delete page;
+
+  if (!setIndexed(typeName, *schema, field, true)) {
+    removeIndexFile(fileName, true);
+    return false;
+  }
+
+  return true;
+}
+
+bool searchBy(const string &typeName, size_t field, sint_t value,
+              const function<void(Record, pair<uint_t, uint_t>)> &onRecord,
+              uint_t threadCount) {
+  TypeLock lock(typeName, Lock::INTENT_SHARED);
+  auto schema = Catalogue::find(typeName);
+
+  if (!schema || field >= schema->fieldNames.size()) {
+    return false;
+  }
+
+  const auto fieldCount = schema->fieldNames.size();
+  const auto format = schema->format;
+  vector<sint_t> values(fieldCount);
+
+  if (schema->indexed[field]) {
+    BTree index(Catalogue::indexFileName(typeName, field));
+    vector<uint_t> rids;
+
+    if (!index.find(value, rids)) {
+      return false;
+    }
+
+    // The record ids are in ascending order, so each page is read once
+    Page *page = nullptr;
+
+    for (auto rid : rids) {
+      if (!page || page->getLocAddr() != BTree::ridPage(rid)) {
+        delete page;
+        page = new Page(typeName, BTree::ridPage(rid));
+
+        if (!(*page)) {
+          delete page;
+          return false;
+        }
+      }
+
+      // The index is not locked any more, so the record may have been
+      // deleted (and its slot reused) since it was found
+      auto slot = BTree::ridSlot(rid);
+      auto layout = DataLayout::of(*page, fieldCount, format);
+
+      if (!(page->isUsed() && slot < layout.capacity() &&
+            page->isCellUsed(slot))) {
+        continue;
+      }
+
+      layout.read(page->image(), slot, values.data());
+
+      if (values[field] != value) continue;
+
+      onRecord(values, {page->globAddr(), page->getLocAddr()});
+    }
+
+    delete page;
+    return true;
+  }
+
+  ParallelScan::Filter filter = {field, value, value};
+
+  LockGuard shared;
+
+  if (scansInParallel(typeName, threadCount, shared)) {
+    return ParallelScan::run(
+        typeName, fieldCount, format, threadCount, true, false, &filter,
+        [&onRecord](Record fields, uint_t globAddr, uint_t locAddr) {
+          onRecord(fields, {globAddr, locAddr});
+        });
+  }
+
+  Cursor cursor(typeName, fieldCount, format, &filter);
+
+  while (cursor.next()) {
+    onRecord(cursor.record(), cursor.pageNumber());
+  }
+
+  return !cursor.failed();
+}
+
+bool listRecords(const string &typeName,
+                 const function<void(Record, pair<uint_t, uint_t>)> &onRecord,
+                 uint_t threadCount, bool ordered) {
+  TypeLock lock(typeName, Lock::INTENT_SHARED);
+  auto schema = Catalogue::find(typeName);
+
+  if (!schema) return false;
+
+  const auto fieldCount = schema->fieldNames.size();
+  const auto format = schema->format;
+
+  LockGuard shared;
+
+  if (scansInParallel(typeName, threadCount, shared)) {
+    return ParallelScan::run(
+        typeName, fieldCount, format, threadCount, ordered, false, nullptr,
+        [&onRecord](Record fields, uint_t globAddr, uint_t locAddr) {
+          onRecord(fields, {globAddr, locAddr});
+        });
+  }
+
+  Cursor cursor(typeName, fieldCount, format);
+
+  while (cursor.next()) {
+    onRecord(cursor.record(), cursor.pageNumber());
+  }
+
+  return !cursor.failed();
+}
+
+bool aggregate(const string &typeName, size_t field, int groupField,
+               vector<pair<sint_t, Aggregate>> &groups, uint_t threadCount) {
+  TypeLock lock(typeName, Lock::INTENT_SHARED);
+  auto schema = Catalogue::find(typeName);
+
+  if (!schema || field >= schema->fieldNames.size() ||
+      groupField >= int(schema->fieldNames.size())) {
+    return false;
+  }
+
+  const auto fieldCount = schema->fieldNames.size();
+  const auto format = schema->format;
+  LockGuard shared;
+  const bool parallel = scansInParallel(typeName, threadCount, shared);
+
+  if (!parallel) threadCount = 1;
+
+  // Each thread has its own table and slot buffer; they are merged at the end
+  vector<unordered_map<sint_t, Aggregate>> tables(threadCount);
+  vector<Aggregate> totals(threadCount);
+  vector<vector<size_t>> slotBuffers(threadCount);
+
+  auto accumulate = [&](uint_t thread, const char *image) {
+    auto layout = DataLayout::ofImage(image, fieldCount, format);
+    auto &slots = slotBuffers[thread];
+
+    slots.clear();
+    layout.usedSlots(image, slots);
+
+    if (groupField < 0) {
+      auto &total = totals[thread];
+
+      for (auto i : slots) {
+        total.add(layout.field(image, i, field));
+      }
+    } else {
+      auto &table = tables[thread];
+
+      for (auto i : slots) {
+        table[layout.field(image, i, groupField)].add(
+            layout.field(image, i, field));
+      }
+    }
+  };
+
+  if (parallel) {
+    if (!ParallelScan::forEachPage(
+            typeName, threadCount,
+            [&](uint_t thread, const char *image, uint_t) {
+              accumulate(thread, image);
+              return true;
+            })) {
+      return false;
+    }
+  } else {
+    Page *page = new Page(typeName, 1);
+
+    if (!(*page)) {
+      delete page;
+      return false;
+    }
+
+    while (page) {
+      if (page->isUsed()) {
+        accumulate(0, page->image());
+      }
+
+      auto tmp = page;
+      page = page->getConsecPage();
+      delete tmp;
+    }
+  }
+
+  groups.clear();
+
+  if (groupField < 0) {
+    for (uint_t t = 1; t < threadCount; ++t) {
+      totals[0].merge(totals[t]);
+    }
+
+    groups.push_back({0, totals[0]});
+    return true;
+  }
+
+  for (uint_t t = 1; t < threadCount; ++t) {
+    for (const auto &group : tables[t]) {
+      tables[0][group.first].merge(group.second);
+    }
+  }
+
+  groups.assign(tables[0].begin(), tables[0].end());
+  sort(groups.begin(), groups.end(),
+       [](const pair<sint_t, Aggregate> &a, const pair<sint_t, Aggregate> &b) {
+         return a.first < b.first;
+       });
+
+  return true;
+}
+
+/**
+ * Reads the next record from a bulk load input.
+ *
+ * @param in The input
+ * @param binary If true, the input is a sequence of native 64-bit integers.
+ * If false, each line of the input is a record with comma separated values.
+ * Empty lines are skipped.
+ * @param values The vector in which the field values are stored. Its size
+ * must be the number of fields.
+ * @param suc A reference to a boolean variable. This will be set to false if
+ * the input is malformed.
+ * @return Whether a record was read
+ */
+static bool readBulkRecord(istream &in, bool binary, vector<sint_t> &values,
+                           bool &suc) {
+  suc = true;
+
+  if (binary) {
+    in.read(reinterpret_cast<char *>(values.data()),
+            values.size() * sizeof(sint_t));
+
+    if (in.gcount() == 0) return false;
+
+    suc = size_t(in.gcount()) == values.size() * sizeof(sint_t);
+    return suc;
+  }
+
+  string line;
+
+  while (getline(in, line)) {
+    const char *pos = line.c_str();
+    size_t i = 0;
+
+    while (*pos == ' ' || *pos == '\t' || *pos == '\r') ++pos;
+
+    if (*pos == '\0') continue;
+
+    for (; i < values.size(); ++i) {
+      char *end;
+      values[i] = strtoll(pos, &end, 10);
+
+      if (end == pos) break;
+
+      pos = end;
+
+      while (*pos == ' ' || *pos == '\t' || *pos == '\r') ++pos;
+
+      if (*pos == ',') ++pos;
+    }
+
+    suc = i == values.size() && *pos == '\0';
+    return suc;
+  }
+
+  return false;
+}
+
+bool bulkLoad(const string &typeName, const string &path, bool binary,
+              uint_t &count,
+              const function<void(Record, pair<uint_t, uint_t>)> &onRecord) {
+  count = 0;
+
+  if (inTransaction()) return false;
+
+  // Each batch is committed, and a commit waits for the writers of all the
+  // types, so they are kept out from the start
+  LockGuard database(LockManager::database(), Lock::SHARED);
+  LockGuard type(LockManager::of(typeName), Lock::EXCLUSIVE);
+  LockGuard step(LockManager::commits(), Lock::EXCLUSIVE);
+  auto schema = Catalogue::find(typeName);
+  ifstream in(path, binary ? ifstream::binary : ifstream::in);
+
+  if (!schema || !in) {
+    return false;
+  }
+
+  const auto fieldCount = schema->fieldNames.size();
+  const DataLayout layout(fieldCount, schema->format);
+  const bool indexed = schema->indexed[0];
+  const size_t indexCount =
+      std::count(schema->indexed.begin(), schema->indexed.end(), true);
+  BTree index(Catalogue::indexFileName(typeName, 0));
+
+  vector<char> batch(BULK_LOAD_BATCH_PAGES * Disc::pageSize);
+  vector<sint_t> batchValues;  // The records of the batch, one after another
+  vector<pair<uint_t, uint_t>> batchSlots;  // (Page in Batch, Slot) of each
+  unordered_set<sint_t> batchKeys;
+  vector<sint_t> values(fieldCount);
+  Page page;
+  uint_t pageCount = 0;
+  size_t cellCount = 0;  // The number of the records in the current page
+  bool suc = true, more = true;
+
+  // Appends the filled pages, then registers their records and commits them.
+  // The pages changed by a batch stay in the buffer pool until the commit,
+  // so a batch is also ended once it would add too many index entries.
+  auto flush = [&]() -> bool {
+    if (cellCount > 0) {
+      memcpy(batch.data() + pageCount++ * Disc::pageSize, page.image(),
+             Disc::pageSize);
+    }
+
+    if (pageCount == 0) return true;
+
+    auto firstLoc = Disc::getPageCount(typeName) + 1;
+    auto fullPages = cellCount > 0 ? pageCount - 1 : pageCount;
+
+    if (!(Disc::appendPages(typeName, batch.data(), pageCount) &&
+          (fullPages == 0 ||
+           FreeSpaceMap::setFull(typeName, firstLoc, fullPages, true)))) {
+      return false;
+    }
+
+    for (size_t r = 0; r < batchSlots.size(); ++r) {
+      auto rec = batchValues.data() + r * fieldCount;
+      auto loc = firstLoc + batchSlots[r].first;
+
+      if (!updateIndexes(typeName, *schema, Record(rec, fieldCount),
+                         BTree::makeRid(loc, batchSlots[r].second), true)) {
+        return false;
+      }
+
+      if (onRecord) {
+        onRecord(Record(rec, fieldCount),
+                 {Page::globAddrOf(batch.data() +
+                                   batchSlots[r].first * Disc::pageSize),
+                  loc});
+      }
+    }
+
+    // While the log is open, the pages are logged, but only appended empty
+    // (see Disc::appendPages()), so they are written with a single write once
+    // they are committed. The type is locked exclusively, so no one reads
+    // them meanwhile.
+    const auto written = pageCount;
+    const bool logged = Wal::isOpen();
+
+    count += batchSlots.size();
+    batchValues.clear();
+    batchSlots.clear();
+    batchKeys.clear();
+    pageCount = 0;
+    cellCount = 0;
+    page.reset();
+    return commitStep(step, [&]() {
+      return !logged ||
+             BufferPool::writePages(typeName, firstLoc, written, batch.data());
+    });
+  };
+
+  while ((more = readBulkRecord(in, binary, values, suc))) {
+    if (indexed) {
+      vector<uint_t> rids;
+
+      if (!index.find(values[0], rids, 1) || !rids.empty() ||
+          !batchKeys.insert(values[0]).second) {
+        suc = false;
+        break;
+      }
+    }
+
+    // The cells are filled in order, so the first empty one is the next
+    // one, until the page is full (or, in the packed format, the record does
+    // not fit in it)
+    if (cellCount == 0) {
+      page.reset();
+    }
+
+    int cellIndex = layout.firstEmptySlot(page, values.data());
+
+    if (cellIndex < 0) {
+      memcpy(batch.data() + pageCount++ * Disc::pageSize, page.image(),
+             Disc::pageSize);
+      cellCount = 0;
+
+      if ((pageCount == BULK_LOAD_BATCH_PAGES ||
+           batchSlots.size() * indexCount >= BufferPool::FRAME_COUNT / 4) &&
+          !flush()) {
+        return false;
+      }
+
+      page.reset();
+      cellIndex = 0;
+    }
+
+    if (!layout.write(page, cellIndex, values.data())) {
+      return false;
+    }
+
+    ++cellCount;
+    batchValues.insert(batchValues.end(), values.begin(), values.end());
+    batchSlots.push_back({pageCount, uint_t(cellIndex)});
+  }
+
+  return flush() && suc;
+}
+
+/**
+ * Cuts the pages of a file after the given number off. The log is
+ * checkpointed first, so that the pages cannot be redone into the file, and
+ * the free-space map of the file forgets them.
+ *
+ * @param fileName The name of the file
+ * @param pageCount The number of the pages to be kept
+ * @return Success/failure
+ */
+static bool truncateFile(const string &fileName, uint_t pageCount) {
+  auto oldPageCount = Disc::getPageCount(fileName);
+
+  if (pageCount >= oldPageCount) return true;
+
+  if (!(commit() && checkpoint())) return false;
+
+  BufferPool::discardFile(fileName);
+
+  // The freed addresses are committed at once, so that no page takes them
+  // before the commit
+  return Disc::truncateFile(fileName, pageCount) && Disc::syncAll() &&
+         FreeSpaceMap::setFull(fileName, pageCount + 1,
+                               oldPageCount - pageCount, false) &&
+         commit();
+}
+
+bool vacuum(const string &typeName, uint_t maxPages, uint_t &freedPages,
+            bool &done) {
+  freedPages = 0;
+  done = false;
+
+  if (inTransaction()) return false;
+
+  // Each step is committed, and a commit waits for the writers of all the
+  // types, so they are kept out from the start
+  LockGuard database(LockManager::database(), Lock::SHARED);
+  LockGuard type(LockManager::of(typeName), Lock::EXCLUSIVE);
+  LockGuard step(LockManager::commits(), Lock::EXCLUSIVE);
+  auto schema = Catalogue::find(typeName);
+
+  if (!schema) return false;
+
+  const auto fieldCount = schema->fieldNames.size();
+  const auto format = schema->format;
+  const auto pageCount = Disc::getPageCount(typeName);
+  vector<sint_t> values(fieldCount);
+  vector<size_t> slots;
+  uint_t srcAddr = pageCount, emptied = 0;
+
+  while (srcAddr > 1) {
+    Page *src = new Page(typeName, srcAddr, Page::LATCH_EXCLUSIVE);
+
+    if (!(*src)) {
+      delete src;
+      return false;
+    }
+
+    // The empty pages at the end are only cut off
+    if (!src->isUsed() || src->liveCount() == 0) {
+      delete src;
+      --srcAddr;
+      continue;
+    }
+
+    if (maxPages && emptied == maxPages) {
+      delete src;
+      return true;
+    }
+
+    auto srcLayout = DataLayout::of(*src, fieldCount, format);
+    Page *dst = nullptr;
+    bool drained = true, suc = true;
+
+    slots.clear();
+    srcLayout.usedSlots(src->image(), slots);
+
+    for (auto slot : slots) {
+      int dstSlot = -1;
+
+      srcLayout.read(src->image(), slot, values.data());
+
+      // Find the first page before the source which has room for the record
+      while (suc) {
+        if (!dst) {
+          auto dstAddr = FreeSpaceMap::findPage(typeName);
+
+          if (!dstAddr || dstAddr >= srcAddr) break;
+
+          dst = new Page(typeName, dstAddr, Page::LATCH_EXCLUSIVE);
+
+          if (!(*dst)) {
+            suc = false;
+            break;
+          }
+        }
+
+        dstSlot = DataLayout::of(*dst, fieldCount, format)
+                      .firstEmptySlot(*dst, values.data());
+
+        if (dstSlot >= 0) break;
+
+        suc = dst->persist() &&
+              FreeSpaceMap::setFull(typeName, dst->getLocAddr(), true);
+        delete dst;
+        dst = nullptr;
+      }
+
+      if (!suc || dstSlot < 0) {
+        drained = false;
+        break;
+      }
+
+      srcLayout.erase(*src, slot);
+
+      if (!(DataLayout::of(*dst, fieldCount, format)
+                .write(*dst, dstSlot, values.data()) &&
+            updateIndexes(typeName, *schema, values,
+                          BTree::makeRid(srcAddr, slot), false) &&
+            updateIndexes(typeName, *schema, values,
+                          BTree::makeRid(dst->getLocAddr(), dstSlot), true))) {
+        suc = false;
+        break;
+      }
+    }
+
+    if (dst) {
+      suc = suc && dst->persist() &&
+            updateFreeSpace(typeName, *dst,
+                            DataLayout::of(*dst, fieldCount, format));
+      delete dst;
+    }
+
+    suc = suc && src->persist() &&
+          FreeSpaceMap::setFull(typeName, srcAddr, false);
+    delete src;
+
+    if (!(suc && commitStep(step))) return false;
+
+    if (!drained) break;
+
+    ++emptied;
+    --srcAddr;
+  }
+
+  done = true;
+  freedPages = pageCount - srcAddr;
+
+  return truncateFile(typeName, srcAddr);
+}
+
+bool vacuumCatalogue(uint_t &freedPages) {
+  if (inTransaction()) return false;
+
+  LockGuard lock(LockManager::database(), Lock::EXCLUSIVE);
+  const string fieldsFile = SYS_CATALOGUE_FIELDS_FILE_NAME;
+  const string typesFile = SYS_CATALOGUE_TYPES_FILE_NAME;
+  auto fieldPageCount = Disc::getPageCount(fieldsFile);
+  auto typePageCount = Disc::getPageCount(typesFile);
+  auto types = Catalogue::list();
+  uint_t lastField = fieldPageCount, lastType = typePageCount;
+
+  freedPages = 0;
+
+  // Each type has a whole page of field names, so the page of the type with
+  // the last page is moved into the first unused page
+  while (lastField > 1) {
+    {
+      Page last(fieldsFile, lastField, Page::LATCH_EXCLUSIVE);
+
+      if (!last) return false;
+
+      if (!last.isUsed()) {
+        --lastField;
+        continue;
+      }
+
+      auto holeAddr = FreeSpaceMap::findPage(fieldsFile);
+
+      if (!holeAddr || holeAddr >= lastField) break;
+
+      Page hole(fieldsFile, holeAddr, Page::LATCH_EXCLUSIVE);
+
+      if (!hole) return false;
+
+      if (hole.isUsed()) {
+        // The map was stale
+        if (!FreeSpaceMap::setFull(fieldsFile, holeAddr, true)) return false;
+
+        continue;
+      }
+
+      auto type = std::find_if(
+          types.begin(), types.end(),
+          [lastField](const pair<string, TypeSchema> &type) {
+            return type.second.fieldPageAddr == lastField;
+          });
+
+      if (type == types.end()) break;
+
+      auto schema = type->second;
+      Page typePage(typesFile, schema.typePageAddr, Page::LATCH_EXCLUSIVE);
+
+      if (!typePage) return false;
+
+      hole.reset();
+      hole.writeContent(last.content(), Page::contentSize());
+      hole.setCellUsed(0, true);
+      hole.setIsUsed(true);
+      hole.setPageCategory(PAGE_CATEGORY_FIELD_NAMES);
+      last.setIsUsed(false);
+      typePage.writeContent(reinterpret_cast<const char *>(&holeAddr),
+                            sizeof(uint_t),
+                            schema.typeCellIndex * TYPE_DATA_SIZE +
+                                TYPE_NAME_SIZE + sizeof(uint_t));
+
+      if (!(hole.persist() && last.persist() && typePage.persist() &&
+            FreeSpaceMap::setFull(fieldsFile, holeAddr, true) &&
+            FreeSpaceMap::setFull(fieldsFile, lastField, false))) {
+        return false;
+      }
+
+      schema.fieldPageAddr = holeAddr;
+      Catalogue::put(type->first, schema);
+    }
+
+    // Committed once the pages are unlatched, since a checkpoint which may
+    // follow writes them back
+    if (!commit()) return false;
+
+    --lastField;
+  }
+
+  // The cells of the types are not moved, since their order is the order of
+  // list_types; only the empty pages at the end are cut off
+  while (lastType > 1) {
+    Page last(typesFile, lastType);
+
+    if (!last) return false;
+
+    if (last.isUsed() && last.liveCount() > 0) break;
+
+    --lastType;
+  }
+
+  freedPages = fieldPageCount - lastField + typePageCount - lastType;
+
+  return truncateFile(fieldsFile, lastField) &&
+         truncateFile(typesFile, lastType);
+}
+
+/**
+ * Gives the number of the free extents of global addresses which fit in the
+ * general system catalogue.
+ */
+static uint_t maxFreeExtentCount() {
+  return (Page::contentSize() - GEN_CAT_FREE_EXTENTS_POS) /
+         (2 * sizeof(uint_t));
+}
+
+void persistGlobPageAddr() {
+  // The latch also keeps the threads which commit at once out of each other's
+  // way
+  Page genSysCat(SYS_CATALOGUE_GENERAL_FILE_NAME, 1, Page::LATCH_EXCLUSIVE);
+
+  if (genSysCat &&
+      genSysCat.getUIntAtPos(GEN_CAT_NEW_PAGE_ADDR_POS) == Disc::newPageAddr &&
+      !PageAllocator::modified) {
+    return;  // Already up to date
+  }
+
+  genSysCat.writeContent(reinterpret_cast<char *>(&Disc::newPageAddr),
+                         sizeof(uint_t), GEN_CAT_NEW_PAGE_ADDR_POS);
+
+  if (PageAllocator::modified) {
+    vector<uint_t> extents(2 * maxFreeExtentCount());
+    uint_t count = PageAllocator::save(extents.data(), maxFreeExtentCount());
+
+    genSysCat.writeContent(reinterpret_cast<char *>(&count), sizeof(uint_t),
+                           GEN_CAT_FREE_EXTENT_COUNT_POS);
+    genSysCat.writeContent(reinterpret_cast<char *>(extents.data()),
+                           2 * count * sizeof(uint_t),
+                           GEN_CAT_FREE_EXTENTS_POS);
+  }
+
+  genSysCat.persist();
+}
+
+bool checkpoint() {
+  LockGuard lock(LockManager::database(), Lock::SHARED);
+  LockGuard commits(LockManager::commits(), Lock::SHARED);
+
+  return Wal::sync() && BufferPool::flushAll() && Disc::syncAll() &&
+         Wal::truncate();
+}
+
+bool commit() {
+  auto transaction = Transaction::active();
+  bool applying = transaction && transaction->pageCount() > 0;
+
+  // A transaction is applied while no other operation runs, so that none of
+  // them sees it half applied
+  LockGuard lock(LockManager::database(),
+                 applying ? Lock::EXCLUSIVE : Lock::SHARED);
+  LockGuard commits(LockManager::commits(), Lock::SHARED);
+
+  if (transaction && !transaction->log()) return false;
+
+  persistGlobPageAddr();
+
+  if (!Wal::commit()) {
+    if (transaction) transaction->abort();
+
+    return false;
+  }
+
+  // Its pages are put in place only now, so none is written back before the
+  // commit record
+  if (transaction && !transaction->install()) return false;
+
+  return !Wal::needsCheckpoint() || checkpoint();
+}
+
+bool beginTransaction() {
+  auto transaction = Transaction::current();
+
+  return transaction && transaction->begin();
+}
+
+bool abortTransaction() {
+  auto transaction = Transaction::active();
+
+  if (!transaction) return false;
+
+  transaction->abort();
+  return true;
+}
+
+bool inTransaction() { return Transaction::active(); }
+
+void initGlobPageAddr() {
+  Page genSysCat(SYS_CATALOGUE_GENERAL_FILE_NAME, 1);
+
+  Disc::newPageAddr = genSysCat.getUIntAtPos(GEN_CAT_NEW_PAGE_ADDR_POS);
+  PageAllocator::load(
+      reinterpret_cast<const uint_t *>(genSysCat.content() +
+                                       GEN_CAT_FREE_EXTENTS_POS),
+      genSysCat.getUIntAtPos(GEN_CAT_FREE_EXTENT_COUNT_POS));
+}
+
+Disc::Backend defaultBackend() {
+  Page genSysCat(SYS_CATALOGUE_GENERAL_FILE_NAME, 1);
+
+  return Disc::Backend(genSysCat.getUIntAtPos(GEN_CAT_BACKEND_POS));
+}
+
+bool parseBackend(const vector<string> &args, Disc::Backend &backend) {
+  const string option = "--backend=";
+
+  for (size_t i = 1; i < args.size(); ++i) {
+    if (args[i].compare(0, option.size(), option) != 0) continue;
+
+    auto name = args[i].substr(option.size());
+
+    if (name == "pread") {
+      backend = Disc::BACKEND_PREAD;
+    } else if (name == "mmap") {
+      backend = Disc::BACKEND_MMAP;
+    } else {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool parseSize(const string &str, uint_t &size) {
+  // strtoull() would take a negative number modulo 2^64
+  if (str.empty() || !isdigit(static_cast<unsigned char>(str[0]))) {
+    return false;
+  }
+
+  char *end;
+  errno = 0;
+  size = strtoull(str.c_str(), &end, 10);
+
+  if (errno == ERANGE) return false;
+
+  uint_t shift = 0;
+
+  switch (*end) {
+    case 'G':
+    case 'g':
+      shift += 10;
+      // Fall through
+    case 'M':
+    case 'm':
+      shift += 10;
+      // Fall through
+    case 'K':
+    case 'k':
+      shift += 10;
+      ++end;
+  }
+
+  if (size > UINT64_MAX >> shift) return false;
+
+  size <<= shift;
+  return *end == '\0';
+}
+
+bool parseGeometry(const vector<string> &args, uint_t &pageSize,
+                   uint_t &maxPageCount) {
+  const string pageSizeOption = "--page-size=", capacityOption = "--capacity=";
+  string capacity;
+
+  for (size_t i = 1; i < args.size(); ++i) {
+    if (args[i].compare(0, pageSizeOption.size(), pageSizeOption) == 0) {
+      if (!parseSize(args[i].substr(pageSizeOption.size()), pageSize)) {
+        return false;
+      }
+    } else if (args[i].compare(0, capacityOption.size(), capacityOption) ==
+               0) {
+      capacity = args[i].substr(capacityOption.size());
+    }
+  }
+
+  // Only powers of two
+  if (pageSize < MIN_PAGE_SIZE || pageSize > MAX_PAGE_SIZE ||
+      (pageSize & (pageSize - 1))) {
+    return false;
+  }
+
+  uint_t bytes = DEFAULT_STORAGE_SIZE;
+
+  if (capacity == "unlimited") {
+    maxPageCount = 0;
+    return true;
+  }
+
+  if (!capacity.empty() && !parseSize(capacity, bytes)) {
+    return false;
+  }
+
+  // The system catalogues need a few pages
+  maxPageCount = bytes / pageSize;
+  return maxPageCount >= 8;
+}
+
+bool loadGeometry() {
+  ifstream in(SYS_CATALOGUE_GENERAL_FILE_NAME, ifstream::binary);
+  vector<char> prefix(MAX_PAGE_SIZE);
+
+  in.read(prefix.data(), prefix.size());
+
+  for (uint_t pageSize = MIN_PAGE_SIZE; pageSize <= MAX_PAGE_SIZE;
+       pageSize *= 2) {
+    auto content = prefix.data() + Page::headerSize(pageSize);
+
+    if (pageSize <= uint_t(in.gcount()) &&
+        *reinterpret_cast<const uint_t *>(content + GEN_CAT_PAGE_SIZE_POS) ==
+            pageSize) {
+      Disc::pageSize = pageSize;
+      Disc::maxPageCount = *reinterpret_cast<const uint_t *>(
+          content + GEN_CAT_MAX_PAGE_COUNT_POS);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void recoverGlobPageAddr(uint_t maxLoggedGlobAddr) {
+  vector<string> fileNames = {SYS_CATALOGUE_TYPES_FILE_NAME,
+                              SYS_CATALOGUE_FIELDS_FILE_NAME};
+
+  for (const auto &type : Catalogue::list()) {
+    fileNames.push_back(type.first);
+
+    // Including the index files left by a build which was interrupted
+    for (size_t i = 0; i < type.second.indexed.size(); ++i) {
+      auto indexFile = Catalogue::indexFileName(type.first, i);
+
+      if (type.second.indexed[i] || Disc::getPageCount(indexFile) > 0) {
+        fileNames.push_back(indexFile);
+      }
+    }
+  }
+
+  for (size_t i = 0, n = fileNames.size(); i < n; ++i) {
+    fileNames.push_back(FreeSpaceMap::mapFileName(fileNames[i]));
+  }
+
+  // Pages are appended at the ends of the files, and the addresses given to
+  // them since the last commit were free as of it. So, the pages appended
+  // since then are the last pages of each file whose addresses are free.
+  for (const auto &fileName : fileNames) {
+    for (auto locAddr = Disc::getPageCount(fileName); locAddr > 0; --locAddr) {
+      Page page(fileName, locAddr);
+
+      if (!(page && PageAllocator::isFree(page.globAddr()))) break;
+
+      PageAllocator::reserve(page.globAddr());
+    }
+  }
+
+  if (maxLoggedGlobAddr >= Disc::newPageAddr) {
+    PageAllocator::reserve(maxLoggedGlobAddr);
+  }
+}
@@ -0,0 +1,365 @@
+//
+// Created by Alper Çakan on 9.04.2018.
+//
+
+#ifndef STGMGR_STORAGEMANAGER_H
+#define STGMGR_STORAGEMANAGER_H
+
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Aggregate.h"
+#include "DataLayout.h"
+#include "Disc.h"
+#include "Record.h"
+#include "constants.h"
+
+/*
+ * The operations of the storage manager, shared by the console and the
+ * benchmark. Each operation which modifies the database is to be followed by
+ * commit(), unless it is run in a transaction (see beginTransaction()).
+ */
+
+/**
+ * Creates a type. The first field will be the primary key.
+ *
+ * @param typeName The name of the type to be created
+ * @param fieldNames The names of the fields. Must be nonempty, since at least
+ * the type must have a primary key.
+ * @param format The format of the data pages of the type
+ * @return Success/failure
+ */
+bool createType(const std::string &typeName,
+                const std::vector<std::string> &fieldNames,
+                DataLayout::Format format = DataLayout::FORMAT_ROW);
+
+/**
+ * Returns the list of the "matching" types
+ *
+ * @param all If true, all types will match. If false, only the type with the
+ * given name will match
+ * @param typeName The name of the type to be matched
+ * @return The vector of pairs (Type Name, The Names of the Fields in the Type)
+ */
+std::vector<std::pair<std::string, std::vector<std::string>>> getTypeList(
+    bool all = true, const std::string &typeName = "");
+
+/**
+ * Deletes a type.
+ *
+ * @param typeName The name of the type to be deleted
+ * @return Success/failure
+ */
+bool deleteType(const std::string &typeName);
+
+/**
+ * Formats the current directory to be an empty database.
+ *
+ * @param backend The default Disc backend of the database
+ * @param pageSize The page size of the database
+ * @param maxPageCount The largest number of pages of the database (0 if
+ * unlimited)
+ *
+ * Note that this operation may remove and/or overwrite your existing files.
+ * Therefore, it should be run only if the directory contains only the
+ * executable of this program.
+ */
+bool format(Disc::Backend backend, uint_t pageSize, uint_t maxPageCount);
+
+/**
+ * Creates a record.
+ *
+ * @param typeName The name of the type of the record to be created
+ * @param values The field values of the record to be created. There must be
+ * exactly one value for each field of the type.
+ * @return The pair (Glob. Page Addr., Loc. Page Addr.) for the page in which
+ * the newly created record is placed, or (0, 0) on failure. If the primary key
+ * is indexed, creating a record with an existing key is a failure.
+ */
+std::pair<uint_t, uint_t> createRecord(const std::string &typeName,
+                                       Record values);
+
+/**
+ * Searches for (and deletes) for a record or all records.
+ *
+ * If the primary key of the type is indexed, a specific record is looked up
+ * through the index instead of scanning the data file. Scans which do not
+ * delete are shared among several threads if the data file is large enough
+ * (see ParallelScan). Outside a transaction, deleting all the records may be
+ * committed in parts, like createIndex(), so that it never fills the buffer
+ * pool; if it fails, the records deleted before are gone.
+ *
+ * Can be used for:
+ * - Querying a specific record of a type
+ * - Deleting a specific record of a type
+ * - Deleting all records of a type
+ * - Querying all records of a type
+ *
+ * @param typeName The name of the type of the record(s) to be searched/deleted
+ * @param keyValue The key value of the record to be searched/deleted
+ * @param all If true, keyValue will be ignored and all records of the given
+ * type will "match"
+ * @param del If true, the matched records will be deleted
+ * @param suc A reference to a boolean variable. This will contain the
+ * success/failure status. Note that finding no matching records is not a
+ * failure.
+ * @param threadCount The number of threads to scan with
+ * @param ordered If false, the records may be given in any order
+ * @return The pair (Record Values, (Global Page Addr. of the Record), (Local
+ * Page Addr. of the Record)).
+ */
+std::pair<std::vector<std::vector<sint_t>>, std::pair<uint_t, uint_t>>
+searchRecord(const std::string &typeName, sint_t keyValue, bool all, bool del,
+             bool &suc, uint_t threadCount = 1, bool ordered = true);
+
+/**
+ * Gives all the records of a type to a callback as the pages are decoded,
+ * without collecting them. A serial scan keeps only the current page pinned;
+ * a parallel one keeps a window of chunks per thread in memory.
+ *
+ * @param typeName The name of the type
+ * @param onRecord Called with the field values and the pair (Glob. Page
+ * Addr., Loc. Page Addr.) of each record. The record is valid only during the
+ * call.
+ * @param threadCount The number of threads to scan with
+ * @param ordered If false, the records may be given in any order
+ * @return Success/failure
+ */
+bool listRecords(const std::string &typeName,
+                 const std::function<void(Record, std::pair<uint_t, uint_t>)>
+                     &onRecord,
+                 uint_t threadCount = 1, bool ordered = true);
+
+/**
+ * Creates the index on a field of a type from its existing records. The index
+ * maps the values of the field to the record ids of the records, and is kept
+ * in sync by createRecord(), searchRecord() and bulkLoad() afterwards. The
+ * index is used only once it is complete; it may be committed in parts while
+ * it is built.
+ *
+ * @param typeName The name of the type
+ * @param field The index of the field (0 for the primary key)
+ * @return Success/failure. For the primary key, fails if two records of the
+ * type have the same key.
+ */
+bool createIndex(const std::string &typeName, size_t field = 0);
+
+/**
+ * Searches for all the records whose given field has the given value. The
+ * index on the field is used if it exists; otherwise, the data file is
+ * scanned.
+ *
+ * @param typeName The name of the type
+ * @param field The index of the field
+ * @param value The value
+ * @param onRecord Called with the field values and the pair (Glob. Page Addr.,
+ * Loc. Page Addr.) of each found record, in the order of the data file
+ * @param threadCount The number of threads to scan with
+ * @return Success/failure. Finding no records is not a failure.
+ */
+bool searchBy(const std::string &typeName, size_t field, sint_t value,
+              const std::function<void(Record, std::pair<uint_t, uint_t>)>
+                  &onRecord,
+              uint_t threadCount = 1);
+
+/**
+ * Aggregates a field of all the records of a type, optionally grouped by
+ * another field. The values are accumulated while the data pages are scanned,
+ * into a hash table of the groups, so no record is materialized and the
+ * memory used depends on the number of groups only.
+ *
+ * @param typeName The name of the type
+ * @param field The index of the aggregated field
+ * @param groupField The index of the field to group by, or -1 for a single
+ * group of all the records
+ * @param groups A reference to a vector. The pairs (Group Value, Aggregate)
+ * will be stored here, in ascending order of the group value. Without
+ * grouping, there is exactly one pair, whose group value is 0.
+ * @param threadCount The number of threads to scan with
+ * @return Success/failure
+ */
+bool aggregate(const std::string &typeName, size_t field, int groupField,
+               std::vector<std::pair<sint_t, Aggregate>> &groups,
+               uint_t threadCount = 1);
+
+/**
+ * Loads records from a file into a type.
+ *
+ * The records are packed into whole data pages (in the format of the type) in
+ * memory, and the pages are appended to the data file
+ * BULK_LOAD_BATCH_PAGES at a time with a single write. The empty cells of the
+ * existing pages are not used.
+ *
+ * Loading stops at the first malformed record, or at the first duplicate key
+ * if the primary key is indexed. The records before it stay loaded. The
+ * records are committed in batches as they are loaded.
+ *
+ * @param typeName The name of the type of the records
+ * @param path The path of the input file. See readBulkRecord() for the format.
+ * @param binary Whether the input file is binary
+ * @param count A reference to an integer variable. This will contain the
+ * number of the loaded records.
+ * @param onRecord If not empty, called with the field values and the pair
+ * (Glob. Page Addr., Loc. Page Addr.) of each loaded record
+ * @return Success/failure
+ */
+bool bulkLoad(const std::string &typeName, const std::string &path,
+              bool binary, uint_t &count,
+              const std::function<void(Record, std::pair<uint_t, uint_t>)>
+                  &onRecord = nullptr);
+
+/**
+ * Compacts the data file of a type. The records of its last pages are moved
+ * into the empty cells of its first pages (and their index entries along
+ * with them), one page at a time, each move being committed. Then the empty
+ * pages at the end of the file are cut off, after a checkpoint.
+ *
+ * @param typeName The name of the type
+ * @param maxPages The most pages to be emptied by this call, or 0 for no
+ * limit. With a limit, the compaction can be done in small steps.
+ * @param freedPages A reference to an integer variable. This will contain
+ * the number of the pages cut off the file.
+ * @param done A reference to a boolean variable. This will be set to whether
+ * the file is compacted as much as it can be.
+ * @return Success/failure
+ */
+bool vacuum(const std::string &typeName, uint_t maxPages, uint_t &freedPages,
+            bool &done);
+
+/**
+ * Compacts the system catalogue. The pages of the field names of the types
+ * at the end of the fields catalogue are moved into the pages left unused by
+ * the deleted types, and the unused pages at the end of the fields and types
+ * catalogues are cut off, after a checkpoint.
+ *
+ * @param freedPages A reference to an integer variable. This will contain
+ * the number of the pages cut off the catalogue files.
+ * @return Success/failure
+ */
+bool vacuumCatalogue(uint_t &freedPages);
+
+/**
+ * Saves the global address of the next new page, and the free extents of
+ * PageAllocator if they have changed, to the general system catalogue.
+ */
+void persistGlobPageAddr();
+
+/**
+ * Writes all the modified pages back to their files and empties the
+ * write-ahead log.
+ *
+ * @return Success/failure
+ */
+bool checkpoint();
+
+/**
+ * Commits the changes made by a command to the write-ahead log. The commit
+ * becomes durable with the next sync of the log (see Wal::commit()).
+ *
+ * If the calling thread has an open transaction, the pages it has changed are
+ * logged first, once each, while no other operation runs, and the
+ * transaction is closed.
+ *
+ * @return Success/failure. A transaction fails to commit, and is aborted, if
+ * another operation has changed one of its pages since it did.
+ */
+bool commit();
+
+/**
+ * Opens a transaction in the calling thread (see Transaction). The record
+ * operations run until commit() or abortTransaction() are then committed
+ * together, or not at all: their changes are seen only by the thread until
+ * then, and each changed page is logged once, however many times it changes.
+ *
+ * The operations on the types themselves (createType(), deleteType(),
+ * createIndex(), bulkLoad(), vacuum() and the like) fail in a transaction,
+ * and the scans of the transaction are serial.
+ *
+ * @return Success/failure. Fails if a transaction is already open.
+ */
+bool beginTransaction();
+
+/**
+ * Drops the changes of the open transaction of the calling thread, and
+ * closes it.
+ *
+ * @return Success/failure. Fails if there is no open transaction.
+ */
+bool abortTransaction();
+
+/**
+ * Whether the calling thread has an open transaction.
+ */
+bool inTransaction();
+
+/**
+ * Reads the global address of the next new page and the free extents of
+ * PageAllocator from the general system catalogue.
+ */
+void initGlobPageAddr();
+
+/**
+ * Gives the default Disc backend of the database, which is chosen when
+ * formatting.
+ */
+Disc::Backend defaultBackend();
+
+/**
+ * Parses the value of a "--backend=<name>" option, if it exists among the
+ * given arguments.
+ *
+ * @param args The arguments of the program
+ * @param backend A reference to a variable. The backend will be stored here
+ * if the option exists.
+ * @return Success/failure. Failure means that the name is not valid.
+ */
+bool parseBackend(const std::vector<std::string> &args, Disc::Backend &backend);
+
+/**
+ * Parses a size in bytes, which may end with K, M or G.
+ *
+ * @param str The string
+ * @param size A reference to a variable. The size will be stored here.
+ * @return Success/failure. Fails if the string is not a non-negative number,
+ * or if the size does not fit in 64 bits.
+ */
+bool parseSize(const std::string &str, uint_t &size);
+
+/**
+ * Parses the "--page-size=<size>" and "--capacity=<size|unlimited>" options,
+ * if they exist among the given arguments.
+ *
+ * @param args The arguments of the program
+ * @param pageSize A reference to a variable. The page size will be stored here
+ * if the option exists.
+ * @param maxPageCount A reference to a variable. The largest number of pages
+ * (0 if unlimited) will be stored here.
+ * @return Success/failure. Failure means that a value is not valid.
+ */
+bool parseGeometry(const std::vector<std::string> &args, uint_t &pageSize,
+                   uint_t &maxPageCount);
+
+/**
+ * Reads the page size and the capacity of the database from the general
+ * system catalogue. Must be called before any page is read.
+ *
+ * Where these reside in the file depends on the size of the page header,
+ * which depends on the page size itself. Hence, each valid page size is
+ * tried, until one is found which is stored at its own position.
+ *
+ * @return Success/failure
+ */
+bool loadGeometry();
+
+/**
+ * Makes sure that no free global address is used by an existing page. After
+ * a crash, the pages appended since the last commit may have addresses which
+ * are free in the general system catalogue, or beyond the address of the
+ * next new page saved there.
+ *
+ * @param maxLoggedGlobAddr The largest global address seen during recovery
+ */
+void recoverGlobPageAddr(uint_t maxLoggedGlobAddr);
+
+#endif  // STGMGR_STORAGEMANAGER_H
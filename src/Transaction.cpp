@@ -0,0 +1,169 @@
+//
+// Created by Alper Çakan on 9.04.2018.
+//
+
+#include "Transaction.h"
+#include "BufferPool.h"
+#include "Catalogue.h"
+#include "Disc.h"
+#include "FreeSpaceMap.h"
+#include "LockManager.h"
+#include "Page.h"
+#include "Wal.h"
+
+#include <cstring>
+
+using std::string;
+
+/**
+ * The transaction made current by the innermost Scope of the thread, if
+ * there is one
+ */
+static thread_local Transaction *scoped = nullptr;
+static thread_local bool isScoped = false;
+
+Transaction::~Transaction() { abort(); }
+
+Transaction::Scope::Scope(Transaction *transaction)
+    : previous(scoped), wasScoped(isScoped) {
+  scoped = transaction;
+  isScoped = true;
+}
+
+Transaction::Scope::~Scope() {
+  scoped = previous;
+  isScoped = wasScoped;
+}
+
+Transaction *Transaction::current() {
+  static thread_local Transaction own;
+
+  return isScoped ? scoped : &own;
+}
+
+Transaction *Transaction::active() {
+  auto transaction = current();
+
+  return transaction && transaction->opened ? transaction : nullptr;
+}
+
+bool Transaction::begin() {
+  if (opened) return false;
+
+  opened = true;
+  return true;
+}
+
+bool Transaction::log() {
+  if (!opened) return false;
+
+  // From here on, the Page objects are of the pages in the buffer pool
+  opened = false;
+
+  for (const auto &page : pages) {
+    Page original(page.first.first, page.first.second);
+
+    if (!(original && original.lsn() == page.second.lsn)) {
+      unmarkFull();
+      pages.clear();
+      return false;
+    }
+  }
+
+  for (auto &page : pages) {
+    auto image = page.second.image.data();
+    auto lsn = Wal::appendPage(page.first.first, page.first.second, image);
+
+    if (!firstLsn) firstLsn = lsn;
+
+    if (!lsn) {
+      abort();
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool Transaction::install() {
+  bool suc = true;
+
+  for (const auto &page : pages) {
+    const auto &fileName = page.first.first;
+    auto image = page.second.image.data();
+    Page target(fileName, page.first.second, Page::LATCH_EXCLUSIVE);
+
+    // A page which finds no frame is committed, so it may be written back
+    if (!(target ? target.restore(image)
+                 : BufferPool::writePage(fileName, page.first.second, image))) {
+      suc = false;
+    }
+  }
+
+  pages.clear();
+  firstLsn = 0;
+  return suc;
+}
+
+void Transaction::abort() {
+  if (!opened && !firstLsn) return;
+
+  opened = false;
+
+  // The commit record of another operation would commit the logged pages
+  if (firstLsn) Wal::abort(firstLsn);
+
+  firstLsn = 0;
+  unmarkFull();
+  pages.clear();
+}
+
+void Transaction::unmarkFull() {
+  string fileName;
+  TypeLock lock;
+  bool isType = false;
+
+  for (const auto &page : pages) {
+    if (page.first.first != fileName) {
+      fileName = page.first.first;
+      lock = TypeLock();
+      lock = TypeLock(fileName, Lock::INTENT_EXCLUSIVE);
+      isType = Catalogue::find(fileName);
+    }
+
+    // The pages of the other files, i.e. the nodes of the indexes, are
+    // marked as full while they are used, so only the ones still unused as
+    // of the last commit are given back
+    if (!isType) {
+      Page original(fileName, page.first.second);
+
+      if (!original || original.isUsed()) continue;
+    }
+
+    FreeSpaceMap::setFull(fileName, page.first.second, false);
+  }
+}
+
+bool Transaction::isOpen() const { return opened; }
+
+size_t Transaction::pageCount() const { return pages.size(); }
+
+char *Transaction::find(const string &fileName, uint_t locPageAddr) {
+  auto it = pages.find({fileName, locPageAddr});
+
+  return it == pages.end() ? nullptr : it->second.image.data();
+}
+
+char *Transaction::keep(const string &fileName, uint_t locPageAddr,
+                        const char *image, uint_t lsn) {
+  auto &page = pages[{fileName, locPageAddr}];
+
+  if (page.image.empty()) {
+    page.image.assign(image, image + Disc::pageSize);
+    page.lsn = lsn;
+  } else if (page.image.data() != image) {
+    memcpy(page.image.data(), image, Disc::pageSize);
+  }
+
+  return page.image.data();
+}
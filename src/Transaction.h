@@ -0,0 +1,191 @@
+//
+// Created by Alper Çakan on 9.04.2018.
+//
+
+#ifndef STGMGR_TRANSACTION_H
+#define STGMGR_TRANSACTION_H
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "constants.h"
+
+/**
+ * An explicit transaction, which makes the operations run in it atomic.
+ *
+ * While a transaction is open, a page latched exclusively by its thread is
+ * copied, and the Page object works on the copy. When the copy is persisted,
+ * it is kept by the transaction instead of being logged, and the later Page
+ * objects of the page are served from it. The transaction thus sees its own
+ * changes, the other threads see none of them, and a page changed many times
+ * is kept (and later logged) once.
+ *
+ * At commit, log() appends all the kept pages to the log, then a single
+ * commit record follows them, so recovery redoes all or none of them, and
+ * only then install() puts them into the buffer pool, so no page of the
+ * transaction is written back before it is committed. All this happens while
+ * the database is locked exclusively (see ::commit()), so no other operation
+ * sees a part of the transaction. If the commit record cannot be appended,
+ * abort() drops the logged pages with an abort record.
+ *
+ * The transactions are optimistic: no lock is held between their operations,
+ * and a transaction is aborted at commit if one of its pages has been changed
+ * by another operation since it was copied (which the LSN of the page tells).
+ * The check is made on whole pages, not on records, so a change to any part
+ * of a page aborts the transaction, e.g. a record inserted by another thread
+ * into the same data page or index node, even if it is not one of the
+ * records of the transaction. Likewise, the pages which a transaction has
+ * not changed are read as last committed, so when another transaction
+ * commits a change to the pages of this one meanwhile, e.g. splits an index
+ * node into which this one has inserted, an operation of this one may not
+ * find its own changes; this one is then aborted at commit anyway.
+ *
+ * The pages appended to the files, and the free-space maps, which are only
+ * hints, are changed in place. An aborted transaction gives the pages it has
+ * appended or taken back to the free-space maps (see unmarkFull()), so they
+ * are used again, by the inserts for the data pages and by the splits for
+ * the index nodes (see BTree).
+ *
+ * Each thread has a transaction of its own, which is current unless Scope
+ * makes another one current, e.g. the one of a client of Server.
+ */
+class Transaction {
+ public:
+  Transaction() = default;
+
+  Transaction(const Transaction &) = delete;
+
+  Transaction &operator=(const Transaction &) = delete;
+
+  /**
+   * Aborts the transaction, if it is open.
+   */
+  ~Transaction();
+
+  /**
+   * Makes a transaction the current one of the calling thread from its
+   * construction to its destruction.
+   */
+  class Scope {
+   public:
+    /**
+     * @param transaction The transaction, or null for none, in which case the
+     * pages are changed in place
+     */
+    explicit Scope(Transaction *transaction);
+
+    Scope(const Scope &) = delete;
+
+    Scope &operator=(const Scope &) = delete;
+
+    ~Scope();
+
+   private:
+    Transaction *previous;
+    bool wasScoped;
+  };
+
+  /**
+   * Gives the current transaction of the calling thread, which may not be
+   * open.
+   *
+   * @return The transaction, or null if a Scope has made none current
+   */
+  static Transaction *current();
+
+  /**
+   * Gives the current transaction of the calling thread if it is open.
+   *
+   * @return The transaction, or null
+   */
+  static Transaction *active();
+
+  /**
+   * Opens the transaction.
+   *
+   * @return Success/failure. Fails if it is already open.
+   */
+  bool begin();
+
+  /**
+   * Closes the transaction and appends the kept pages to the log, each
+   * stamped with its LSN. The caller should hold the database lock
+   * exclusively, then append the commit record and call install(), or call
+   * abort() if the commit record cannot be appended (see ::commit()).
+   *
+   * @return Success/failure. If a page has been changed since it was copied,
+   * or no longer exists, nothing is logged and the transaction is aborted;
+   * if a page cannot be logged, the transaction is aborted as well.
+   */
+  bool log();
+
+  /**
+   * Puts the logged pages into the buffer pool, once the commit record
+   * follows them, and drops them.
+   *
+   * @return Success/failure. Fails if a page cannot be written; the
+   * transaction is committed nonetheless, and recovery redoes the page.
+   */
+  bool install();
+
+  /**
+   * Drops the kept pages and closes the transaction. The pages it may have
+   * marked as full in the free-space maps are unmarked. If the pages are
+   * already logged, an abort record drops them from the log.
+   */
+  void abort();
+
+  bool isOpen() const;
+
+  /**
+   * Gives the number of the kept pages.
+   */
+  size_t pageCount() const;
+
+  /**
+   * Gives the copy of a page kept by the transaction.
+   *
+   * @param fileName The name of the file in which the page resides
+   * @param locPageAddr The local address of the page
+   * @return The pointer to the first byte of the copy, or null if the page is
+   * not kept. The pointer stays valid until the transaction is closed.
+   */
+  char *find(const std::string &fileName, uint_t locPageAddr);
+
+  /**
+   * Keeps a copy of a page, in place of the copy kept before (if any).
+   *
+   * @param fileName The name of the file in which the page resides
+   * @param locPageAddr The local address of the page
+   * @param image The whole page
+   * @param lsn The LSN of the page when it was copied, which is checked at
+   * commit. Ignored if the page is already kept.
+   * @return The pointer to the first byte of the kept copy. See find().
+   */
+  char *keep(const std::string &fileName, uint_t locPageAddr,
+             const char *image, uint_t lsn);
+
+ private:
+  struct KeptPage {
+    std::vector<char> image;
+    uint_t lsn;
+  };
+
+  /**
+   * Unmarks the kept pages of the types as full in their free-space maps,
+   * since they may have been filled only by the transaction, and the kept
+   * pages of the indexes which are not used as of the last commit, since
+   * they have been taken as new nodes only by the transaction.
+   */
+  void unmarkFull();
+
+  /**
+   * The kept pages, in the order of their files and local addresses
+   */
+  std::map<std::pair<std::string, uint_t>, KeptPage> pages;
+  bool opened = false;
+  uint_t firstLsn = 0;  // The LSN of the first logged page, if any
+};
+
+#endif  // STGMGR_TRANSACTION_H
@@ -0,0 +1,372 @@
+//
+// Created by Alper Çakan on 9.04.2018.
+//
+
+#include "Wal.h"
+#include "Disc.h"
+#include "Page.h"
+#include "Stats.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+using std::lock_guard;
+using std::string;
+using std::vector;
+
+static const uint_t RECORD_MAGIC = 0x57414c5245434f52;  // "WALRECOR"
+
+std::mutex Wal::mutex;
+int Wal::fd = -1;
+vector<char> Wal::buffer;
+uint_t Wal::nextLsn = 1;
+uint_t Wal::durableLsn = 0;
+uint_t Wal::lastCommitLsn = 0;
+uint_t Wal::pendingCommits = 0;
+uint_t Wal::size = 0;
+
+/**
+ * FNV-1a over the given bytes, continuing from the given hash.
+ */
+static uint_t checksum(const char *data, size_t len,
+                       uint_t hash = 14695981039346656037ULL) {
+  for (size_t i = 0; i < len; ++i) {
+    hash = (hash ^ uint8_t(data[i])) * 1099511628211ULL;
+  }
+
+  return hash;
+}
+
+/**
+ * Writes the whole buffer at the given offset of a file.
+ */
+static bool writeAll(int fd, const char *data, size_t len, off_t off) {
+  while (len > 0) {
+    auto n = pwrite(fd, data, len, off);
+
+    if (n <= 0) return false;
+
+    data += n;
+    len -= n;
+    off += n;
+  }
+
+  return true;
+}
+
+/**
+ * Creates (or empties) the log file, leaving only the header which holds the
+ * LSN of the first record to be appended.
+ */
+static int createLogFile(uint_t firstLsn) {
+  int fd = ::open(WAL_FILE_NAME, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+  if (fd < 0) return -1;
+
+  if (!writeAll(fd, reinterpret_cast<const char *>(&firstLsn), sizeof(uint_t),
+                0) ||
+      fdatasync(fd) != 0) {
+    ::close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+bool Wal::recover(uint_t &maxGlobAddr) {
+  maxGlobAddr = 0;
+  int rfd = ::open(WAL_FILE_NAME, O_RDONLY);
+
+  if (rfd < 0) {
+    return true;  // Nothing to redo
+  }
+
+  struct stat st;
+  vector<char> log;
+
+  if (fstat(rfd, &st) == 0) {
+    log.resize(st.st_size);
+
+    size_t read = 0;
+
+    while (read < log.size()) {
+      auto n = pread(rfd, log.data() + read, log.size() - read, read);
+
+      if (n <= 0) break;
+
+      read += n;
+    }
+
+    log.resize(read);
+  }
+
+  ::close(rfd);
+
+  if (log.size() >= sizeof(uint_t)) {
+    nextLsn = std::max(nextLsn, *reinterpret_cast<const uint_t *>(log.data()));
+  }
+
+  // Find the end of the last commit record which is intact, together with
+  // all the records before it, and the ranges of LSNs which are aborted
+  size_t pos = sizeof(uint_t), committedEnd = pos;
+  vector<std::pair<uint_t, uint_t>> aborted;
+
+  while (pos + sizeof(RecordHeader) <= log.size()) {
+    RecordHeader header;
+    memcpy(&header, log.data() + pos, sizeof(RecordHeader));
+
+    auto bodyLen = header.nameLen + header.payloadLen;
+
+    if (header.magic != RECORD_MAGIC ||
+        bodyLen > log.size() - pos - sizeof(RecordHeader)) {
+      break;
+    }
+
+    auto body = log.data() + pos + sizeof(RecordHeader);
+    auto sum = header.checksum;
+    header.checksum = 0;
+
+    if (checksum(body, bodyLen,
+                 checksum(reinterpret_cast<const char *>(&header),
+                          sizeof(RecordHeader))) != sum) {
+      break;
+    }
+
+    pos += sizeof(RecordHeader) + bodyLen;
+    nextLsn = std::max(nextLsn, header.lsn + 1);
+
+    if (header.type == RECORD_COMMIT) {
+      committedEnd = pos;
+    } else if (header.type == RECORD_ABORT) {
+      aborted.emplace_back(header.locPageAddr, header.lsn);
+    }
+  }
+
+  // Redo
+  vector<char> diskPage(Disc::pageSize);
+
+  for (pos = sizeof(uint_t); pos < committedEnd;) {
+    RecordHeader header;
+    memcpy(&header, log.data() + pos, sizeof(RecordHeader));
+
+    string fileName(log.data() + pos + sizeof(RecordHeader), header.nameLen);
+    auto payload = log.data() + pos + sizeof(RecordHeader) + header.nameLen;
+    pos += sizeof(RecordHeader) + header.nameLen + header.payloadLen;
+
+    bool isAborted = false;
+
+    for (const auto &range : aborted) {
+      if (header.lsn >= range.first && header.lsn < range.second) {
+        isAborted = true;
+      }
+    }
+
+    if (isAborted) {
+      continue;
+    } else if (header.type == RECORD_REMOVE) {
+      Disc::removeFile(fileName);
+    } else if (header.type == RECORD_PAGE) {
+      maxGlobAddr = std::max(maxGlobAddr, Page::globAddrOf(payload));
+
+      if (Disc::getPageCount(fileName) >= header.locPageAddr &&
+          Disc::readPage(fileName, header.locPageAddr, diskPage.data()) &&
+          Page::lsnOf(diskPage.data()) >= header.lsn) {
+        continue;  // The page on the disc is already up to date
+      }
+
+      if (!Disc::restorePage(fileName, header.locPageAddr, payload)) {
+        return false;
+      }
+    }
+  }
+
+  return Disc::syncAll() && truncate();
+}
+
+bool Wal::open() {
+  lock_guard<std::mutex> guard(mutex);
+
+  if (fd >= 0) return true;
+
+  fd = ::open(WAL_FILE_NAME, O_RDWR | O_CREAT, 0644);
+
+  if (fd < 0) return false;
+
+  struct stat st;
+
+  if (fstat(fd, &st) != 0) {
+    ::close(fd);
+    fd = -1;
+    return false;
+  }
+
+  size = st.st_size;
+
+  if (size < sizeof(uint_t)) {
+    ::close(fd);
+
+    if ((fd = createLogFile(nextLsn)) < 0) return false;
+
+    size = sizeof(uint_t);
+  }
+
+  durableLsn = nextLsn - 1;
+  lastCommitLsn = nextLsn - 1;
+  return true;
+}
+
+void Wal::close() {
+  lock_guard<std::mutex> guard(mutex);
+
+  if (fd < 0) return;
+
+  syncLog();
+  ::close(fd);
+  fd = -1;
+}
+
+bool Wal::isOpen() {
+  lock_guard<std::mutex> guard(mutex);
+
+  return fd >= 0;
+}
+
+uint_t Wal::append(RecordType type, const string &fileName,
+                   uint_t locPageAddr, const char *payload,
+                   uint_t payloadLen) {
+  RecordHeader header = {RECORD_MAGIC, type,        nextLsn, locPageAddr,
+                         fileName.size(), payloadLen, 0};
+
+  header.checksum =
+      checksum(payload, payloadLen,
+               checksum(fileName.data(), fileName.size(),
+                        checksum(reinterpret_cast<const char *>(&header),
+                                 sizeof(RecordHeader))));
+
+  auto headerBytes = reinterpret_cast<const char *>(&header);
+  auto start = buffer.size();
+  buffer.insert(buffer.end(), headerBytes, headerBytes + sizeof(RecordHeader));
+  buffer.insert(buffer.end(), fileName.begin(), fileName.end());
+  buffer.insert(buffer.end(), payload, payload + payloadLen);
+
+  // The records before it stay in the buffer, to be written by a later try
+  if (buffer.size() >= WAL_BUFFER_SIZE && !writeBuffer()) {
+    buffer.resize(start);
+    return 0;
+  }
+
+  return nextLsn++;
+}
+
+uint_t Wal::appendPage(const string &fileName, uint_t locPageAddr,
+                       char *page) {
+  lock_guard<std::mutex> guard(mutex);
+
+  if (fd < 0) return 0;
+
+  Page::setLsnOf(page, nextLsn);
+
+  return append(RECORD_PAGE, fileName, locPageAddr, page, Disc::pageSize);
+}
+
+bool Wal::appendRemove(const string &fileName) {
+  lock_guard<std::mutex> guard(mutex);
+
+  return fd >= 0 && append(RECORD_REMOVE, fileName, 0, nullptr, 0);
+}
+
+bool Wal::commit() {
+  lock_guard<std::mutex> guard(mutex);
+
+  if (fd < 0) return false;
+
+  auto lsn = append(RECORD_COMMIT, "", 0, nullptr, 0);
+
+  if (!lsn) return false;
+
+  lastCommitLsn = lsn;
+  return ++pendingCommits < WAL_GROUP_COMMIT_SIZE || syncLog();
+}
+
+bool Wal::abort(uint_t firstLsn) {
+  lock_guard<std::mutex> guard(mutex);
+
+  return fd >= 0 && append(RECORD_ABORT, "", firstLsn, nullptr, 0);
+}
+
+bool Wal::writeBuffer() {
+  if (buffer.empty()) return true;
+
+  if (!writeAll(fd, buffer.data(), buffer.size(), size)) return false;
+
+  Stats::add(Stats::WAL_BYTES, buffer.size());
+  size += buffer.size();
+  buffer.clear();
+  return true;
+}
+
+bool Wal::sync() {
+  lock_guard<std::mutex> guard(mutex);
+
+  return syncLog();
+}
+
+bool Wal::syncLog() {
+  if (fd < 0) return true;
+
+  if (durableLsn + 1 == nextLsn) return true;  // Nothing new
+
+  if (!writeBuffer() || fdatasync(fd) != 0) return false;
+
+  Stats::add(Stats::WAL_SYNCS);
+  durableLsn = nextLsn - 1;
+  pendingCommits = 0;
+  return true;
+}
+
+uint_t Wal::committedLsn() {
+  lock_guard<std::mutex> guard(mutex);
+
+  return fd >= 0 ? lastCommitLsn : UINT64_MAX;
+}
+
+bool Wal::flush(uint_t lsn) {
+  lock_guard<std::mutex> guard(mutex);
+
+  return lsn <= durableLsn || syncLog();
+}
+
+bool Wal::needsCheckpoint() {
+  lock_guard<std::mutex> guard(mutex);
+
+  return fd >= 0 && size + buffer.size() >= WAL_CHECKPOINT_SIZE;
+}
+
+bool Wal::truncate() {
+  lock_guard<std::mutex> guard(mutex);
+  bool wasOpen = fd >= 0;
+
+  if (wasOpen) {
+    if (!syncLog()) return false;
+
+    ::close(fd);
+  }
+
+  fd = createLogFile(nextLsn);
+
+  if (fd < 0) return false;
+
+  size = sizeof(uint_t);
+  durableLsn = nextLsn - 1;
+
+  if (!wasOpen) {
+    ::close(fd);
+    fd = -1;
+  }
+
+  return true;
+}
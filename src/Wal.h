@@ -0,0 +1,182 @@
+//
+// Created by Alper Çakan on 9.04.2018.
+//
+
+#ifndef STGMGR_WAL_H
+#define STGMGR_WAL_H
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include "constants.h"
+
+/**
+ * The write-ahead log.
+ *
+ * Every page which is persisted while the log is open is appended to the
+ * log as a whole page image, stamped with a log sequence number (LSN) which
+ * is also stored in the page header. The page itself is written back to its
+ * file lazily, but never before the log is durable up to the LSN of the page,
+ * nor before a commit record follows its record (see BufferPool), since
+ * recovery only redoes.
+ *
+ * Commits are grouped: a commit only appends a commit record, and the log is
+ * synced to the disc once WAL_GROUP_COMMIT_SIZE commits are pending, when the
+ * log buffer is full, or when sync() is called explicitly.
+ *
+ * On startup, recover() redoes the page images of all the committed records
+ * whose LSN is newer than the LSN of the page on the disc, except those which
+ * an abort record has dropped.
+ *
+ * The functions other than recover() may be called by several threads at
+ * once; they are serialized by a mutex. A commit record commits all the
+ * records before it, so ::commit() waits for the operations which are
+ * appending records to finish first (see LockManager).
+ */
+class Wal {
+ public:
+  /**
+   * Redoes the committed records of the log and empties the log. Must be
+   * called before open().
+   *
+   * @param maxGlobAddr A reference to an integer variable. This will contain
+   * the largest global page address seen in the redone records (or 0).
+   * @return Success/failure
+   */
+  static bool recover(uint_t &maxGlobAddr);
+
+  /**
+   * Opens the log for appending.
+   *
+   * @return Success/failure
+   */
+  static bool open();
+
+  /**
+   * Syncs and closes the log.
+   */
+  static void close();
+
+  static bool isOpen();
+
+  /**
+   * Appends the image of a page to the log. The new LSN is written into the
+   * header of the page before the image is copied.
+   *
+   * @param fileName The name of the file in which the page resides
+   * @param locPageAddr The local address of the page
+   * @param page The whole page
+   * @return The LSN of the record, or 0 on failure
+   */
+  static uint_t appendPage(const std::string &fileName, uint_t locPageAddr,
+                           char *page);
+
+  /**
+   * Appends a record telling that a file is removed.
+   *
+   * @param fileName The name of the file
+   * @return Success/failure
+   */
+  static bool appendRemove(const std::string &fileName);
+
+  /**
+   * Appends a commit record. The log is synced if enough commits are
+   * pending.
+   *
+   * @return Success/failure
+   */
+  static bool commit();
+
+  /**
+   * Appends an abort record, which drops the records from the given LSN on,
+   * so that a later commit record does not commit them. Used when some of
+   * the records of a transaction are appended but its commit record is not;
+   * no record of another operation may be appended in between.
+   *
+   * @param firstLsn The LSN of the first record to drop
+   * @return Success/failure
+   */
+  static bool abort(uint_t firstLsn);
+
+  /**
+   * Gives the LSN of the last commit record, which commits all the records
+   * before it. While the log is closed, nothing is logged, so every page
+   * counts as committed.
+   */
+  static uint_t committedLsn();
+
+  /**
+   * Writes the log buffer to the log file and syncs the log file.
+   *
+   * @return Success/failure
+   */
+  static bool sync();
+
+  /**
+   * Makes sure that the log is durable up to the given LSN.
+   *
+   * @param lsn The LSN
+   * @return Success/failure
+   */
+  static bool flush(uint_t lsn);
+
+  /**
+   * Checks whether the log has grown enough that it should be emptied with a
+   * checkpoint.
+   */
+  static bool needsCheckpoint();
+
+  /**
+   * Empties the log. Must be called only after all the pages in the log are
+   * written back to their files and synced.
+   *
+   * @return Success/failure
+   */
+  static bool truncate();
+
+ private:
+  enum RecordType : uint_t {
+    RECORD_PAGE = 1,
+    RECORD_REMOVE,
+    RECORD_COMMIT,
+    RECORD_ABORT  // locPageAddr holds the LSN of the first dropped record
+  };
+
+  struct RecordHeader {
+    uint_t magic;
+    uint_t type;
+    uint_t lsn;
+    uint_t locPageAddr;
+    uint_t nameLen;
+    uint_t payloadLen;
+    uint_t checksum;
+  };
+
+  /**
+   * Appends a record to the buffer. If the buffer has to be written and
+   * cannot be, the record is taken back out of it.
+   *
+   * @return The LSN of the record, or 0 on failure
+   */
+  static uint_t append(RecordType type, const std::string &fileName,
+                       uint_t locPageAddr, const char *payload,
+                       uint_t payloadLen);
+
+  static bool writeBuffer();
+
+  /**
+   * Like sync(), for a caller which holds the mutex.
+   */
+  static bool syncLog();
+
+  static std::mutex mutex;
+  static int fd;
+  static std::vector<char> buffer;
+  static uint_t nextLsn;
+  static uint_t durableLsn;
+  static uint_t lastCommitLsn;
+  static uint_t pendingCommits;
+  static uint_t size;  // Bytes in the log file
+};
+
+#endif  // STGMGR_WAL_H
@@ -0,0 +1,519 @@
+//
+// Created by Alper Çakan on 9.04.2018.
+//
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "BufferPool.h"
+#include "Catalogue.h"
+#include "DataLayout.h"
+#include "Disc.h"
+#include "FreeSpaceMap.h"
+#include "ParallelScan.h"
+#include "Stats.h"
+#include "StorageManager.h"
+#include "Wal.h"
+
+using namespace std;
+
+#define BENCH_TYPE_NAME "bench"
+
+#define BENCH_HELP_MESSAGE \
+  "Storage Manager Benchmark\n\
+\n\
+Runs workloads against a freshly formatted DB and prints one JSON object per\n\
+run, with the throughput, the latencies and the I/O counters of the run.\n\
+\n\
+Usage: ./stgmgr_bench [<option>...]\n\
+\n\
+Options:\n\
+    --workload=<name,...>   seq_insert, rand_insert, point_hit, point_miss,\n\
+                            scan and/or mixed (default: all of them)\n\
+    --fields=<n,...>        Field counts of the type (default: 4)\n\
+    --records=<n,...>       Records in the type (default: 10000)\n\
+    --ops=<n>               Operations of the lookup and mixed workloads\n\
+                            (default: 1000)\n\
+    --scans=<n>             Full scans of the scan workload (default: 5)\n\
+    --read-ratio=<r,...>    Fractions of lookups in the mixed workload; the\n\
+                            rest are inserts (default: 0.9)\n\
+    --index                 Creates the primary key index of the type\n\
+    --layout=<row|pax|packed>\n\
+                            The format of the data pages (default: row)\n\
+    --threads=<n>           Threads of the scans (default: as the console)\n\
+    --clients=<n>           Threads which run the measured operations at\n\
+                            once, each its share of them (default: 1)\n\
+    --batch=<n>             Measured operations run in a transaction and\n\
+                            committed together (default: 1). Only with a\n\
+                            single client, whose transactions never conflict.\n\
+    --seed=<n>              Seed of the random keys (default: 42)\n\
+    --dir=<path>            The directory of the DB (default: bench_db). It\n\
+                            is formatted, so it must not hold a DB to keep.\n\
+    --backend=<pread|mmap>, --page-size=<size>, --capacity=<size|unlimited>\n\
+                            As with ./stgmgr --format (the default capacity\n\
+                            is unlimited)\n\
+"
+
+/**
+ * The parameters of a benchmark run.
+ */
+struct Workload {
+  string name;
+  size_t fieldCount;
+  uint_t recordCount;
+
+  /**
+   * The number of measured operations. For the insert workloads, it is the
+   * number of records.
+   */
+  uint_t opCount;
+
+  /**
+   * The fraction of lookups among the operations of the mixed workload
+   */
+  double readRatio;
+
+  bool indexed;
+  DataLayout::Format format;
+  uint_t threadCount;
+
+  /**
+   * The number of threads which run the measured operations
+   */
+  uint_t clientCount;
+
+  /**
+   * The number of measured operations committed together
+   */
+  uint_t batchSize;
+
+  uint_t seed;
+};
+
+/**
+ * Gives the value of an option of the form "<option><value>", if it exists
+ * among the given arguments.
+ *
+ * @param args The arguments of the program
+ * @param option The option, including the "="
+ * @param value A reference to a variable. The value will be stored here if the
+ * option exists.
+ * @return Whether the option exists
+ */
+bool optionValue(const vector<string> &args, const string &option,
+                 string &value) {
+  for (size_t i = 1; i < args.size(); ++i) {
+    if (args[i].compare(0, option.size(), option) == 0) {
+      value = args[i].substr(option.size());
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/**
+ * Parses a comma separated list of values.
+ *
+ * @param str The string
+ * @param values A reference to a vector. The values will be stored here.
+ * @return Success/failure
+ */
+template <typename T>
+bool parseList(const string &str, vector<T> &values) {
+  istringstream ss(str);
+  string item;
+
+  values.clear();
+
+  while (getline(ss, item, ',')) {
+    istringstream itemSs(item);
+    T value;
+
+    if (!(itemSs >> value) || !itemSs.eof()) return false;
+
+    values.push_back(value);
+  }
+
+  return !values.empty();
+}
+
+/**
+ * Gives the field values of the record with the given primary key.
+ */
+vector<sint_t> recordOf(sint_t key, size_t fieldCount) {
+  vector<sint_t> values(fieldCount);
+
+  for (size_t i = 0; i < fieldCount; ++i) {
+    values[i] = key + sint_t(i);
+  }
+
+  return values;
+}
+
+/**
+ * Creates the record with the given primary key, and commits it unless a
+ * transaction is open.
+ *
+ * @return Success/failure
+ */
+bool insert(sint_t key, size_t fieldCount) {
+  auto pageNumber = createRecord(BENCH_TYPE_NAME, recordOf(key, fieldCount));
+
+  return pageNumber.first != 0 && (inTransaction() || commit());
+}
+
+/**
+ * Searches for the record with the given primary key.
+ *
+ * @param key The primary key
+ * @param threadCount The number of threads to scan with
+ * @param found A reference to a boolean variable. This will be set to whether
+ * the record exists.
+ * @return Success/failure
+ */
+bool lookup(sint_t key, uint_t threadCount, bool &found) {
+  bool suc;
+  auto res =
+      searchRecord(BENCH_TYPE_NAME, key, false, false, suc, threadCount);
+
+  found = !res.first.empty();
+  return suc && (inTransaction() || commit());
+}
+
+/**
+ * Runs a workload against a fresh type, and prints its results as a JSON
+ * object on a line.
+ *
+ * @param w The workload
+ * @param out The stream to print to
+ * @return Success/failure
+ */
+bool run(const Workload &w, ostream &out) {
+  vector<string> fieldNames;
+
+  for (size_t i = 0; i < w.fieldCount; ++i) {
+    fieldNames.push_back("f" + to_string(i));
+  }
+
+  if (!(createType(BENCH_TYPE_NAME, fieldNames, w.format) &&
+        (!w.indexed || createIndex(BENCH_TYPE_NAME)) && commit())) {
+    return false;
+  }
+
+  mt19937_64 rng(w.seed);
+  const bool insertOnly = w.name == "seq_insert" || w.name == "rand_insert";
+  vector<sint_t> keys;
+
+  // The records which are not inserted by the workload itself are loaded
+  // before the measurement
+  for (uint_t i = 0; !insertOnly && i < w.recordCount; ++i) {
+    if (!insert(i, w.fieldCount)) return false;
+  }
+
+  if (insertOnly) {
+    for (uint_t i = 0; i < w.recordCount; ++i) keys.push_back(i);
+
+    if (w.name == "rand_insert") shuffle(keys.begin(), keys.end(), rng);
+  }
+
+  if (!Wal::sync()) return false;
+
+  Stats::reset();
+
+  const uint_t opCount = insertOnly ? w.recordCount : w.opCount;
+  vector<Stats::Histogram> latencies(w.clientCount);
+  atomic<bool> failed(false);
+
+  // Runs the operations i with i % clientCount == client. The first client
+  // goes on with the random numbers of the setup, so a single client runs
+  // the same operations as ever.
+  auto runClient = [&](uint_t client) {
+    mt19937_64 clientRng(w.seed + client);
+    auto &random = client == 0 ? rng : clientRng;
+    uint_t inserted = 0;  // The records inserted by this client
+
+    // The keys of the records loaded before, then of the ones this client
+    // has inserted, so that a lookup never looks for a record of another
+    // client which may not be created yet
+    auto keyOf = [&](uint_t n) -> sint_t {
+      return n < w.recordCount
+                 ? n
+                 : w.recordCount + (n - w.recordCount) * w.clientCount + client;
+    };
+
+    for (uint_t i = client; i < opCount && !failed; i += w.clientCount) {
+      auto opStart = chrono::steady_clock::now();
+      bool suc = true, found = true;
+
+      if (w.batchSize > 1 && i % w.batchSize == 0 && !beginTransaction()) {
+        failed = true;
+        return;
+      }
+
+      if (insertOnly) {
+        suc = insert(keys[i], w.fieldCount);
+      } else if (w.name == "point_hit") {
+        suc = lookup(random() % w.recordCount, w.threadCount, found);
+      } else if (w.name == "point_miss") {
+        suc = lookup(w.recordCount + random() % w.recordCount, w.threadCount,
+                     found);
+        found = !found;
+      } else if (w.name == "scan") {
+        uint_t count = 0;
+        suc = listRecords(
+            BENCH_TYPE_NAME,
+            [&count](Record, pair<uint_t, uint_t>) { ++count; },
+            w.threadCount);
+        found = count == w.recordCount;
+      } else if (w.name == "mixed") {
+        if (uniform_real_distribution<double>()(random) < w.readRatio) {
+          suc = lookup(keyOf(random() % (w.recordCount + inserted)),
+                       w.threadCount, found);
+        } else {
+          suc = insert(keyOf(w.recordCount + inserted++), w.fieldCount);
+        }
+      }
+
+      // The last operation of a batch commits it
+      if (suc && inTransaction() &&
+          (i % w.batchSize == w.batchSize - 1 || i + 1 == opCount)) {
+        suc = commit();
+      }
+
+      // A lookup which gives an unexpected answer means the storage is
+      // broken
+      if (!(suc && found)) {
+        failed = true;
+        return;
+      }
+
+      latencies[client].record(chrono::duration_cast<chrono::nanoseconds>(
+                                   chrono::steady_clock::now() - opStart)
+                                   .count());
+    }
+  };
+
+  auto start = chrono::steady_clock::now();
+  vector<thread> clients;
+
+  for (uint_t c = 1; c < w.clientCount; ++c) {
+    clients.emplace_back(runClient, c);
+  }
+
+  runClient(0);
+
+  for (auto &client : clients) {
+    client.join();
+  }
+
+  for (uint_t c = 1; c < w.clientCount; ++c) {
+    latencies[0].merge(latencies[c]);
+  }
+
+  if (failed || !Wal::sync()) return false;
+
+  double seconds =
+      chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+  out << "{\"workload\": \"" << w.name << "\", \"fields\": " << w.fieldCount
+      << ", \"records\": " << w.recordCount << ", \"ops\": " << opCount;
+
+  if (w.name == "mixed") out << ", \"read_ratio\": " << w.readRatio;
+
+  out << ", \"layout\": \"" << DataLayout::formatName(w.format)
+      << "\", \"indexed\": " << (w.indexed ? "true" : "false")
+      << ", \"threads\": " << w.threadCount
+      << ", \"clients\": " << w.clientCount
+      << ", \"batch\": " << w.batchSize << ", \"backend\": \""
+      << (Disc::backend == Disc::BACKEND_MMAP ? "mmap" : "pread")
+      << "\", \"page_size\": " << Disc::pageSize << ", \"seed\": " << w.seed
+      << ", \"seconds\": " << seconds
+      << ", \"throughput\": " << (seconds > 0 ? opCount / seconds : 0)
+      << ", \"latency_ns\": {\"mean\": "
+      << (opCount ? latencies[0].sum / opCount : 0)
+      << ", \"p50\": " << latencies[0].percentile(0.5)
+      << ", \"p99\": " << latencies[0].percentile(0.99)
+      << ", \"max\": " << latencies[0].max << "}, \"io\": {";
+
+  for (int i = 0; i < Stats::COUNTER_COUNT; ++i) {
+    auto counter = Stats::Counter(i);
+    out << (i ? ", " : "") << "\"" << Stats::name(counter)
+        << "\": " << Stats::get(counter);
+  }
+
+  out << "}}" << endl;
+
+  return deleteType(BENCH_TYPE_NAME) && commit();
+}
+
+/**
+ * The entry point.
+ */
+int main(int argc, char *argv[]) {
+  vector<string> args(argv, argv + argc);
+  vector<string> workloadNames = {"seq_insert", "rand_insert", "point_hit",
+                                  "point_miss", "scan",        "mixed"};
+  vector<size_t> fieldCounts = {4};
+  vector<uint_t> recordCounts = {10000};
+  vector<double> readRatios = {0.9};
+  uint_t opCount = 1000, scanCount = 5, seed = 42, clientCount = 1,
+         batchSize = 1, threadCount = ParallelScan::defaultThreadCount();
+  uint_t pageSize = DEFAULT_PAGE_SIZE, maxPageCount;
+  auto backend = Disc::BACKEND_PREAD;
+  auto layout = DataLayout::FORMAT_ROW;
+  string value, dir = "bench_db";
+  bool suc = true;
+
+  if (!optionValue(args, "--capacity=", value)) {
+    args.push_back("--capacity=unlimited");
+  }
+
+  if (optionValue(args, "--workload=", value)) {
+    suc = parseList(value, workloadNames);
+
+    for (const auto &name : workloadNames) {
+      if (name != "seq_insert" && name != "rand_insert" &&
+          name != "point_hit" && name != "point_miss" && name != "scan" &&
+          name != "mixed") {
+        suc = false;
+      }
+    }
+  }
+
+  if (optionValue(args, "--fields=", value)) {
+    suc = suc && parseList(value, fieldCounts);
+  }
+
+  if (optionValue(args, "--records=", value)) {
+    suc = suc && parseList(value, recordCounts);
+  }
+
+  if (optionValue(args, "--read-ratio=", value)) {
+    suc = suc && parseList(value, readRatios);
+  }
+
+  if (optionValue(args, "--ops=", value)) {
+    suc = suc && (istringstream(value) >> opCount);
+  }
+
+  if (optionValue(args, "--scans=", value)) {
+    suc = suc && (istringstream(value) >> scanCount);
+  }
+
+  if (optionValue(args, "--threads=", value)) {
+    suc = suc && (istringstream(value) >> threadCount) && threadCount > 0;
+  }
+
+  if (optionValue(args, "--clients=", value)) {
+    suc = suc && (istringstream(value) >> clientCount) && clientCount > 0;
+  }
+
+  if (optionValue(args, "--batch=", value)) {
+    suc = suc && (istringstream(value) >> batchSize) && batchSize > 0 &&
+          (batchSize == 1 || clientCount == 1);
+  }
+
+  if (optionValue(args, "--seed=", value)) {
+    suc = suc && (istringstream(value) >> seed);
+  }
+
+  if (optionValue(args, "--layout=", value)) {
+    suc = suc && DataLayout::parseFormat(value, layout);
+  }
+
+  optionValue(args, "--dir=", dir);
+
+  for (auto fieldCount : fieldCounts) {
+    if (fieldCount == 0) suc = false;
+  }
+
+  for (auto recordCount : recordCounts) {
+    if (recordCount == 0) suc = false;
+  }
+
+  if (!(suc && parseBackend(args, backend) &&
+        parseGeometry(args, pageSize, maxPageCount)) ||
+      find(args.begin(), args.end(), "--help") != args.end()) {
+    cout << BENCH_HELP_MESSAGE << endl;
+    return suc ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  if ((mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) ||
+      chdir(dir.c_str()) != 0) {
+    cerr << "Could not enter " << dir << endl;
+    return EXIT_FAILURE;
+  }
+
+  Disc::setBackend(backend);
+
+  for (const auto &name : workloadNames) {
+    bool mixed = name == "mixed";
+
+    for (auto fieldCount : fieldCounts) {
+      for (auto recordCount : recordCounts) {
+        for (size_t r = 0; r < (mixed ? readRatios.size() : 1); ++r) {
+          Workload w = {name,
+                        fieldCount,
+                        recordCount,
+                        name == "scan" ? scanCount : opCount,
+                        readRatios[r],
+                        find(args.begin(), args.end(), "--index") != args.end(),
+                        layout,
+                        threadCount,
+                        clientCount,
+                        batchSize,
+                        seed};
+
+          // Each run starts with an empty DB. The files of the type may be
+          // left over from a run which was interrupted.
+          Wal::close();
+
+          for (const auto &fileName :
+               {string(BENCH_TYPE_NAME),
+                FreeSpaceMap::mapFileName(BENCH_TYPE_NAME),
+                Catalogue::indexFileName(BENCH_TYPE_NAME, 0),
+                FreeSpaceMap::mapFileName(
+                    Catalogue::indexFileName(BENCH_TYPE_NAME, 0))}) {
+            BufferPool::discardFile(fileName);
+            Disc::removeFile(fileName);
+          }
+
+          if (!format(backend, pageSize, maxPageCount)) {
+            cerr << "Formatting failed!" << endl;
+            return EXIT_FAILURE;
+          }
+
+          if (fieldCount > Catalogue::maxFieldCount()) {
+            cerr << "At most " << Catalogue::maxFieldCount()
+                 << " fields fit in a page" << endl;
+            return EXIT_FAILURE;
+          }
+
+          persistGlobPageAddr();
+
+          if (!(Wal::open() && run(w, cout))) {
+            cerr << "The " << name << " workload failed!" << endl;
+            return EXIT_FAILURE;
+          }
+        }
+      }
+    }
+  }
+
+  checkpoint();
+  Wal::close();
+  Disc::closeAll();
+
+  return EXIT_SUCCESS;
+}
@@ -11,16 +11,42 @@
 #define PAGE_CATEGORY_FIELD_NAMES 1
 #define PAGE_CATEGORY_TYPES 2
 #define PAGE_CATEGORY_DATA 3
+#define PAGE_CATEGORY_INDEX 4
+#define PAGE_CATEGORY_DATA_PAX 5
+#define PAGE_CATEGORY_DATA_PACKED 6
 
 // Sizes
-#define PAGE_SIZE 2048
-#define MAX_STORAGE_SIZE 10485760  // bytes = 10 MB
-#define MAX_PAGE_COUNT (MAX_STORAGE_SIZE / PAGE_SIZE)
+#define DEFAULT_PAGE_SIZE 2048
+#define MIN_PAGE_SIZE 2048
+#define MAX_PAGE_SIZE 65536
+#define DEFAULT_STORAGE_SIZE 10485760  // bytes = 10 MB
 
 #define FIELD_NAME_SIZE 32
-#define TYPE_DATA_SIZE 56
+#define TYPE_DATA_SIZE 48
 #define TYPE_NAME_SIZE 32
 
+#define BUFFER_POOL_FRAME_COUNT 1024  // frames = 2 MB of 2K pages
+#define MMAP_EXTENT_PAGES 64          // pages by which mapped files grow
+#define MMAP_RESERVE_SIZE (1ULL << 34)  // bytes = 16 GB of address space
+#define BULK_LOAD_BATCH_PAGES 64      // pages appended by one write
+#define VACUUM_STEP_PAGES 8           // pages emptied per idle-time vacuum step
+#define READ_AHEAD_PAGES 32           // pages read ahead of a sequential scan
+#define READ_AHEAD_TRIGGER 2          // consecutive reads before read-ahead
+#define PARALLEL_SCAN_CHUNK_PAGES 64  // pages taken by a scan thread at a time
+#define PARALLEL_SCAN_MIN_PAGES 256   // smaller files are scanned serially
+#define PARALLEL_SCAN_WINDOW 4        // chunks per thread ahead of the output
+#define MAX_SCAN_THREADS 64
+#define LATCH_SHARD_COUNT 64          // separately locked parts of the latches
+#define LATCH_IDLE_LIMIT 256          // unused latches kept by each part
+
+#define WAL_BUFFER_SIZE 1048576        // bytes = 1 MB
+#define WAL_CHECKPOINT_SIZE 16777216   // bytes = 16 MB
+#define WAL_GROUP_COMMIT_SIZE 64       // commits synced together
+
+#define SERVER_MAX_EVENTS 64                // events taken by one epoll_wait
+#define SERVER_MAX_COMMAND_SIZE 1048576     // bytes = 1 MB
+#define SERVER_OUTPUT_LIMIT 4194304         // bytes = 4 MB, per client
+
 // Typedefs
 typedef int64_t sint_t;   // Signed integer type
 typedef uint64_t uint_t;  // Unsigned integer type
@@ -29,10 +55,19 @@ typedef uint64_t uint_t;  // Unsigned integer type
 typedef sint_t field_t;  // Field type
 typedef uint_t addr_t;   // Page address type
 
+// Positions of the fields in the content of the general system catalogue
+#define GEN_CAT_NEW_PAGE_ADDR_POS 0
+#define GEN_CAT_BACKEND_POS 8
+#define GEN_CAT_PAGE_SIZE_POS 16
+#define GEN_CAT_MAX_PAGE_COUNT_POS 24
+#define GEN_CAT_FREE_EXTENT_COUNT_POS 32
+#define GEN_CAT_FREE_EXTENTS_POS 40
+
 // File names
 #define SYS_CATALOGUE_GENERAL_FILE_NAME "syscatalgen"
 #define SYS_CATALOGUE_TYPES_FILE_NAME "syscatalt"
 #define SYS_CATALOGUE_FIELDS_FILE_NAME "syscatalf"
+#define WAL_FILE_NAME "syswal"
 
 // Messages
 #define HELP_MESSAGE \
@@ -48,6 +83,26 @@ Options:\n\
     --format, -f    Formats the current directory to be as an empty DB\n\
 \n\
     --console, -c   Starts the stgmgr console, which you can use for DDL and DML operations\n\
+\n\
+    --backend=<pread|mmap>\n\
+                    With --format, sets the default storage backend of the DB.\n\
+                    With --console, overrides it for this run.\n\
+\n\
+    --page-size=<size>\n\
+                    With --format, sets the page size of the DB: a power of two\n\
+                    from 2K to 64K (default: 2K).\n\
+\n\
+    --capacity=<size|unlimited>\n\
+                    With --format, sets the largest size the DB may grow to\n\
+                    (default: 10M). Sizes may end with K, M or G.\n\
+\n\
+    --serve, -s <socket>\n\
+                    Serves the stgmgr console to many clients at once, over a\n\
+                    Unix domain socket at the given path. See README.md.\n\
+\n\
+    --trace         With --console or --serve, prints each page read from or\n\
+                    written to the disc. Can be switched with the\n\
+                    \"trace on|off\" command.\n\
 \n\
 Author: Alper Çakan\n\
 "
@@ -1,401 +1,23 @@
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <unordered_set>
 #include <vector>
+#include "DataLayout.h"
+#include "Database.h"
 #include "Disc.h"
-#include "Page.h"
+#include "ParallelScan.h"
+#include "Record.h"
+#include "Server.h"
+#include "Stats.h"
+#include "StorageManager.h"
 
 using namespace std;
 
-/**
- * Creates a type. The first field will be the primary key.
- *
- * @param typeName The name of the type to be created
- * @param fieldNames The names of the fields. Must be nonempty, since at least
- * the type must have a primary key.
- * @return Success/failure
- */
-bool createType(const string &typeName, const vector<string> &fieldNames) {
-  if (fieldNames.empty()) {
-    return false;
-  }
-
-  // First, register the field names to the system catalogue
-
-  Page *fieldPage = new Page(SYS_CATALOGUE_FIELDS_FILE_NAME, 1);
-
-  if (!(*fieldPage)) {
-    delete fieldPage;
-    return false;
-  }
-
-  // Advance to the first unused page
-  while (fieldPage->isUsed()) {
-    auto tmp = fieldPage;
-    fieldPage = fieldPage->getConsecPage(true);
-    delete tmp;
-
-    if (!fieldPage) {
-      return false;
-    }
-  }
-
-  // Clean the garbage
-  fieldPage->reset();
-
-  // Write the names of the fields
-  for (size_t i = 0; i < fieldNames.size(); ++i) {
-    auto name = fieldNames[i];
-
-    if (!(fieldPage->writeContent(name.c_str(), name.length(),
-                                  i * FIELD_NAME_SIZE))) {
-      delete fieldPage;
-      return false;
-    }
-  }
-
-  // Save the page
-  fieldPage->setIsUsed(true);
-  fieldPage->setPageCategory(PAGE_CATEGORY_FIELD_NAMES);
-
-  if (!(fieldPage->persist())) {
-    delete fieldPage;
-    return false;
-  }
-
-  delete fieldPage;
-
-  // Now, onto registering the type into the system catalogue
-
-  Page *typePage = new Page(SYS_CATALOGUE_TYPES_FILE_NAME, 1);
-
-  if (!(*typePage)) {
-    delete typePage;
-    return false;
-  }
-
-  int emptyCellIndex;
-
-  // Advance to the first page with empty cell, or create one if there is none
-  while ((emptyCellIndex = typePage->firstEmptyCellIndex(TYPE_DATA_SIZE)) < 0) {
-    auto tmp = typePage;
-    typePage = typePage->getConsecPage(true);
-    delete tmp;
-
-    if (!typePage) {
-      return false;
-    }
-  }
-
-  uint_t fieldCount = fieldNames.size();
-  uint_t fieldPageAddr = fieldPage->getLocAddr();
-  uint_t useMark = 1;
-  size_t cellStart = emptyCellIndex * TYPE_DATA_SIZE;
-
-  typePage->resetRange(cellStart, TYPE_DATA_SIZE);
-
-  typePage->writeContent(reinterpret_cast<char *>(&useMark), sizeof(uint_t),
-                         cellStart);
-
-  typePage->writeContent(typeName.c_str(), typeName.length(),
-                         sizeof(uint_t) + cellStart);
-
-  typePage->writeContent(reinterpret_cast<char *>(&fieldCount), sizeof(uint_t),
-                         sizeof(uint_t) + TYPE_NAME_SIZE + cellStart);
-
-  typePage->writeContent(reinterpret_cast<char *>(&fieldPageAddr),
-                         sizeof(uint_t),
-                         cellStart + TYPE_NAME_SIZE + 2 * sizeof(uint_t));
-
-  typePage->setIsUsed(true);
-  typePage->setPageCategory(PAGE_CATEGORY_TYPES);
-  if (!(typePage->persist())) {
-    return false;
-  }
-
-  // Prepare an empty data file for the new type
-  remove(typeName.c_str());
-  return Disc::appendPage(typeName);
-}
-
-/**
- * Returns the list of the "matching" types
- *
- * @param all If true, all types will match. If false, only the type with the
- * given name will match
- * @param typeName The name of the type to be matched
- * @return The vector of pairs (Type Name, The Number of Fields in the Type)
- */
-vector<pair<string, vector<string>>> getTypeList(bool all = true,
-                                                 const string &typeName = "") {
-  vector<pair<string, vector<string>>> typeNames;
-  Page *typePage = new Page(SYS_CATALOGUE_TYPES_FILE_NAME, 1);
-
-  while (typePage && *typePage) {
-    if (typePage->isUsed()) {
-      for (int i = 0; i < typePage->CONTENT_SIZE / TYPE_DATA_SIZE; ++i) {
-        auto cell = typePage->content() + i * TYPE_DATA_SIZE;
-
-        if (*(reinterpret_cast<const uint_t *>(cell)) == 1) {
-          string name = cell + sizeof(uint_t);
-          auto fieldNameCount = *reinterpret_cast<const sint_t *>(
-              cell + sizeof(uint_t) + TYPE_NAME_SIZE);
-          auto fieldPageAddr = *reinterpret_cast<const uint_t *>(
-              cell + TYPE_NAME_SIZE + 2 * sizeof(uint_t));
-          Page fieldNamesPage(SYS_CATALOGUE_FIELDS_FILE_NAME, fieldPageAddr);
-
-          if (!fieldNamesPage) {
-            delete typePage;
-            return typeNames;
-          }
-
-          vector<string> fieldNames(fieldNameCount);
-
-          for (size_t i = 0; i < fieldNameCount; ++i) {
-            fieldNames[i] = fieldNamesPage.content() + i * FIELD_NAME_SIZE;
-          }
-
-          if (all || name == typeName) typeNames.push_back({name, fieldNames});
-
-          if (!all && name == typeName) {
-            delete typePage;
-            return typeNames;
-          }
-        }
-      }
-    }
-
-    auto tmp = typePage;
-    typePage = typePage->getConsecPage();
-    delete tmp;
-  }
-
-  delete typePage;
-  return typeNames;
-}
-
-/**
- * Deletes a type.
- *
- * @param typeName The name of the type to be deleted
- * @return Success/failure
- */
-bool deleteType(const string &typeName) {
-  remove(typeName.c_str());
-
-  Page *typePage = new Page(SYS_CATALOGUE_TYPES_FILE_NAME, 1);
-
-  while (typePage && *typePage) {
-    if (typePage->isUsed()) {
-      for (int i = 0; i < typePage->CONTENT_SIZE / TYPE_DATA_SIZE; ++i) {
-        const char *cell = typePage->content() + i * TYPE_DATA_SIZE;
-
-        if (*(reinterpret_cast<const uint_t *>(cell)) == 1 &&
-            string(cell + sizeof(uint_t)) == typeName) {
-          Page fieldPage(SYS_CATALOGUE_FIELDS_FILE_NAME,
-                         *reinterpret_cast<const uint_t *>(
-                             cell + TYPE_NAME_SIZE + 2 * sizeof(uint_t)));
-
-          if (!fieldPage) {
-            delete typePage;
-            return false;
-          }
-
-          fieldPage.setIsUsed(false);
-
-          uint_t markFree = 0;
-          typePage->writeContent(reinterpret_cast<char *>(&markFree),
-                                 sizeof(uint_t), i * TYPE_DATA_SIZE);
-
-          if (!(fieldPage.persist() && typePage->persist())) {
-            delete typePage;
-            return false;
-          }
-
-          delete typePage;
-          return true;
-        }
-      }
-    }
-
-    auto tmp = typePage;
-    typePage = typePage->getConsecPage();
-    delete tmp;
-  }
-
-  delete typePage;
-  return false;
-}
-
-/**
- * Formats the current directory to be an empty database.
- *
- * Note that this operation may remove and/or overwrite your existing files.
- * Therefore, it should be run only if the directory contains only the
- * executable of this program.
- */
-bool format() {
-  // Just remove all system catalogue files and initialize each of them with a
-  // single null page.
-
-  remove(SYS_CATALOGUE_GENERAL_FILE_NAME);
-  remove(SYS_CATALOGUE_TYPES_FILE_NAME);
-  remove(SYS_CATALOGUE_FIELDS_FILE_NAME);
-
-  return Disc::appendPage(SYS_CATALOGUE_GENERAL_FILE_NAME) &&
-         Disc::appendPage(SYS_CATALOGUE_TYPES_FILE_NAME) &&
-         Disc::appendPage(SYS_CATALOGUE_FIELDS_FILE_NAME);
-}
-
-/**
- * Creates a record.
- *
- * @param typeName The name of the type of the record to be created
- * @param values The field values of the record to be created. Must be nonempty.
- * @return The pair (Glob. Page Addr., Loc. Page Addr.) for the page in which
- * the newly created record is placed, or (0, 0) on failure.
- */
-pair<uint_t, uint_t> createRecord(const string &typeName,
-                                  const vector<sint_t> &values) {
-  Page *page = new Page(typeName, 1);
-
-  if (!(*page)) {
-    delete page;
-    return {0, 0};
-  }
-
-  int emptyCellIndex;
-  const auto recSize = (values.size() + 1) * sizeof(sint_t);
-
-  while ((emptyCellIndex = page->firstEmptyCellIndex(recSize)) < 0) {
-    auto tmp = page;
-    page = page->getConsecPage(true);
-    delete tmp;
-
-    if (!page) {
-      return {0, 0};
-    }
-  }
-
-  size_t cellStart = emptyCellIndex * recSize;
-
-  uint_t useMark = 1;
-  page->resetRange(cellStart, recSize);
-  page->writeContent(reinterpret_cast<char *>(&useMark), sizeof(uint_t),
-                     cellStart);
-
-  for (size_t i = 0; i < values.size(); ++i) {
-    page->writeContent(reinterpret_cast<const char *>(&values[i]),
-                       sizeof(uint_t),
-                       cellStart + sizeof(uint_t) + i * sizeof(sint_t));
-  }
-
-  page->setIsUsed(true);
-  page->setPageCategory(PAGE_CATEGORY_DATA);
-
-  if (!(page->persist())) {
-    delete page;
-    return {0, 0};
-  }
-
-  delete page;
-  return {page->globAddr(), page->getLocAddr()};
-}
-
-/**
- * Searches for (and deletes) for a record or all records.
- *
- * Can be used for:
- * - Querying a specific record of a type
- * - Deleting a specific record of a type
- * - Deleting all records of a type
- * - Querying all records of a type
- *
- * @param typeName The name of the type of the record(s) to be searched/deleted
- * @param keyValue The key value of the record to be searched/deleted
- * @param all If true, keyValue will be ignored and all records of the given
- * type will "match"
- * @param del If true, the matched records will be deleted
- * @param suc A reference to a boolean variable. This will contain the
- * success/failure status. Note that finding no matching records is not a
- * failure.
- * @return The pair (Record Values, (Global Page Addr. of the Record), (Local
- * Page Addr. of the Record)).
- */
-pair<vector<vector<sint_t>>, pair<uint_t, uint_t>> searchRecord(
-    const string &typeName, sint_t keyValue, bool all, bool del, bool &suc) {
-  suc = true;
-  vector<vector<sint_t>> res;
-  Page *page = new Page(typeName, 1);
-  uint_t glob = 0, loc = 0;
-
-  if (!(*page)) {
-    delete page;
-    suc = false;
-    return {res, {0, 0}};
-  }
-
-  auto typeList = getTypeList(false, typeName);
-
-  if (typeList.empty()) {
-    delete page;
-    suc = false;
-    return {res, {0, 0}};
-  }
-
-  auto fieldNames = typeList[0].second;
-  int recSize = sizeof(uint_t) * (1 + fieldNames.size());
-
-  while (page) {
-    if (page->isUsed()) {
-      for (int i = 0; i < page->CONTENT_SIZE / recSize; ++i) {
-        const char *cell = page->content() + i * recSize;
-
-        if (*(reinterpret_cast<const uint_t *>(cell)) == 1 &&
-            (*(reinterpret_cast<const sint_t *>(cell + sizeof(uint_t))) ==
-                 keyValue ||
-             all)) {
-          vector<sint_t> record;
-
-          for (int j = 0; j < fieldNames.size(); ++j) {
-            record.push_back(*(reinterpret_cast<const sint_t *>(
-                cell + sizeof(uint_t) * (j + 1))));
-          }
-
-          res.push_back(record);
-
-          if (del) {
-            uint_t markEmpty = 0;
-            page->writeContent(reinterpret_cast<char *>(&markEmpty),
-                               sizeof(uint_t), i * recSize);
-
-            if (!(page->persist())) {
-              delete page;
-              suc = false;
-              return {res, {0, 0}};
-            }
-          }
-
-          glob = page->globAddr();
-          loc = page->getLocAddr();
-
-          if (!all) {
-            delete page;
-            return {res, {glob, loc}};
-          }
-        }
-      }
-    }
-
-    auto tmp = page;
-    page = page->getConsecPage();
-    delete tmp;
-  }
-
-  delete page;
-  return {res, {glob, loc}};
-}
-
 /**
  * Gives the "actual" arguments of the program as a vector of strings.
  *
@@ -441,7 +63,7 @@ string join(const vector<string> &arr, const string &delim) {
  * @param rec The field values of the record. Must be nonempty.
  * @return Human-readable string representation of the record
  */
-string recToStr(const string &typeName, const vector<sint_t> &rec) {
+string recToStr(const string &typeName, Record rec) {
   vector<string> valsAsStr;
   valsAsStr.reserve(rec.size());
 
@@ -452,15 +74,6 @@ string recToStr(const string &typeName, const vector<sint_t> &rec) {
   return typeName + "(" + join(valsAsStr, ", ") + ")";
 }
 
-void persistGlobPageAddr() {
-  Page genSysCat(SYS_CATALOGUE_GENERAL_FILE_NAME, 1);
-
-  genSysCat.writeContent(reinterpret_cast<char *>(&Disc::newPageAddr),
-                         sizeof(uint_t), 0);
-
-  genSysCat.persist();
-}
-
 /**
  * Gives a string representation of a type in human-readable format.
  *
@@ -475,44 +88,167 @@ string typeToStr(const string &typeName, const vector<string> &fieldNames) {
   return typeName + "(" + join(fieldNames, ", ") + ")";
 }
 
-bool execCmd(const string &line) {
+/**
+ * Whether the types are compacted while the console waits for input.
+ */
+bool autoVacuum = false;
+
+/**
+ * Executes a console command.
+ *
+ * @param db The database
+ * @param line The command line
+ * @param out The stream to print the results to
+ * @return Success/failure
+ */
+bool execCmd(Database &db, const string &line, ostream &out) {
   string cmd;
   istringstream ss(line);  // "Parse" the read line
   ss >> cmd;
 
   if (cmd == "exit") {
-    persistGlobPageAddr();
+    db.close();
+    out.flush();
     exit(EXIT_SUCCESS);
   }
 
+  if (cmd == "stats") {
+    string option;
+    ss >> option;
+
+    if (option == "reset") {
+      Stats::reset();
+    } else if (option.empty() || option == "json") {
+      Stats::print(out, option == "json");
+    } else {
+      return false;
+    }
+
+    return true;
+  }
+
+  if (cmd == "trace") {
+    string option;
+    ss >> option;
+
+    if (option != "on" && option != "off") return false;
+
+    Stats::trace = option == "on";
+    return true;
+  }
+
+  if (cmd == "autovacuum") {
+    string option;
+    ss >> option;
+
+    if (option != "on" && option != "off") return false;
+
+    autoVacuum = option == "on";
+    return true;
+  }
+
+  // The commands whose latencies are recorded, so that unknown commands (of
+  // the clients in server mode, too) cannot add histograms without bound
+  static const unordered_set<string> timedCmds = {
+      "create_type",   "delete_type",   "list_types",   "create_index",
+      "bulk_load",     "create_record", "delete_record", "search_record",
+      "search_by",     "aggregate",     "vacuum",       "list_records",
+      "begin",         "commit",        "abort"};
+
+  if (!timedCmds.count(cmd)) return true;  // Unknown commands are ignored
+
+  // The latency of the command is recorded when it returns
+  Stats::Timer timer(cmd);
+
   if (cmd == "create_type") {
     string typeName, fieldName;
     vector<string> fieldNames;
+    auto format = DataLayout::FORMAT_ROW;
+    const string formatOption = "layout=";
 
     ss >> typeName;
 
     while (ss) {
-      if (ss >> fieldName) fieldNames.push_back(fieldName);
+      if (!(ss >> fieldName)) break;
+
+      if (fieldName.compare(0, formatOption.size(), formatOption) == 0) {
+        if (!DataLayout::parseFormat(fieldName.substr(formatOption.size()),
+                                     format)) {
+          return false;
+        }
+      } else {
+        fieldNames.push_back(fieldName);
+      }
     }
 
-    if (!createType(typeName, fieldNames)) return false;
+    if (!db.createTable(typeName, fieldNames, format)) return false;
 
-    cout << typeToStr(typeName, fieldNames) << " is created!" << endl;
+    out << typeToStr(typeName, fieldNames) << " is created!\n";
 
   } else if (cmd == "delete_type") {
     string typeName;
     ss >> typeName;
 
-    if (!deleteType(typeName)) {
+    if (!db.dropTable(typeName)) {
       return false;
     }
 
-    cout << typeName << " is deleted!" << endl;
+    out << typeName << " is deleted!\n";
   } else if (cmd == "list_types") {
-    auto vec = getTypeList();
+    for (const auto &table : db.tables()) {
+      out << typeToStr(table.name(), table.fieldNames()) << "\n";
+    }
+  } else if (cmd == "create_index") {
+    string typeName, fieldName;
+    ss >> typeName >> fieldName;
+
+    auto table = db.table(typeName);
+    int field = fieldName.empty() ? 0 : table.fieldIndex(fieldName);
 
-    for (const auto &t : vec) {
-      cout << typeToStr(t.first, t.second) << endl;
+    if (!(table && field >= 0 && table.createIndex(field))) {
+      return false;
+    }
+
+    if (field == 0) {
+      out << "The primary key index of " << typeName << " is created!\n";
+    } else {
+      out << "The index on " << fieldName << " of " << typeName
+          << " is created!\n";
+    }
+  } else if (cmd == "bulk_load") {
+    string typeName, path, option;
+    bool binary = false, quiet = false;
+    uint_t count;
+
+    ss >> typeName >> path;
+
+    while (ss >> option) {
+      if (option == "bin") {
+        binary = true;
+      } else if (option == "quiet") {
+        quiet = true;
+      } else if (option != "csv") {
+        return false;
+      }
+    }
+
+    auto table = db.table(typeName);
+
+    if (!table) return false;
+
+    auto printRecord = [&typeName, &out](Record values,
+                                         PageNumber pageNumber) {
+      out << recToStr(typeName, values) << " is created in page #"
+          << pageNumber.first << ":" << pageNumber.second << "\n";
+    };
+
+    bool suc = quiet ? table.bulkLoad(path, binary, count)
+                     : table.bulkLoad(path, binary, count, printRecord);
+
+    out << count << " records are loaded into " << typeName << "\n";
+
+    if (!suc) {
+      return false;
     }
   } else if (cmd == "create_record") {
     string typeName;
@@ -526,92 +262,278 @@ bool execCmd(const string &line) {
       if (ss >> value) values.push_back(value);
     }
 
-    auto pageNumber = createRecord(typeName, values);
+    auto table = db.table(typeName);
+    PageNumber pageNumber;
 
-    if (pageNumber.first == 0 && pageNumber.second == 0) {
+    if (!(table && table.insert(values, &pageNumber))) {
       return false;
     }
 
-    cout << recToStr(typeName, values) << " is created in page #"
-         << pageNumber.first << ":" << pageNumber.second << endl;
+    out << recToStr(typeName, values) << " is created in page #"
+         << pageNumber.first << ":" << pageNumber.second << "\n";
   } else if (cmd == "delete_record") {
     string typeName;
     sint_t key;
-    bool suc;
+    bool found;
+    PageNumber pageNumber;
 
     ss >> typeName >> key;
 
-    auto res = searchRecord(typeName, key, false, true, suc);
+    auto table = db.table(typeName);
 
-    if (!suc) {
+    if (!(table && table.erase(key, found, &pageNumber))) {
       return false;
     }
 
-    if (res.first.empty()) {
-      cout << "No such record found" << endl;
+    if (!found) {
+      out << "No such record found\n";
     } else {
-      cout << "The record is deleted from page #" << res.second.first << ":"
-           << res.second.second << endl;
+      out << "The record is deleted from page #" << pageNumber.first << ":"
+          << pageNumber.second << "\n";
     }
   } else if (cmd == "search_record") {
     string typeName;
     sint_t key;
-    bool suc;
+    bool found;
+    vector<sint_t> values;
+    PageNumber pageNumber;
 
     ss >> typeName >> key;
 
-    auto res = searchRecord(typeName, key, false, false, suc);
+    auto table = db.table(typeName);
 
-    if (!suc) {
+    if (!(table && table.find(key, values, found, &pageNumber,
+                              ParallelScan::defaultThreadCount()))) {
       return false;
     }
 
-    if (res.first.empty()) {
-      cout << "No such record found" << endl;
+    if (!found) {
+      out << "No such record found\n";
     } else {
-      cout << "The record is found in page #" << res.second.first << ":"
-           << res.second.second << endl;
-      cout << recToStr(typeName, res.first[0]) << endl;
+      out << "The record is found in page #" << pageNumber.first << ":"
+          << pageNumber.second << "\n";
+      out << recToStr(typeName, values) << "\n";
     }
-  } else if (cmd == "list_records") {
+  } else if (cmd == "search_by") {
+    string typeName, fieldName;
+    sint_t value;
+    bool found = false;
+
+    if (!(ss >> typeName >> fieldName >> value)) return false;
+
+    auto table = db.table(typeName);
+    int field = table.fieldIndex(fieldName);
+    auto printRecord = [&typeName, &out, &found](Record rec,
+                                                 PageNumber pageNumber) {
+      out << recToStr(typeName, rec) << " is found in page #"
+          << pageNumber.first << ":" << pageNumber.second << "\n";
+      found = true;
+    };
+
+    if (!(table && field >= 0 &&
+          table.findBy(field, value, printRecord,
+                       ParallelScan::defaultThreadCount()))) {
+      return false;
+    }
+
+    if (!found) out << "No such record found\n";
+  } else if (cmd == "aggregate") {
+    string typeName, call, option, groupName;
+
+    if (!(ss >> typeName >> call)) return false;
+
+    if (ss >> option && !(option == "group_by" && ss >> groupName)) {
+      return false;
+    }
+
+    // The call is of the form func(field)
+    auto open = call.find('(');
+    Aggregate::Function func;
+
+    if (open == string::npos || call.back() != ')' ||
+        !Aggregate::parseFunction(call.substr(0, open), func)) {
+      return false;
+    }
+
+    auto table = db.table(typeName);
+    int field = table.fieldIndex(call.substr(open + 1, call.size() - open - 2));
+    int groupField = groupName.empty() ? -1 : table.fieldIndex(groupName);
+    vector<pair<sint_t, Aggregate>> groups;
+
+    if (!(table && field >= 0 && (groupName.empty() || groupField >= 0) &&
+          table.aggregate(field, groupField, groups,
+                          ParallelScan::defaultThreadCount()))) {
+      return false;
+    }
+
+    for (const auto &group : groups) {
+      if (group.second.count == 0 && func != Aggregate::COUNT) {
+        out << "No records\n";
+        continue;
+      }
+
+      if (groupField >= 0) out << groupName << "=" << group.first << " ";
+
+      out << call << "=";
+
+      if (func == Aggregate::AVG) {
+        out << group.second.average() << "\n";
+      } else {
+        out << Aggregate::toString(group.second.value(func)) << "\n";
+      }
+    }
+  } else if (cmd == "vacuum") {
     string typeName;
+    uint_t freedPages;
+
+    if (!(ss >> typeName)) {
+      if (!db.vacuum(freedPages)) return false;
+
+      out << freedPages << " pages are freed\n";
+      return true;
+    }
+
+    auto table = db.table(typeName);
+
+    if (!(table && table.vacuum(freedPages))) return false;
+
+    out << freedPages << " pages of " << typeName << " are freed\n";
+  } else if (cmd == "list_records") {
+    string typeName, option;
+    uint_t threadCount = ParallelScan::defaultThreadCount();
+    bool ordered = true;
+
     ss >> typeName;
-    bool suc;
 
-    auto res = searchRecord(typeName, 0, true, false, suc);
+    while (ss >> option) {
+      if (option == "unordered") {
+        ordered = false;
+      } else if (!(stringstream(option) >> threadCount) || threadCount == 0) {
+        return false;
+      }
+    }
+
+    auto table = db.table(typeName);
+    auto printRecord = [&typeName, &out](Record rec) {
+      out << recToStr(typeName, rec) << "\n";
+    };
 
-    if (!suc) {
+    if (!(table && table.scan(printRecord, threadCount, ordered))) {
       return false;
     }
+  } else if (cmd == "begin") {
+    if (!db.begin()) return false;
+
+    out << "The transaction is started\n";
+  } else if (cmd == "commit") {
+    if (!db.inTransaction()) return false;
 
-    for (const auto &rec : res.first) {
-      cout << recToStr(typeName, rec) << endl;
+    if (!db.commit()) {
+      out << "The transaction is aborted\n";
+      return false;
     }
+
+    out << "The transaction is committed\n";
+  } else if (cmd == "abort") {
+    if (!db.abort()) return false;
+
+    out << "The transaction is aborted\n";
   }
 
   return true;
 }
 
+/**
+ * Checks whether there is input which can be read without blocking.
+ */
+bool inputPending() {
+  if (cin.rdbuf()->in_avail() > 0) return true;
+
+  pollfd fd = {STDIN_FILENO, POLLIN, 0};
+
+  return poll(&fd, 1, 0) > 0 && (fd.revents & POLLIN);
+}
+
+/**
+ * Executes a console command and commits it, unless it is run in a
+ * transaction. If it fails, the reason is printed.
+ *
+ * @param db The database
+ * @param line The command line
+ * @param out The stream to print the results to
+ * @return Success/failure
+ */
+bool runCmd(Database &db, const string &line, ostream &out) {
+  try {
+    bool suc = execCmd(db, line, out);
+
+    if (!db.inTransaction() && !db.commit()) suc = false;
+
+    if (!suc) {
+      out << "Command failed!" << endl;
+
+      if (Disc::discFull) {
+        out << "The disc is full" << endl;
+      }
+    }
+
+    return suc;
+  } catch (exception e) {
+    out << "Command execution error!" << endl;
+    return false;
+  }
+}
+
+/**
+ * Compacts the types, VACUUM_STEP_PAGES pages at a time, until all of them
+ * are compacted or there are commands to be run.
+ *
+ * @param db The database
+ * @param pending Whether there are commands to be run
+ */
+void vacuumWhileIdle(Database &db, const function<bool()> &pending) {
+  for (auto &table : db.tables()) {
+    bool done = false;
+
+    while (!done && !pending()) {
+      uint_t freedPages;
+
+      if (!(table.vacuum(freedPages, VACUUM_STEP_PAGES, &done) &&
+            db.commit())) {
+        return;
+      }
+    }
+
+    if (!done) return;
+  }
+}
+
 /**
  * Read-eval-print loop mode for DML and DDL commands.
+ *
+ * The commits of the commands are synced to the disc in groups: while more
+ * commands are already waiting in the input, the log is synced only when
+ * Wal::commit() decides so; before waiting for new input, it is always synced.
  */
-void repl() {
+void repl(Database &db) {
   while (true) {
     string line;
-    cout << "> ";        // Classic REPL line start output
-    getline(cin, line);  // Read line by line
-
-    try {
-      if (!execCmd(line)) {
-        cout << "Command failed!" << endl;
 
-        if (Disc::discFull) {
-          cout << "The disc is full" << endl;
-        }
+    if (!inputPending()) {
+      if (autoVacuum && !db.inTransaction()) {
+        vacuumWhileIdle(db, inputPending);
       }
-    } catch (exception e) {
-      cout << "Command execution error!" << endl;
+
+      db.sync();
     }
+
+    cout << "> ";  // Classic REPL line start output
+
+    if (!getline(cin, line)) {  // Read line by line
+      line = "exit";            // End of the input
+    }
+
+    runCmd(db, line, cout);
   }
 }
 
@@ -620,10 +542,67 @@ void repl() {
  */
 void printHelp() { cout << HELP_MESSAGE << endl; }
 
-void initGlobPageAddr() {
-  Page genSysCat(SYS_CATALOGUE_GENERAL_FILE_NAME, 1);
+/**
+ * Server mode, in which the console commands of many clients are run. See
+ * Server.
+ *
+ * @param db The database
+ * @param socketPath The path of the Unix domain socket to listen at
+ * @return Success/failure
+ */
+bool serve(Database &db, const string &socketPath) {
+  Server server(db, [&db](const string &line, ostream &out) {
+    return runCmd(db, line, out);
+  });
+  string error;
+
+  if (!server.listen(socketPath, &error)) {
+    cout << error << endl;
+    return false;
+  }
+
+  cout << "Serving at " << socketPath << endl;
+
+  return server.run([&db, &server]() {
+    if (autoVacuum) {
+      vacuumWhileIdle(db, [&server]() { return server.pending(); });
+      db.sync();
+    }
+  });
+}
+
+/**
+ * Opens the database for the console or the server mode, with the backend
+ * and the tracing given among the arguments.
+ *
+ * @param db The database
+ * @param args The arguments of the program
+ * @return Success/failure
+ */
+bool openDatabase(Database &db, const vector<string> &args) {
+  auto backend = Disc::BACKEND_PREAD;
+  string error;
+
+  if (!parseBackend(args, backend)) {
+    printHelp();
+    return false;
+  }
+
+  // Without the option, the default backend of the database is used
+  const string backendOption = "--backend=";
+  bool backendGiven = any_of(
+      args.begin() + 1, args.end(), [&backendOption](const string &arg) {
+        return arg.compare(0, backendOption.size(), backendOption) == 0;
+      });
+
+  Stats::trace = find(args.begin() + 1, args.end(), "--trace") != args.end();
 
-  Disc::newPageAddr = (*reinterpret_cast<const uint_t *>(genSysCat.content()));
+  if (!(backendGiven ? db.open(backend, &error) : db.open(&error))) {
+    cout << error << endl;
+    return false;
+  }
+
+  return true;
 }
 
 /**
@@ -635,23 +614,44 @@ int main(int argc, char *argv[]) {
   if (args.empty() || args[0] == "--help" || args[0] == "-h") {
     printHelp();
   } else if (args[0] == "--format" || args[0] == "-f") {
+    auto backend = Disc::BACKEND_PREAD;
+    uint_t pageSize = DEFAULT_PAGE_SIZE, maxPageCount;
+
+    if (!(parseBackend(args, backend) &&
+          parseGeometry(args, pageSize, maxPageCount))) {
+      printHelp();
+      return EXIT_FAILURE;
+    }
+
     cout << "Formatting..." << endl;
 
-    if (format()) {
-      persistGlobPageAddr();
+    if (Database::format(backend, pageSize, maxPageCount)) {
       cout << "Formatted successfully." << endl;
     } else {
       cout << "Formatting failed!" << endl;
       return EXIT_FAILURE;
     }
   } else if (args[0] == "--console" || args[0] == "-c") {
-    initGlobPageAddr();
+    Database db;
+
+    if (!openDatabase(db, args)) return EXIT_FAILURE;
 
     cout << "Console mode" << endl
          << "Type DDL or DML command and press enter." << endl
          << endl;
 
-    repl();
+    repl(db);
+  } else if (args[0] == "--serve" || args[0] == "-s") {
+    Database db;
+
+    if (args.size() < 2 || args[1].empty() || args[1][0] == '-') {
+      printHelp();
+      return EXIT_FAILURE;
+    }
+
+    if (!(openDatabase(db, args) && serve(db, args[1]) && db.close())) {
+      return EXIT_FAILURE;
+    }
   }
 
   return EXIT_SUCCESS;